@@ -112,6 +112,29 @@ export function PerformanceMonitor({
               <div>{fmt(metrics.instructionCount)}</div>
             </div>
           </div>
+
+          {metrics.blockProfiles.length > 0 && (
+            <div className="mt-2 border-t border-white/20 pt-1">
+              <div className="flex justify-between gap-4 opacity-70">
+                <div>Block (nodes)</div>
+                <div>avg / p99 µs</div>
+              </div>
+              {metrics.blockProfiles.slice(0, 8).map((block) => (
+                <div key={`${block.kernel}-${block.label}`} className="flex justify-between gap-4">
+                  <div>
+                    {block.label}
+                    {block.nodeIds.length > 0 && (
+                      <span className="opacity-70"> ({block.nodeIds.join(', ')})</span>
+                    )}
+                  </div>
+                  <div>
+                    {(block.avg / 1000).toFixed(1)} / {(block.p99 / 1000).toFixed(1)} ·{' '}
+                    {Math.round(block.share * 100)}%
+                  </div>
+                </div>
+              ))}
+            </div>
+          )}
         </>
       )}
     </div>
@@ -1,5 +1,6 @@
 import { useState, useEffect } from 'react';
 import { useWorker } from '@/contexts/WorkerContext';
+import { getProfiles } from '@/lib/zen/memory/profile';
 
 /**
  * Hook that provides real-time performance metrics from the worker thread
@@ -22,6 +23,9 @@ export function usePerformanceMetrics(updateInterval = 1000) {
     // Derived metrics
     messagesPerSecond: 0,
     instructionsPerSecond: 0,
+
+    // Per-block timings of kernels compiled with the "profile" attribute
+    blockProfiles: getProfiles(),
   });
   
   // Keep previous message/instruction counts to calculate rate
@@ -64,8 +68,11 @@ export function usePerformanceMetrics(updateInterval = 1000) {
           setMetrics({
             ...currentMetrics,
             messagesPerSecond,
-            instructionsPerSecond
+            instructionsPerSecond,
+            blockProfiles: getProfiles()
           });
+        } else {
+          setMetrics((metrics) => ({ ...metrics, blockProfiles: getProfiles() }));
         }
       } catch (error) {
         console.error('Error updating performance metrics:', error);
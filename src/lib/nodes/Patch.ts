@@ -36,6 +36,8 @@ interface GraphContext {
   merger?: ChannelMergerNode;
   graph: ZenGraph;
   workletNode: AudioWorkletNode;
+  // the patch's connections to and from this worklet, once it's been retired
+  retiredConnections?: { splitter: ChannelSplitterNode; source?: AudioNode }[];
 }
 
 let ID_COUNTER = 0;
@@ -48,6 +50,7 @@ export class PatchImpl implements Patch {
   audioContext: AudioContext;
   audioNode?: AudioNode;
   worklets: GraphContext[];
+  retiring: GraphContext[];
   counter: number;
   historyDependencies: Statement[];
   waiting: boolean;
@@ -110,6 +113,7 @@ export class PatchImpl implements Patch {
     // TODO: ensure that this is base patch...
     this.audioContext = audioContext; //new AudioContext({ sampleRate: 44100 });
     this.worklets = [];
+    this.retiring = [];
     this.waiting = false;
     this.storedStatement = undefined;
     this.missedConnections = [];
@@ -276,26 +280,70 @@ export class PatchImpl implements Patch {
   }
 
   disconnectGraph() {
-    for (const { workletNode, splitter, graph, merger } of this.worklets) {
+    for (const worklet of this.worklets) {
       for (const connection of this.getAudioConnections()) {
         connection.source.disconnectAudioNode(connection);
       }
+      this.disposeWorklet(worklet);
+    }
+    this.worklets.length = 0;
+    for (const worklet of this.retiring.splice(0)) {
+      this.disposeWorklet(worklet);
+    }
+  }
 
-      workletNode.disconnect();
-      if (splitter) {
-        splitter.disconnect();
-      }
-      if (merger) {
-        merger.disconnect();
+  /**
+   * Like disconnectGraph, but the worklets keep playing, connected, until the recompiled
+   * graph takes their state over and crossfades with them (see onZenCompilation). The
+   * connections get new splitters when the next worklet connects, and the current ones are
+   * kept with the worklets, to be disconnected when they're disposed.
+   */
+  retireGraph() {
+    if (this.worklets.length === 0) {
+      this.disconnectGraph();
+      return;
+    }
+    const retiredConnections: NonNullable<GraphContext["retiredConnections"]> = [];
+    for (const connection of this.getAudioConnections()) {
+      if (connection.splitter) {
+        retiredConnections.push({
+          splitter: connection.splitter,
+          source: (connection.source as ObjectNode).audioNode,
+        });
+        connection.splitter = undefined;
+      }
+    }
+    this.worklets[this.worklets.length - 1].retiredConnections = retiredConnections;
+    this.retiring.push(...this.worklets.splice(0));
+  }
+
+  disposeWorklet(worklet: GraphContext) {
+    const { workletNode, splitter, graph, merger, retiredConnections } = worklet;
+    workletNode.disconnect();
+    if (splitter) {
+      splitter.disconnect();
+    }
+    if (merger) {
+      merger.disconnect();
+    }
+    for (const connection of retiredConnections || []) {
+      connection.splitter.disconnect();
+      try {
+        connection.source?.disconnect(connection.splitter);
+      } catch (e) {
+        // already disconnected along with its source
       }
+    }
 
-      workletNode.port.postMessage({
-        type: "dispose",
-      });
-      graph.context.disposed = true;
-      workletNode.port.onmessage = null;
+    workletNode.port.postMessage({
+      type: "dispose",
+    });
+    graph.context.disposed = true;
+    workletNode.port.onmessage = null;
+    const i = this.retiring.indexOf(worklet);
+    if (i >= 0) {
+      this.retiring.splice(i, 1);
     }
-    this.worklets.length = 0;
   }
 
   startParameterNumberMessages() {
@@ -6,6 +6,7 @@ import type { ZenWorklet } from "@/lib/zen/worklet";
 import type { PatchImpl } from "../Patch";
 import { traverseForwards } from "../traverse";
 import { Target } from "@/lib/zen/targets";
+import { BLOCK_PROFILES, DEFAULT_BLOCK_SIZE, type BlockProfile } from "@/lib/zen/blockSize";
 import { containsSameHistory } from "../definitions/zen/history";
 import { waitForBuffers } from "./wait";
 import { sortHistories } from "./histories";
@@ -48,12 +49,16 @@ export const prepareAndCompile = (patch: PatchImpl, _statement: Statement) => {
   const ast = compileStatement(statement);
   const target = parentNode.attributes.target === "C" ? Target.C : Target.Javascript;
   const forceScalar = !parentNode.attributes.SIMD;
+  // per-block timings, shown in the performance monitor (C target only)
+  const profile = !!parentNode.attributes.profile;
+  const blockSize =
+    BLOCK_PROFILES[parentNode.attributes.blockProfile as BlockProfile] || DEFAULT_BLOCK_SIZE;
 
   let zenGraph: ZenGraph | undefined = undefined;
   try {
     zenGraph = Array.isArray(ast)
-      ? zenWithTarget(target, ast[0], forceScalar)
-      : zenWithTarget(target, ast as UGen, forceScalar);
+      ? zenWithTarget(target, ast[0], forceScalar, "precise", profile, blockSize)
+      : zenWithTarget(target, ast as UGen, forceScalar, "precise", profile, blockSize);
   } catch (e) {
     console.log("error compiling patch", patch, e);
     throw e;
@@ -1,6 +1,8 @@
-import { ZenWorklet } from "@/lib/zen/worklet";
+import { ZenWorklet, reportKernelProfile } from "@/lib/zen/worklet";
 import { ConnectionType, ObjectNode, Patch, SubPatch } from "../types";
 import { ZenGraph, initMemory } from "@/lib/zen";
+import { hotSwap } from "@/lib/zen/hotSwap";
+import { Target } from "@/lib/zen/targets";
 import { PatchImpl } from "../Patch";
 import { getRootPatch } from "../traverse";
 import { mapReceive } from "./recompileGraph";
@@ -25,13 +27,36 @@ export const onZenCompilation = (ret: ZenWorklet, patch: PatchImpl, zenGraph: Ze
     throw new Error("no parent node in subpatch");
   }
 
+  // whatever was playing before this compile keeps playing until this worklet has loaded,
+  // then hands its state over and fades out
+  patch.retireGraph();
+  const previous = [...patch.retiring];
+
   ret.workletNode.port.onmessage = (e) => {
     if (e.data.type === "wasm-ready") {
       initMemory(zenGraph.context, worklet);
-      worklet.port.postMessage({ type: "ready" });
+      hotSwap(previous, { workletNode: worklet, graph: zenGraph }).then(() => {
+        for (const retired of previous) {
+          patch.disposeWorklet(retired);
+        }
+      });
+      patch.skipRecompile = false;
+      return;
+    }
+    if (e.data.type === "error-compiling") {
+      // nothing will take over from the retiring worklets, so they're disposed now rather
+      // than playing on, and piling up in patch.retiring, until a later compile succeeds
+      console.log("error compiling", e.data.body);
+      for (const retired of previous) {
+        patch.disposeWorklet(retired);
+      }
       patch.skipRecompile = false;
       return;
     }
+    if (e.data.type === "profile") {
+      reportKernelProfile(parentNode.id, zenGraph, e.data.body);
+      return;
+    }
 
     /*
     // Send messages using the optimized format for better performance
@@ -53,7 +78,10 @@ export const onZenCompilation = (ret: ZenWorklet, patch: PatchImpl, zenGraph: Ze
     [ret.messageChannel.port2],
   );
 
-  patch.disconnectGraph();
+  if (zenGraph.context.target !== Target.C) {
+    // the javascript worklet is ready as soon as it's created, so there's nothing to swap
+    patch.disconnectGraph();
+  }
 
   if (parentNode.attributes.mc) {
     // we are a multi-channel node
@@ -9,7 +9,7 @@ const dlog = (...x: any[]) => {
 
 const handleCompileReset = (patch: Patch): [ObjectNode[], ObjectNode[]] => {
   const parentPatch = (patch as Patch as SubPatch).parentPatch;
-  patch.disconnectGraph();
+  patch.retireGraph();
   patch.outputStatements = [];
   patch.storedStatement = undefined;
   patch.historyDependencies = [];
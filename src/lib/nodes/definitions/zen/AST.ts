@@ -22,6 +22,8 @@ import { svf } from "../../../zen/filters/svf";
 import { biquad, biquadI } from "../../../zen/filters/biquad";
 import { vactrol, onepole } from "../../../zen/filters/onepole";
 import { compressor } from "../../../zen/compressor";
+import { peekUUID } from "../../../zen/uuid";
+import { attributeUGens } from "../../../zen/memory/profile";
 import { fixnan, elapsed, dcblock } from "../../../zen/utils";
 import { simdDot, simdDotSum, simdMatSum } from "../../../zen/simd";
 import { PhysicalModel } from "./physical-modeling/types";
@@ -146,7 +148,7 @@ export const printStatement = (statement: Statement): string => {
   }
   for (let i = 0; i < blocks.length; i++) {
     let block = blocks[i].data;
-    let interpolation = block.interpolation === "none" ? "none" : "linear";
+    let interpolation = block.interpolation || "linear";
     let functions = blocks[i].node
       ? traverseBackwards(blocks[i].node).filter((x) => (x as ObjectNode).name === "function")
       : [];
@@ -570,6 +572,8 @@ export const _compileStatement = (
 
   let zenOperator: ZenFunction | OnchainFunction = getZenOperator(operator, _api);
   let output: UGen | undefined = undefined;
+  // the arguments are compiled, so UGens created from here on belong to this node
+  const firstUGen = peekUUID();
   let _name = "";
   if (isSimpleFunction(zenOperator, _simpleFunctions)) {
     output = (zenOperator as SimpleFunction)(...(compiledArgs as Arg[]));
@@ -678,6 +682,7 @@ export const _compileStatement = (
         compoundOperator.params as string,
         compiledArgs[0] as Arg,
         compiledArgs[1] as Arg,
+        compoundOperator.messageRate,
       );
     } else if (name === "condMessage") {
       output = condMessage(
@@ -1020,6 +1025,7 @@ export const _compileStatement = (
   if (output !== undefined) {
     if (zobject) {
       compiled[zobject.id] = output;
+      attributeUGens(firstUGen, peekUUID(), zobject.id);
     }
     return output;
   }
@@ -56,6 +56,10 @@ export const zen_param = (object: ObjectNode, name: Lazy) => {
     object.attributes.mc = false;
   }
 
+  if (!object.attributes.automated) {
+    object.attributes.automated = false;
+  }
+
   if (object.attributes["tag"] === undefined) {
     object.attributes["tag"] = "";
   }
@@ -95,6 +99,7 @@ export const zen_param = (object: ObjectNode, name: Lazy) => {
           min as number,
           max as number,
           object.attributes.mc as boolean,
+          object.attributes.automated as boolean,
         );
         object.param = _param;
         object.storedParameterValue = object.storedMessage as number;
@@ -105,6 +110,7 @@ export const zen_param = (object: ObjectNode, name: Lazy) => {
           min as number,
           max as number,
           object.attributes.mc as boolean,
+          object.attributes.automated as boolean,
         );
         object.param = _param;
         object.storedParameterValue = defaultValue;
@@ -147,8 +153,10 @@ export const zen_param = (object: ObjectNode, name: Lazy) => {
         time = (time - object.patch.audioContext!.currentTime) * 44100;
         const value = isNaN(x[0] as number) ? (object.attributes.default as number) || 0 : x[0];
         const invocation = x[2] as number;
+        // optional ramp time (seconds), for glides on automated params
+        const ramp = typeof x[3] === "number" ? (x[3] as number) * 44100 : undefined;
 
-        _param.set!(value as number, Math.max(0, time), invocation);
+        _param.set!(value as number, Math.max(0, time), invocation, ramp);
 
         object.storedParameterValue = value as number;
         object.storedMessage = value as number;
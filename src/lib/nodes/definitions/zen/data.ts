@@ -18,7 +18,7 @@ export const zen_data = (_node: ObjectNode, size: Lazy, channels: Lazy) => {
   let lastSize: number = 0;
   let lastData: Message;
 
-  _node.attributeOptions.interpolation = ["linear", "none"];
+  _node.attributeOptions.interpolation = ["linear", "hermite", "none"];
   if (!_node.attributes.interpolation) {
     _node.attributes["interpolation"] = "linear";
   }
@@ -320,6 +320,24 @@ const zen: NodeFunction = (node: ObjectNode, ..._args: Lazy[]) => {
   if (!node.attributes.SIMD) {
     node.attributes.SIMD = false;
   }
+  node.attributeCallbacks.profile = (opt: AttributeValue) => {
+    if (node.subpatch?.isZenBase()) {
+      node.subpatch?.recompileGraph();
+    }
+  };
+  if (!node.attributes.profile) {
+    node.attributes.profile = false;
+  }
+  // C target: 32 sample blocks for patches on live input (see zen/blockSize.ts)
+  if (!node.attributes.blockProfile) {
+    node.attributes.blockProfile = "realtime";
+  }
+  node.attributeOptions.blockProfile = ["realtime", "low-latency"];
+  node.attributeCallbacks.blockProfile = (opt: AttributeValue) => {
+    if (node.subpatch?.isZenBase()) {
+      node.subpatch?.recompileGraph();
+    }
+  };
 
   const subpatch = node.subpatch || node.patch.newSubPatch(node.patch, node); //new SubpatchImpl(node.patch, node);
   node.subpatch = subpatch;
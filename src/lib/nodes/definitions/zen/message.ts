@@ -1,6 +1,7 @@
 import { doc } from './doc';
 import { Operator, Statement, CompoundOperator } from './types';
 import { Lazy, ObjectNode, Message } from '../../types';
+import { parseMessageRate } from '../../../zen/message';
 
 doc(
     'message',
@@ -8,7 +9,7 @@ doc(
         numberOfInlets: 3,
         numberOfOutlets: 1,
         inletNames: ["value", "name", "subtype"],
-        description: 'sends message out of worklet to main thread',
+        description: 'sends message out of worklet to main thread. rate attribute: "block", "samples N" or "change threshold" (default: once per block)',
 
     });
 
@@ -17,10 +18,14 @@ export const message = (
     name: Lazy,
     subType: Lazy
 ) => {
+    if (object.attributes.rate === undefined) {
+        object.attributes.rate = "";
+    }
     return (value: Message) => {
         let op = {
             name: "message",
-            params: name()
+            params: name(),
+            messageRate: parseMessageRate(object.attributes.rate as string)
         };
 
         let x = [[op, subType(), value]] as Statement[];
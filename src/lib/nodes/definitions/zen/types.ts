@@ -8,6 +8,7 @@ import { Clicker } from "../../../zen/click";
 import { BlockGen, Interpolation } from "../../../zen/data";
 import { History } from "../../../zen/index";
 import { ParamGen } from "../../../zen/index";
+import { MessageRate } from "../../../zen/message";
 import { Material } from "../../../zen/physical-modeling/spider-web";
 import { Component } from "../../../zen/physical-modeling/Component";
 import { SpiderWeb } from "../../../zen/physical-modeling/web-maker";
@@ -56,6 +57,7 @@ export interface CompoundOperator {
   modelComponents?: LazyComponent[];
   metallicComponent?: LazyMetallicComponent;
   uniform?: Uniform;
+  messageRate?: MessageRate;
 }
 
 export type Operator = "string" | CompoundOperator;
@@ -336,6 +336,7 @@ export type Patch = Identifiable & {
   previousDocId?: string;
   viewed?: boolean;
   disconnectGraph: () => void;
+  retireGraph: () => void;
   isZen: boolean;
   updateAttributes?: (id: string, attribute: Attributes) => void;
   isSelected?: boolean;
@@ -3,40 +3,67 @@ import { uuid } from "./uuid";
 import { LoopContext, Context } from "./context";
 import { MemoryBlock } from "./block";
 import { simdMemo } from "./memo";
+import {
+  type Precision,
+  F64_CELLS,
+  F64_TYPE,
+  encodeF64,
+  isF64,
+  printLoadF64,
+  printStoreF64,
+} from "./precision";
 
 export interface AccumParams {
   min: number;
   max: number;
   init?: number;
   exclusive?: boolean; // whether we should allow the accumulator to get to max
+  precision?: Precision; // f64 for phases that must not drift over long runs
 }
 export const accum = (incr: Arg, reset: Arg = 0, params: AccumParams) => {
   let block: MemoryBlock;
   let id = uuid();
   return simdMemo(
     (context: Context, _incr: Generated, _reset: Generated) => {
-      block = context.alloc(1);
+      let wide = isF64(params.precision, context.target);
+      block = context.alloc(wide ? F64_CELLS : 1, id);
       //let _incr = genArg(incr, context);
       //let _reset = genArg(reset, context);
       let [varName] = context.useCachedVariables(id, "accum");
 
-      if (params.init !== undefined) {
+      if (wide) {
+        block.precision = "f64";
+        block.initData = encodeF64(params.init || 0);
+      } else if (params.init !== undefined) {
         block.initData = new Float32Array([params.init]);
       }
       let resetCheck =
         typeof reset === "number" && reset === 0
           ? ""
-          : `if (${_reset.variable} > 0) ${varName} = ${params.min};`;
+          : `${varName} = ${_reset.variable} > 0 ? ${params.min} : ${varName};`;
 
       let inclusiveCase = `${params.max - params.min} + ${_incr.variable}`;
       // exclusive by default
       let exclusive = params.exclusive === undefined || params.exclusive ? true : false;
       let comp = exclusive === true ? ">=" : ">";
+      if (wide) {
+        // the wrap happens on the f64 sum, so only the output is ever rounded
+        let next = `${varName}_next`;
+        let code = `${F64_TYPE} ${varName} = ${printLoadF64(block.idx)};
+${resetCheck}
+${F64_TYPE} ${next} = ${varName} + ${_incr.variable};
+${next} = ${next} ${comp} ${params.max} ? ${next} - (${!exclusive ? inclusiveCase : params.max - params.min}) : ${next};
+${printStoreF64(block.idx, next)}
+`;
+        let generated = context.emit(code, varName, _incr, _reset);
+        generated.precision = "f64";
+        return generated;
+      }
       let code =
         `${context.varKeyword} ${varName} = memory[${block.idx}];
 ${resetCheck}
 memory[${block.idx}] = ${varName} + ${_incr.variable};
-if (memory[${block.idx}] ${comp} ${params.max}) memory[${block.idx}] -= ${!exclusive ? inclusiveCase : params.max - params.min};` +
+memory[${block.idx}] = memory[${block.idx}] ${comp} ${params.max} ? memory[${block.idx}] - (${!exclusive ? inclusiveCase : params.max - params.min}) : memory[${block.idx}];` +
         "\n";
 
       return context.emit(code, varName, _incr, _reset);
@@ -9,6 +9,7 @@ import { zswitch, zswitch_inline_then } from './switch';
 import { s } from './seq';
 import { scale } from './scale';
 import { add, sub, and, or, gt, div, mult, clamp, pow } from './math';
+import { uuid } from './uuid';
 
 export const adsr = (
     trig: Arg,
@@ -18,6 +19,7 @@ export const adsr = (
     release: Arg = 10000,
     duration: Arg = 4000
 ): UGen => {
+    let id = uuid();
 
     return (context: Context): Generated => {
         let _trig = context.gen(trig);
@@ -27,10 +29,10 @@ export const adsr = (
         let r = context.gen(release);
         let dur = context.gen(duration);
 
-        let adsrBlock: MemoryBlock = context.alloc(1);
-        let counterBlock: MemoryBlock = context.alloc(1);
-        let delayedTrig: MemoryBlock = context.alloc(1);
-        let isCanceling: MemoryBlock = context.alloc(1);
+        let adsrBlock: MemoryBlock = context.alloc(1, id);
+        let counterBlock: MemoryBlock = context.alloc(1, id);
+        let delayedTrig: MemoryBlock = context.alloc(1, id);
+        let isCanceling: MemoryBlock = context.alloc(1, id);
 
         let [trigger, adsrVal, counter] = context
             .useVariables('trigger', 'adsrVal', 'counter');
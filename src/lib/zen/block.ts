@@ -1,4 +1,5 @@
 import { Context, LoopContext, ContextMessageType } from "./context";
+import type { Precision } from "./precision";
 
 export interface Block {
   idx: number | string;
@@ -32,6 +33,8 @@ export class MemoryBlock extends AbstractIndexer {
   name?: string;
   min?: number;
   max?: number;
+  precision?: Precision; // "f64": one value in two cells (see precision.ts)
+  owner?: string; // what allocated it, the same from one compile to the next (see context.alloc)
 
   constructor(
     context: Context,
@@ -0,0 +1,47 @@
+/**
+ * Samples per process() call of a C kernel (BLOCK_SIZE in the printed code), fixed when
+ * the graph is compiled: block-rate state, scratch arrays and output strides are all laid
+ * out for it.
+ *
+ * The worklet is handed 128 frames at a time (the Web Audio render quantum), so a live
+ * kernel runs at most that, and smaller blocks divide it: at 32 a kernel runs 4 times per
+ * quantum, and everything it does per block (param events, message checks, block-rate
+ * reads of params and wake arguments) happens 4 times as often. Bigger blocks only make
+ * sense rendering offline or natively, where there's no quantum and the per-block
+ * overhead (event ring, function calls, loop setup) is amortized over more samples.
+ *
+ * Javascript kernels run per quantum and always use DEFAULT_BLOCK_SIZE.
+ */
+export const DEFAULT_BLOCK_SIZE = 128;
+
+export type BlockProfile = "low-latency" | "realtime" | "throughput" | "offline";
+
+export const BLOCK_PROFILES: Record<BlockProfile, number> = {
+  "low-latency": 32,
+  realtime: DEFAULT_BLOCK_SIZE,
+  throughput: 512,
+  offline: 1024,
+};
+
+// a power of two, so SIMD loops (up to 16 lanes) step whole vectors
+const MIN_BLOCK_SIZE = 16;
+const MAX_BLOCK_SIZE = 4096;
+
+export const checkBlockSize = (blockSize: number) => {
+  if (
+    !Number.isInteger(blockSize) ||
+    blockSize < MIN_BLOCK_SIZE ||
+    blockSize > MAX_BLOCK_SIZE ||
+    (blockSize & (blockSize - 1)) !== 0
+  ) {
+    throw new Error(
+      `block size must be a power of two from ${MIN_BLOCK_SIZE} to ${MAX_BLOCK_SIZE}, got ${blockSize}`,
+    );
+  }
+};
+
+/**
+ * Whether a kernel compiled with blockSize can run in the worklet.
+ */
+export const isRealtimeBlockSize = (blockSize: number): boolean =>
+  blockSize <= DEFAULT_BLOCK_SIZE;
@@ -245,3 +245,159 @@ const _determineBlocks = (
 };
 
 const getContext = (context: Context) => context; //context.transformIntoContext || context;
+
+// a one-line declaration, as UGens print them (some with a stray extra semicolon)
+export const DECLARATION = /^\s*(?:float|double|zen_f64|int|v128_t)\s+(\w+)\s*=\s*([^;]*);[;\s]*$/;
+const CALL = /\b([A-Za-z_]\w*)\s*\(/g;
+// helpers whose only effect is their result (wasm_*, the vector math and lookup kernels, libm)
+const PURE_CALL =
+  /^(wasm_\w+|zen_f32x4_\w+|zen_lane_of|float_blend|exp2?|log(2|10)?|pow|sqrt|a?sinh?|a?cosh?|a?tanh?|atan2|floor|ceil|round|trunc|fabs|fmod|fmin|fmax)$/;
+
+export const isPure = (expression: string) =>
+  !/[^=!<>]=(?!=)|\+\+|--/.test(expression) &&
+  Array.from(expression.matchAll(CALL)).every((call) => PURE_CALL.test(call[1]));
+
+// the identifiers in some code, with a block_ array standing for its variable
+const identifiersOf = (code: string): string[] =>
+  (code.match(/\b\w+\b/g) || []).map((x) => (x.startsWith("block_") ? x.slice(6) : x));
+
+/**
+ * Drops the declarations of a block that nothing reads: not later code in the block, its
+ * live outbound variables or its outputs. Anything with a side effect (memory writes,
+ * messages, noise, calls to user functions) is a statement rather than a pure declaration,
+ * so only values die here, never effects.
+ */
+const eliminateDeadDeclarations = (block: CodeBlock, live: Set<string>): CodeBlock => {
+  const lines = block.code.split("\n");
+  const identifiers = lines.map(identifiersOf);
+  // how many times each identifier appears in the lines still alive (and the histories)
+  const uses = new Map<string, number>();
+  const count = (names: string[], n: number) =>
+    names.forEach((x) => uses.set(x, (uses.get(x) || 0) + n));
+  identifiers.forEach((names) => count(names, 1));
+  block.histories.forEach((history) => count(identifiersOf(history), 1));
+
+  const dead = new Set<number>();
+  for (let changed = true; changed; ) {
+    changed = false;
+    for (let i = lines.length - 1; i >= 0; i--) {
+      const declaration = dead.has(i) ? null : lines[i].match(DECLARATION);
+      if (
+        declaration &&
+        !live.has(declaration[1]) &&
+        uses.get(declaration[1]) === identifiers[i].filter((x) => x === declaration[1]).length &&
+        isPure(declaration[2])
+      ) {
+        dead.add(i);
+        count(identifiers[i], -1);
+        changed = true;
+      }
+    }
+  }
+  return dead.size === 0
+    ? block
+    : { ...block, code: lines.filter((_, i) => !dead.has(i)).join("\n") };
+};
+
+const OUTPUT_COPY = /^\s*(?:float|double)\s+output(\d+)\s*=\s*(\w+)\s*;\s*$/;
+
+/**
+ * A scalar block that only copies SIMD results into outputs (output() is always scalar)
+ * costs a store to a block_ array and a reload per value. Instead the SIMD block producing
+ * the values writes the outputs itself and the copying block goes away.
+ */
+export const forwardOutputs = (blocks: CodeBlock[]): CodeBlock[] => {
+  let _blocks = [...blocks];
+  for (const block of blocks) {
+    if (block.context.isSIMD || block.context.isFunctionCaller) {
+      continue;
+    }
+    const lines = block.code.split("\n").filter((x) => x.trim() !== "");
+    const copies = lines.map((line) => line.match(OUTPUT_COPY));
+    const index = _blocks.indexOf(block);
+    const producers = copies.map((copy) =>
+      copy && block.inboundDependencies.has(copy[2])
+        ? _blocks
+            .slice(0, index)
+            .reverse()
+            .find((b) => b.outboundDependencies.has(copy[2]))
+        : undefined,
+    );
+    if (lines.length === 0 || producers.some((x) => !x?.context.isSIMD)) {
+      continue;
+    }
+    copies.forEach((copy, i) => {
+      const producer = producers[i]!;
+      const forwarded: CodeBlock = {
+        ...producer,
+        code: `${producer.code}\nv128_t output${copy![1]} = ${copy![2]};`,
+        outputs: [...producer.outputs, parseInt(copy![1])],
+      };
+      _blocks = _blocks.map((b) => (b === producer ? forwarded : b));
+      producers.forEach((x, j) => {
+        if (x === producer) {
+          producers[j] = forwarded;
+        }
+      });
+    });
+    _blocks = _blocks.filter((b) => b !== block);
+  }
+  return _blocks;
+};
+
+/**
+ * Liveness over the blocks of one function body. A variable crossing blocks is live if some
+ * other block still reads it (its name, or its block_ array for a function call); values
+ * feeding only dead variables die with them, so their block_ arrays, stores and loads go
+ * too. Outputs, memory writes and messages are the roots that keep everything else alive.
+ *
+ * Memory writes are never dropped: the host reads memory back (histories, data), so a slot
+ * nothing in the kernel reads isn't necessarily dead.
+ */
+export const eliminateDeadCode = (_blocks: CodeBlock[]): CodeBlock[] => {
+  let blocks = _blocks;
+  for (let changed = true; changed; ) {
+    changed = false;
+    const reads = blocks.map(
+      (b) =>
+        new Set([
+          ...identifiersOf(b.code),
+          ...(b.context.isFunctionCaller ? [] : Array.from(b.inboundDependencies)),
+        ]),
+    );
+    blocks = blocks.map((block, i) => {
+      if (block.context.isFunctionCaller) {
+        return block;
+      }
+      const outboundDependencies = new Set(
+        Array.from(block.outboundDependencies).filter(
+          (variable) => variable.includes("+") || reads.some((x, j) => j !== i && x.has(variable)),
+        ),
+      );
+      const live = new Set([...outboundDependencies, ...block.outputs.map((x) => `output${x}`)]);
+      const pruned = eliminateDeadDeclarations(block, live);
+      const used = new Set(identifiersOf(pruned.code + "\n" + block.histories.join("\n")));
+      const inboundDependencies = new Set(
+        Array.from(block.inboundDependencies).filter(
+          (variable) => variable.includes("+") || used.has(variable),
+        ),
+      );
+      if (
+        pruned === block &&
+        outboundDependencies.size === block.outboundDependencies.size &&
+        inboundDependencies.size === block.inboundDependencies.size
+      ) {
+        return block;
+      }
+      changed = true;
+      return { ...pruned, outboundDependencies, inboundDependencies };
+    });
+  }
+  return blocks.filter(
+    (block) =>
+      block.context.isFunctionCaller ||
+      block.code.trim() !== "" ||
+      block.outputs.length > 0 ||
+      block.outboundDependencies.size > 0,
+  );
+};
@@ -0,0 +1,263 @@
+/**
+ * Loop fusion for the blocks produced by determineBlocks.
+ *
+ * determineBlocks emits blocks in dependency order, which tends to interleave
+ * scalar and SIMD blocks (e.g. every cycle() is a scalar phasor block followed by a
+ * SIMD block), so mergeAdjacentBlocks has little to merge and every value that crosses
+ * a block goes through a block_xxx[128] array.
+ *
+ * scheduleBlocks reorders blocks (without crossing function calls) so that blocks of
+ * the same kind end up next to each other and get merged into one loop, and
+ * pruneOutboundDependencies then drops the arrays nothing outside the merged loop reads,
+ * so values stay in registers unless they cross a scalar<->SIMD or function boundary.
+ *
+ * Calls to user functions are scheduled too, using a FunctionSummary of what the printed
+ * function body touches, so calls to the same function gather up into batches that
+ * printFunction can run in parallel.
+ */
+
+import type { CodeBlock } from "./analyze";
+import type { LoopContext } from "../context";
+
+interface BlockEffects {
+  reads: Set<string>;
+  writes: Set<string>;
+  // constant memory indices, or "*" if the block indexes memory with an expression
+  memoryReads: Set<string>;
+  memoryWrites: Set<string>;
+  // messages, noise etc: must keep their relative order
+  sideEffects: boolean;
+}
+
+/**
+ * What a printed user function does to shared state: the memory it touches (per-invocation
+ * slots are printed as "A + k*invocation") and whether different invocations can run
+ * at the same time.
+ */
+export interface FunctionSummary {
+  name: string;
+  memory: { index: string; write: boolean }[];
+  sideEffects: boolean;
+  parallel: boolean;
+}
+
+export type FunctionSummaries = Map<string, FunctionSummary>;
+
+const MEMORY_ACCESS = /(&?)memory\s*\[([^\]]*)\](\s*[-+*/]?=(?!=))?/g;
+// an f64 cell (see precision.ts) is only ever accessed whole, so it's known by its first index
+const F64_ACCESS = /\bzen_(load|store)_f64\(\s*memory\s*\+\s*([^,)]*)/g;
+const SIDE_EFFECTS = /\b(new_message|rand|random_double)\s*\(/;
+const INVOCATION_SLOT = /^\s*(\d+)\s*\+\s*(\d+)\s*\*\s*invocation\s*$/;
+const CALL = /^\s*(\w+)\s*\(\s*(\d+)\s*,/;
+
+const memoryAccesses = (code: string) => [
+  ...Array.from(code.matchAll(MEMORY_ACCESS)).map(([, address, index, assignment]) => ({
+    index: index.trim(),
+    write: Boolean(address || assignment),
+  })),
+  ...Array.from(code.matchAll(F64_ACCESS)).map(([, op, index]) => ({
+    index: index.trim(),
+    write: op === "store",
+  })),
+];
+
+const calls = (code: string, name: string) => new RegExp(`\\b${name}\\s*\\(`).test(code);
+
+export const summarizeFunction = (
+  name: string,
+  code: string,
+  functionNames: string[],
+): FunctionSummary => {
+  const memory = memoryAccesses(code);
+  const sideEffects =
+    SIDE_EFFECTS.test(code) || functionNames.some((x) => x !== name && calls(code, x));
+  return {
+    name,
+    memory,
+    sideEffects,
+    parallel: !sideEffects && memory.every((x) => !x.write || INVOCATION_SLOT.test(x.index)),
+  };
+};
+
+// a function that hasn't been printed (and summarized) yet might do anything
+export const unknownFunction = (name: string): FunctionSummary => ({
+  name,
+  memory: [{ index: "*", write: true }],
+  sideEffects: true,
+  parallel: false,
+});
+
+const resolveSlot = (index: string, invocation?: number): string => {
+  if (/^\d+$/.test(index)) {
+    return index;
+  }
+  const slot = index.match(INVOCATION_SLOT);
+  return slot && invocation !== undefined
+    ? `${parseInt(slot[1]) + parseInt(slot[2]) * invocation}`
+    : "*";
+};
+
+export const parseCall = (block: CodeBlock): { name: string; invocation: number } | undefined => {
+  const call = block.context.isFunctionCaller ? block.code.match(CALL) : null;
+  return call ? { name: call[1], invocation: parseInt(call[2]) } : undefined;
+};
+
+const inboundOf = (block: CodeBlock): Set<string> => {
+  const inbound = new Set([...block.inboundDependencies, ...block.fullInboundDependencies]);
+  (block.context as LoopContext).inboundDependencies?.forEach((d) => inbound.add(d));
+  return inbound;
+};
+
+const analyzeEffects = (block: CodeBlock, functions: FunctionSummaries): BlockEffects => {
+  const code = block.code + "\n" + block.histories.join("\n");
+  const reads = inboundOf(block);
+  const writes = new Set(block.outboundDependencies);
+  const memoryReads = new Set<string>();
+  const memoryWrites = new Set<string>();
+  let sideEffects = SIDE_EFFECTS.test(code);
+
+  const touch = (index: string, write: boolean, invocation?: number) =>
+    (write ? memoryWrites : memoryReads).add(resolveSlot(index, invocation));
+  for (const { index, write } of memoryAccesses(code)) {
+    touch(index, write);
+  }
+
+  // a call (from a function-caller block, or latchcall inside a scalar block) has the
+  // effects of the function body, for the invocation being called
+  const call = parseCall(block);
+  for (const [name, summary] of functions) {
+    if (code.includes(`${name}_out`)) {
+      reads.add(`${name}_out`);
+    }
+    if (!calls(code, name)) {
+      continue;
+    }
+    writes.add(`${name}_out`);
+    sideEffects ||= summary.sideEffects;
+    for (const { index, write } of summary.memory) {
+      touch(index, write, call?.name === name ? call.invocation : undefined);
+    }
+  }
+  return { reads, writes, memoryReads, memoryWrites, sideEffects };
+};
+
+const intersects = (a: Set<string>, b: Set<string>): boolean => {
+  if (a.has("*") ? b.size > 0 : b.has("*") && a.size > 0) {
+    return true;
+  }
+  for (const x of a) {
+    if (b.has(x)) {
+      return true;
+    }
+  }
+  return false;
+};
+
+const touchesSameMemory = (a: BlockEffects, b: BlockEffects): boolean =>
+  intersects(a.memoryWrites, b.memoryWrites) ||
+  intersects(a.memoryWrites, b.memoryReads) ||
+  intersects(a.memoryReads, b.memoryWrites);
+
+const mustPrecede = (a: BlockEffects, b: BlockEffects): boolean =>
+  intersects(a.writes, b.reads) ||
+  intersects(a.reads, b.writes) ||
+  intersects(a.writes, b.writes) ||
+  touchesSameMemory(a, b) ||
+  (a.sideEffects && b.sideEffects);
+
+// calls are only grouped with calls to the same function
+const kindOf = (block: CodeBlock): string =>
+  parseCall(block)?.name ?? (block.context.isSIMD ? "simd" : "scalar");
+
+const scheduleSegment = (segment: CodeBlock[], functions: FunctionSummaries): CodeBlock[] => {
+  const effects = segment.map((block) => analyzeEffects(block, functions));
+  const predecessors = segment.map((block, i) => {
+    const preds: number[] = [];
+    for (let j = 0; j < i; j++) {
+      const sameOutput = segment[j].outputs.some((o) => block.outputs.includes(o));
+      if (sameOutput || mustPrecede(effects[j], effects[i])) {
+        preds.push(j);
+      }
+    }
+    return preds;
+  });
+
+  const done = new Set<number>();
+  const order: number[] = [];
+  let run: number[] = [];
+  while (order.length < segment.length) {
+    const ready = segment
+      .map((_, i) => i)
+      .filter((i) => !done.has(i) && predecessors[i].every((j) => done.has(j)));
+    const last = order[order.length - 1];
+
+    // extend the current loop with a block of the same kind. blocks that share memory
+    // slots with it only join if they were already adjacent, so per-sample interleaving
+    // of state is never introduced by the reordering itself
+    const next =
+      ready.find(
+        (i) =>
+          last !== undefined &&
+          kindOf(segment[i]) === kindOf(segment[last]) &&
+          (i === last + 1 || run.every((j) => !touchesSameMemory(effects[j], effects[i]))),
+      ) ?? ready[0];
+
+    if (last === undefined || kindOf(segment[next]) !== kindOf(segment[last])) {
+      run = [];
+    }
+    run.push(next);
+    done.add(next);
+    order.push(next);
+  }
+  return order.map((i) => segment[i]);
+};
+
+/**
+ * Reorders blocks so that independent blocks of the same kind (scalar/SIMD/calls to one
+ * function) are adjacent. Empty blocks act as fences: nothing is moved across them.
+ */
+export const scheduleBlocks = (
+  blocks: CodeBlock[],
+  functions: FunctionSummaries = new Map(),
+): CodeBlock[] => {
+  const known = new Map(functions);
+  for (const block of blocks) {
+    const call = parseCall(block);
+    if (call && !known.has(call.name)) {
+      known.set(call.name, unknownFunction(call.name));
+    }
+  }
+
+  const scheduled: CodeBlock[] = [];
+  let segment: CodeBlock[] = [];
+  for (const block of blocks) {
+    if (block.codeFragment.code === "" || (block.context.isFunctionCaller && !parseCall(block))) {
+      scheduled.push(...scheduleSegment(segment, known), block);
+      segment = [];
+    } else {
+      segment.push(block);
+    }
+  }
+  scheduled.push(...scheduleSegment(segment, known));
+  return scheduled;
+};
+
+/**
+ * Once blocks are merged, a value that was only passed between the blocks that now
+ * share a loop no longer needs its block_xxx array: only keep outbound dependencies
+ * that another block loads, or that a function call passes by name.
+ */
+export const pruneOutboundDependencies = (blocks: CodeBlock[]): CodeBlock[] => {
+  return blocks.map((block) => {
+    const others = blocks.filter((b) => b !== block);
+    const outboundDependencies = new Set(
+      Array.from(block.outboundDependencies).filter(
+        (variable) =>
+          variable.includes("+") ||
+          others.some((b) => inboundOf(b).has(variable)) ||
+          others.some((b) => new RegExp(`\\bblock_${variable}\\b`).test(b.code)),
+      ),
+    );
+    return { ...block, outboundDependencies };
+  });
+};
@@ -0,0 +1,284 @@
+/**
+ * Local value numbering over the code of each block, run by printFunction between
+ * determineBlocks and printing. UGens emit their fragments independently, so the printed
+ * blocks recompute the same values (the wrap arithmetic of every cycle(), the splats of
+ * every comparison) and carry constant chains no UGen could see whole.
+ *
+ * Within a block, in order:
+ * - declarations whose expression is all literals are evaluated (as C would evaluate them)
+ * - splat(a) op splat(b) folds into one splat, and x - 0, x * 1, x / 1 become x (x + 0
+ *   doesn't: it turns -0 into +0)
+ * - a pure expression already computed in an enclosing scope reuses that variable
+ * - in SIMD blocks, expressions of constants and uniforms only are hoisted out of the
+ *   sample loop, along with the splats printFunction already hoists
+ *
+ * A replaced declaration becomes a copy (its variable may be read by other blocks) and its
+ * uses are renamed, so eliminateDeadCode then drops whatever copies nothing reads.
+ */
+
+import type { CodeBlock } from "./analyze";
+import { DECLARATION, isPure } from "./analyze";
+import { F64_TYPE } from "../precision";
+
+type Scope = { keys: string[] };
+
+const NUMBER = /^-?(\d+\.?\d*|\.\d+)(e[-+]?\d+)?f?$/i;
+const LITERALS = /^[\d.e+\-*/() ]+$/i;
+const SPLAT = /^wasm_f32x4_splat\(\s*([^()]*?)\s*\)$/;
+const VECTOR_OP = /^wasm_f32x4_(add|sub|mul|div)\(\s*(\w+)\s*,\s*(\w+)\s*\)$/;
+const SCALAR_OP = /^(\w+|-?[\d.]+(?:e[-+]?\d+)?)\s*([-+*/])\s*(\w+|-?[\d.]+(?:e[-+]?\d+)?)$/i;
+const REASSIGNED = /\b(\w+)\s*(?:[-+*/%&|^]?=(?!=)|\+\+|--)/g;
+// variables the block printer hoists above the loops (see printFunction)
+const HOISTED = /^(constant|uniform)/;
+
+const evaluate = {
+  add: (a: number, b: number) => a + b,
+  sub: (a: number, b: number) => a - b,
+  mul: (a: number, b: number) => a * b,
+  div: (a: number, b: number) => a / b,
+};
+const OPERATORS: Record<string, keyof typeof evaluate> = {
+  "+": "add",
+  "-": "sub",
+  "*": "mul",
+  "/": "div",
+};
+
+// a literal and whether C types it int (no point or exponent)
+type Literal = { value: number; integer: boolean };
+
+const TOKEN = /^(\d+\.?\d*(?:e[-+]?\d+)?|\.\d+(?:e[-+]?\d+)?|[-+*/()])\s*/i;
+
+/**
+ * The value C gives an expression of literals, or undefined when it can't be matched
+ * exactly: integer division, or integer arithmetic that could overflow. Expressions are
+ * the + - * / and parentheses LITERALS allows, parsed by precedence like C.
+ */
+const evaluateLiterals = (expression: string): number | undefined => {
+  if (!LITERALS.test(expression)) {
+    return undefined;
+  }
+  const tokens: string[] = [];
+  for (let rest = expression.trim(); rest !== ""; ) {
+    const token = rest.match(TOKEN);
+    if (!token) {
+      return undefined;
+    }
+    tokens.push(token[1]);
+    rest = rest.slice(token[0].length);
+  }
+  let position = 0;
+
+  const apply = (operator: string, a: Literal, b: Literal): Literal | undefined => {
+    const integer = a.integer && b.integer;
+    if (integer && operator === "/") {
+      return undefined;
+    }
+    const value = evaluate[OPERATORS[operator]](a.value, b.value);
+    if (!isFinite(value) || (integer && Math.abs(value) >= 2 ** 31)) {
+      return undefined;
+    }
+    return { value, integer };
+  };
+
+  const binary =
+    (operators: string, operand: () => Literal | undefined) => (): Literal | undefined => {
+      let a = operand();
+      while (a && operators.includes(tokens[position])) {
+        const operator = tokens[position++];
+        const b = operand();
+        a = b && apply(operator, a, b);
+      }
+      return a;
+    };
+
+  const unary = (): Literal | undefined => {
+    const token = tokens[position++];
+    if (token === "-" || token === "+") {
+      const a = unary();
+      return a && { value: token === "-" ? -a.value : a.value, integer: a.integer };
+    }
+    if (token === "(") {
+      const a = sum();
+      return tokens[position++] === ")" ? a : undefined;
+    }
+    return token && NUMBER.test(token)
+      ? { value: parseFloat(token), integer: !/[.e]/i.test(token) }
+      : undefined;
+  };
+  const product = binary("*/", unary);
+  const sum = binary("+-", product);
+
+  const result = sum();
+  return result && position === tokens.length ? result.value : undefined;
+};
+
+const numberOf = (literal: string): number | undefined =>
+  NUMBER.test(literal) ? parseFloat(literal) : undefined;
+
+// a float literal C reads back as the same value: -0 alone would be the int 0
+const printFloat = (value: number) => (Object.is(value, -0) ? "-0.0" : `${value}`);
+
+/**
+ * Whether a op b is always a (or b, with left set), sign of zero included: -0 + 0 is +0,
+ * so x + 0 isn't x, but x - 0 and x + -0 are.
+ */
+const isIdentity = (operator: string, operand: number | undefined, left = false) =>
+  left
+    ? (operator === "add" && Object.is(operand, -0)) || (operator === "mul" && operand === 1)
+    : (operator === "add" && Object.is(operand, -0)) ||
+      (operator === "sub" && Object.is(operand, 0)) ||
+      ((operator === "mul" || operator === "div") && operand === 1);
+
+export const optimizeBlock = (block: CodeBlock): CodeBlock => {
+  const lines = block.code.split("\n");
+  const isSIMD = block.context.isSIMD;
+
+  // a variable written after its declaration doesn't hold one value, so it's left alone
+  const reassigned = new Set<string>();
+  for (const line of lines) {
+    const code = line.match(DECLARATION)?.[2] ?? line;
+    for (const [, name] of Array.from(code.matchAll(REASSIGNED))) {
+      reassigned.add(name);
+    }
+  }
+
+  const renames = new Map<string, string>();
+  const types = new Map<string, string>();
+  // float/int variables holding a literal, and vectors holding a splat of one
+  const literals = new Map<string, number>();
+  const splats = new Map<string, number>();
+  const available = new Map<string, string>();
+  const invariant = new Set<string>();
+  const scopes: Scope[] = [{ keys: [] }];
+
+  const typeOf = (variable: string) =>
+    types.get(variable) ??
+    (block.inboundDependencies.has(variable) ? (isSIMD ? "v128_t" : "float") : undefined);
+
+  const rename = (line: string) => line.replace(/\b\w+\b/g, (x) => renames.get(x) ?? x);
+
+  const optimized = lines.map((_line) => {
+    let line = rename(_line);
+    const declaration = line.match(DECLARATION);
+    if (declaration && !reassigned.has(declaration[1]) && isPure(declaration[2])) {
+      const name = declaration[1];
+      const type = line.trim().split(/\s+/)[0];
+      let expression = declaration[2].trim();
+      types.set(name, type);
+
+      const copyOf = (variable: string) => {
+        if (typeOf(variable) !== type || reassigned.has(variable)) {
+          return false;
+        }
+        renames.set(name, variable);
+        expression = variable;
+        return true;
+      };
+
+      if (type === "v128_t") {
+        const op = expression.match(VECTOR_OP);
+        const splat = expression.match(SPLAT);
+        if (splat && numberOf(splat[1]) !== undefined) {
+          splats.set(name, Math.fround(numberOf(splat[1])!));
+        } else if (op) {
+          const [, operator, a, b] = op;
+          const x = splats.get(a);
+          const y = splats.get(b);
+          if (x !== undefined && y !== undefined) {
+            const value = Math.fround(evaluate[operator as keyof typeof evaluate](x, y));
+            if (isFinite(value)) {
+              expression = `wasm_f32x4_splat(${printFloat(value)})`;
+              splats.set(name, value);
+            }
+          } else if (isIdentity(operator, y)) {
+            copyOf(a);
+          } else if (isIdentity(operator, x, true)) {
+            copyOf(b);
+          }
+        }
+      } else if (type !== F64_TYPE && !/\[|memory/.test(expression)) {
+        // literals are substituted into a single operation, whose one rounding C matches
+        const op = expression.match(SCALAR_OP);
+        const substituted = op
+          ? [op[1], op[3]].map((x) =>
+              literals.has(x) ? `(${printFloat(literals.get(x)!)})` : x,
+            )
+          : undefined;
+        let value = evaluateLiterals(
+          substituted ? `${substituted[0]} ${op![2]} ${substituted[1]}` : expression,
+        );
+        if (value !== undefined && type === "int" && !Number.isInteger(value)) {
+          value = undefined;
+        }
+        if (value !== undefined) {
+          expression = type === "int" ? `${value + 0}` : printFloat(value);
+          literals.set(name, type === "int" ? value + 0 : Math.fround(value));
+        } else if (op && /^(float|double)$/.test(type)) {
+          const [, a, operator, b] = op;
+          const x = literals.get(a) ?? numberOf(a);
+          const y = literals.get(b) ?? numberOf(b);
+          if (isIdentity(OPERATORS[operator], y)) {
+            copyOf(a);
+          } else if (isIdentity(OPERATORS[operator], x, true)) {
+            copyOf(b);
+          }
+        }
+      }
+
+      const identifiers = expression.match(/\b[A-Za-z_]\w*\b(?!\s*\()/g) || [];
+      const key = `${type} ${expression.replace(/\s+/g, "")}`;
+      const reusable =
+        !renames.has(name) &&
+        !/\[|memory|load/.test(expression) &&
+        !identifiers.some((x) => reassigned.has(x));
+      let hoisted = "";
+      if (reusable && available.has(key)) {
+        renames.set(name, available.get(key)!);
+        expression = available.get(key)!;
+      } else if (reusable) {
+        let value = name;
+        // block-rate values are computed once, above the loop
+        if (
+          isSIMD &&
+          type === "v128_t" &&
+          !HOISTED.test(name) &&
+          scopes.length === 1 &&
+          identifiers.every((x) => invariant.has(x) || HOISTED.test(x))
+        ) {
+          const constant = identifiers.every((x) => x.startsWith("constant"));
+          value = `${constant ? "constant" : "uniform"}_${name}`;
+          hoisted = `v128_t ${value} = ${expression};\n`;
+          renames.set(name, value);
+          expression = value;
+        }
+        if (HOISTED.test(value)) {
+          invariant.add(value);
+        }
+        available.set(key, value);
+        scopes[scopes.length - 1].keys.push(key);
+      }
+      if (splats.has(name) && renames.has(name)) {
+        splats.set(renames.get(name)!, splats.get(name)!);
+      }
+
+      line = `${hoisted}${type} ${name} = ${expression};`;
+    }
+
+    if (!line.trim().startsWith("@")) {
+      for (const brace of line.match(/[{}]/g) || []) {
+        if (brace === "{") {
+          scopes.push({ keys: [] });
+        } else if (scopes.length > 1) {
+          scopes.pop()!.keys.forEach((key) => available.delete(key));
+        }
+      }
+    }
+    return line;
+  });
+
+  return { ...block, code: optimized.join("\n") };
+};
+
+export const optimizeBlocks = (blocks: CodeBlock[]): CodeBlock[] =>
+  blocks.map((block) => (block.context.isFunctionCaller ? block : optimizeBlock(block)));
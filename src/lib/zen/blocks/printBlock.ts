@@ -1,10 +1,21 @@
 import type { CodeBlock } from "./analyze";
 import { replaceAll } from "../replaceAll";
-import type { Function } from "../functions";
+import type { Argument, Function } from "../functions";
 import type { LoopContext } from "../context";
-import { determineBlocks } from "./analyze";
+import { determineBlocks, eliminateDeadCode, forwardOutputs } from "./analyze";
+import { optimizeBlocks } from "./optimize";
 import { countOutputs } from "../zen";
 import { Target } from "../targets";
+import { AFTER_BLOCK, BEFORE_BLOCK } from "../message";
+import {
+  scheduleBlocks,
+  pruneOutboundDependencies,
+  parseCall,
+  type FunctionSummaries,
+} from "./fuse";
+import { printProfiled, type ProfileSection } from "../memory/profile";
+import { promoteState } from "./promote";
+import { F64_TYPE } from "../precision";
 
 export const printBlock = (
   outputName: string,
@@ -13,6 +24,7 @@ export const printBlock = (
   isLast?: boolean,
   forceScalar?: boolean,
   target?: Target,
+  numberOfOutputs = Math.max(...block.outputs) + 1,
 ): string => {
   if (block.context.isFunctionCaller) {
     return `
@@ -20,8 +32,9 @@ ${block.code}
 `;
   }
 
+  const { code: blockCode, before, after } = hoistPerBlock(block.code);
   let post = `
-${prettify("    ", block.code)}
+${prettify("    ", blockCode)}
 ${isLast ? "" : prettify("    ", printOutbound(block))}
 `;
 
@@ -41,36 +54,47 @@ ${isLast ? "" : prettify("    ", printOutbound(block))}
             block.histories
               .filter(
                 (h) =>
-                  post.includes(
-                    h.includes("double") || h.includes("float") ? h.split(" ")[1] : h,
-                  ) &&
-                  (h.includes("float") || h.includes("double")) &&
+                  // (a whole word: historyVal11 isn't read by code using historyVal110)
+                  (h.includes("double") || h.includes("float") || h.includes(F64_TYPE)
+                    ? new RegExp(`\\b${h.split(" ")[1]}\\b`).test(post)
+                    : post.includes(h)) &&
+                  (h.includes("float") || h.includes("double") || h.includes(F64_TYPE)) &&
                   !Array.from(block.fullInboundDependencies).some((y) => {
                     return h.split(" ").some((h1) => h1 === y);
                   }),
               )
-              .map((x) => (x.includes("/* param") ? x.slice(0, x.indexOf("/*")) + ";\n" : x)),
+              .map((x) => (x.includes("/* param") ? x.slice(0, x.indexOf("/*")) + ";\n" : x))
+              // inside the sample loop an automated param reads its per-sample lane
+              .map((x) =>
+                forceScalar ? x : x.replace(/ZEN_LANE\((\d+), \d+\)/g, "zen_automation[$1][j]"),
+              ),
           ),
         );
 
   const inbound = printInbound(block, histories, post);
-  let code = "";
-  const varKeyword = target === Target.C ? "int" : "let";
-  if (!forceScalar) {
-    code += `
-for (${varKeyword} j=0; j < BLOCK_SIZE; j+= ${block.context.isSIMD ? 4 : 1}) {
-`;
-  }
-  code += `
+  let code = `
 ${!block.context.isSIMD ? prettify("    ", histories.join("\n")) : ""}
 ${prettify("    ", inbound)}
 ${post}
 `;
   if (block.outputs.length > 0) {
-    code += printOutputs(outputName, block, totalInvocations, forceScalar, target);
+    code += printOutputs(outputName, block, totalInvocations, forceScalar, target, numberOfOutputs);
   }
   if (!forceScalar) {
-    code += "}\n";
+    const varKeyword = target === Target.C ? "int" : "let";
+    // SIMD_WIDTH is 4 for wasm, but native builds widen v128_t to whatever the ISA has
+    const step = block.context.isSIMD ? (target === Target.C ? "SIMD_WIDTH" : 4) : 1;
+    // the state a scalar loop carries between samples is kept in locals (scoped to the loop)
+    const state =
+      target === Target.C && !block.context.isSIMD ? promoteState(code, block.context) : undefined;
+    code = `
+${before}
+${state ? `{\n${state.load}` : ""}
+for (${varKeyword} j=0; j < BLOCK_SIZE; j+= ${step}) {
+${state ? state.body : code}}
+${state ? `${state.store}\n}` : ""}
+${after}
+`;
   }
   return code
     .split("\n")
@@ -78,17 +102,44 @@ ${post}
     .join("\n");
 };
 
+/**
+ * Pulls out the lines a UGen wants run once per block instead of every sample (message()
+ * checking its rate): declarations go before the sample loop and the rest after it.
+ */
+const hoistPerBlock = (code: string): { code: string; before: string; after: string } => {
+  const lines = code.split("\n");
+  const marked = (marker: string) =>
+    lines
+      .filter((x) => x.trim().startsWith(marker))
+      .map((x) => x.trim().slice(marker.length))
+      .join("\n");
+  return {
+    code: lines
+      .filter((x) => !x.trim().startsWith(BEFORE_BLOCK) && !x.trim().startsWith(AFTER_BLOCK))
+      .join("\n"),
+    before: marked(BEFORE_BLOCK),
+    after: marked(AFTER_BLOCK),
+  };
+};
+
 export const printOutputs = (
   outputName: string,
   block: CodeBlock,
   totalInvocations?: number,
   forceScalar?: boolean,
   target?: Target,
+  numberOfOutputs = Math.max(...block.outputs) + 1,
 ): string => {
   let out = "";
-  const numberOfOutputs = Math.max(...block.outputs) + 1;
+  const blockSize = block.context.blockSize;
   for (const output of block.outputs) {
-    if (totalInvocations) {
+    if (block.context.isSIMD && target === Target.C && !forceScalar) {
+      const offset = totalInvocations
+        ? `${output * blockSize} + ${numberOfOutputs} * invocation * ${blockSize}`
+        : `${output * blockSize}`;
+      out += `    wasm_v128_store(${outputName} + ${offset} + j, output${output});
+`;
+    } else if (totalInvocations) {
       if (target === Target.Javascript) {
         out += `    this.${outputName}[invocation][${output * 1}] = output${output};
 `;
@@ -96,12 +147,12 @@ export const printOutputs = (
         out += `    ${outputName}[${output * 1} + ${numberOfOutputs} * invocation ] = output${output};
 `;
       } else {
-        out += `    ${outputName} [${output * 128} + ${numberOfOutputs} * invocation * 128 + j] = output${output};
+        out += `    ${outputName} [${output * blockSize} + ${numberOfOutputs} * invocation * ${blockSize} + j] = output${output};
                 `;
       }
     } else {
       if (target === Target.C) {
-        out += `    ${outputName} [${output * 128} + j] = output${output};
+        out += `    ${outputName} [${output * blockSize} + j] = output${output};
                 `;
       } else {
         out += `    ${outputName} [0][${output}][j] = output${output};
@@ -164,7 +215,7 @@ export const printOutbound = (block: CodeBlock): string => {
   return code;
 };
 
-export const printCrossChainArrays = (blocks: CodeBlock[]): string => {
+export const printCrossChainArrays = (blocks: CodeBlock[], storage = ""): string => {
   const arrays = new Set<string>();
   for (const block of blocks) {
     block.outboundDependencies.forEach((dependency) => arrays.add(dependency));
@@ -172,10 +223,65 @@ export const printCrossChainArrays = (blocks: CodeBlock[]): string => {
 
   return Array.from(arrays)
     .filter((variable) => !variable.includes("+"))
-    .map((x) => `float block_${x} [128] __attribute__((aligned(16)));; `)
+    .map((x) => `${storage}float block_${x} [BLOCK_SIZE] __attribute__((aligned(SIMD_ALIGN)));; `)
     .join("\n");
 };
 
+/**
+ * Groups consecutive calls to the same function (with distinct invocations) whose
+ * invocations don't share any state, so they can be printed as one parallel batch.
+ */
+const batchCalls = (blocks: CodeBlock[], functions: FunctionSummaries): CodeBlock[][] => {
+  const batches: CodeBlock[][] = [];
+  for (const block of blocks) {
+    const call = parseCall(block);
+    const batch = batches[batches.length - 1];
+    const previous = batch && parseCall(batch[0]);
+    if (
+      call &&
+      previous &&
+      call.name === previous.name &&
+      functions.get(call.name)?.parallel &&
+      batch.every((x) => parseCall(x)!.invocation !== call.invocation)
+    ) {
+      batch.push(block);
+    } else {
+      batches.push([block]);
+    }
+  }
+  return batches;
+};
+
+// ZEN_PARALLEL_FOR is empty on wasm, and in native builds an OpenMP parallel for over batches
+// big enough to be worth it (see native/prelude.ts). profiled batches run in order, so every
+// call is timed on its own
+const printBatch = (batch: CodeBlock[], sections?: ProfileSection[]): string => `
+${sections ? "" : `ZEN_PARALLEL_FOR(${batch.length})`}
+for (int task = 0; task < ${batch.length}; task++) {
+    zen_denormals_task();
+    switch (task) {
+${batch.map((block, i) => `        case ${i}: ${profile(block, block.code.trim(), sections)} break;`).join("\n")}
+    }
+}
+`;
+
+const UGEN_ID = /\/\* id: (\d+) \*\//g;
+
+// times a printed block as a new section, when profiling
+const profile = (block: CodeBlock, printed: string, sections?: ProfileSection[]): string => {
+  if (!sections) {
+    return printed;
+  }
+  const call = parseCall(block);
+  sections.push({
+    label: call
+      ? `${call.name}[${call.invocation}]`
+      : `${block.context.isSIMD ? "simd" : "scalar"} block ${sections.length}`,
+    ugens: Array.from(block.code.matchAll(UGEN_ID), (x) => parseInt(x[1])),
+  });
+  return printProfiled(sections.length - 1, printed);
+};
+
 const mergeAdjacentBlocks = (blocks: CodeBlock[]): CodeBlock[] => {
   const _blocks: CodeBlock[] = [];
   let currentBlock: CodeBlock | null = null;
@@ -249,36 +355,105 @@ const mergeAdjacentBlocks = (blocks: CodeBlock[]): CodeBlock[] => {
   return _blocks;
 };
 
-export const printBlocks = (blocks: CodeBlock[], target: Target): string => {
+/**
+ * Prints process(). Given sections (a profiling build) each block, and each function call,
+ * is timed and described in sections (see memory/profile.ts).
+ */
+export const printBlocks = (
+  blocks: CodeBlock[],
+  target: Target,
+  functions?: FunctionSummaries,
+  sections?: ProfileSection[],
+): string => {
   const returnType = target === Target.C ? "void" : "";
   const args =
     target === Target.C ? "float * inputs, float * outputs, float currentTime" : "inputs, outputs";
   const prefix = `${target === Target.C ? "EMSCRIPTEN_KEEPALIVE" : ""}
 ${returnType} process(${args})`;
-  return printFunction(prefix, "outputs", blocks, undefined, undefined, target);
+  return printFunction(
+    prefix,
+    "outputs",
+    blocks,
+    undefined,
+    undefined,
+    target,
+    functions,
+    undefined,
+    undefined,
+    target === Target.Javascript ? undefined : sections,
+  );
 };
 
-export const printUserFunction = (func: Function, target: Target): string => {
+export const printUserFunction = (
+  func: Function,
+  target: Target,
+  functions?: FunctionSummaries,
+): string => {
   const name = func.name;
   const args = [...func.functionArguments].sort((a, b) => a.num - b.num);
   const argPrefix = func.context?.forceScalar ? "" : "*";
   const varKeyword = target === Target.C ? "float" : "";
   const printedArgs = args.map((x) => `${varKeyword} ${argPrefix}${x.name} `).join(",");
   const outputs = countOutputs(func.codeFragments);
-  const totalSize = outputs * 128 * func.size;
+  const blockSize = func.context!.blockSize;
+  const totalSize = outputs * blockSize * func.size;
 
   const outputArray =
     target === Target.C
-      ? `float ${name}_out[${totalSize}]__attribute__((aligned(16))); `
+      ? `float ${name}_out[${totalSize}]__attribute__((aligned(SIMD_ALIGN))); `
       : `${name}_out = new Array(${func.size}).fill(0).map(() => new Float32Array(${outputs}));`;
 
   const intKeyword = target === Target.C ? "int" : "";
   const returnType = target === Target.C ? "void" : "";
-  return `${outputArray}
-${printFunction(`${returnType} ${name}(${intKeyword} invocation, ${printedArgs})`, `${func.name}_out`, determineBlocks(...func.codeFragments), 1, func.context!.forceScalar, target)}
+  const gate =
+    target === Target.C && !func.context!.forceScalar
+      ? printGate(func, outputs, args, blockSize)
+      : undefined;
+  return `${outputArray}${gate ? gate.declaration : ""}
+${printFunction(`${returnType} ${name}(${intKeyword} invocation, ${printedArgs})`, `${func.name}_out`, determineBlocks(...func.codeFragments), 1, func.context!.forceScalar, target, functions, gate?.prologue, gate?.epilogue)}
                 `;
 };
 
+/**
+ * The activity gate of a gatedDefun function, for block-rate invocations (a per-sample
+ * function has no block to skip). name_idle has a bit per invocation, set when a block
+ * ends with its activity output all 0 and its wake arguments too (a trigger on the last
+ * sample hasn't raised the activity yet); an idle invocation returns straight away, with
+ * its slice of name_out zeroed, unless a wake argument is nonzero somewhere in the block.
+ * Invocations of a batch may run on different threads, hence the atomics.
+ */
+const printGate = (func: Function, outputs: number, args: Argument[], blockSize: number) => {
+  const name = func.name;
+  const wake = func.gate?.wake.map((num) => args.find((x) => x.num === num)?.name);
+  // an argument the body never reads can't be checked, so that invocation is never skipped
+  if (!func.gate || !wake || wake.length === 0 || wake.some((x) => x === undefined)) {
+    return undefined;
+  }
+  const slice = `${name}_out + ${blockSize * outputs}*invocation`;
+  const word = `${name}_idle[invocation >> 5]`;
+  const asleep = wake.map((x) => `!zen_any_nonzero(${x})`).join(" && ");
+  return {
+    declaration: `
+unsigned int ${name}_idle[${Math.ceil(func.size / 32)}];`,
+    prologue: `
+    unsigned int idle_bit = 1u << (invocation & 31);
+    if (__atomic_load_n(&${word}, __ATOMIC_RELAXED) & idle_bit) {
+        if (${asleep}) {
+            float *out = ${slice};
+            for (int j = 0; j < ${blockSize * outputs}; j++) out[j] = 0;
+            return;
+        }
+        __atomic_fetch_and(&${word}, ~idle_bit, __ATOMIC_RELAXED);
+    }
+`,
+    epilogue: `
+    if (!zen_any_nonzero(${slice} + ${blockSize * func.gate.output}) && ${asleep}) {
+        __atomic_fetch_or(&${word}, idle_bit, __ATOMIC_RELAXED);
+    }
+`,
+  };
+};
+
 export const printFunction = (
   functionSignature: string,
   outputName: string,
@@ -286,17 +461,42 @@ export const printFunction = (
   totalInvocations?: number,
   forceScalar?: boolean,
   target?: Target,
+  functions: FunctionSummaries = new Map(),
+  prologue = "",
+  epilogue = "",
+  sections?: ProfileSection[],
 ): string => {
-  const blocks = mergeAdjacentBlocks(_blocks);
+  const merged =
+    target === Target.C && !forceScalar
+      ? pruneOutboundDependencies(mergeAdjacentBlocks(scheduleBlocks(_blocks, functions)))
+      : mergeAdjacentBlocks(_blocks);
+  const blocks =
+    target !== Target.C
+      ? merged
+      : eliminateDeadCode(optimizeBlocks(forceScalar ? merged : forwardOutputs(merged)));
+  // every block writes its outputs with the same stride, however many of them it holds
+  const numberOfOutputs = Math.max(0, ...blocks.flatMap((block) => block.outputs)) + 1;
 
-  let code = target === Target.C ? printCrossChainArrays(blocks) : "";
+  // invocations of a user function may run concurrently, each needs its own scratch arrays
+  const storage = totalInvocations ? "ZEN_THREAD_LOCAL " : "";
+  let code = target === Target.C ? printCrossChainArrays(blocks, storage) : "";
 
   code += `
 ${functionSignature} {
-                    `;
+                    ${prologue}`;
 
   let post = "";
 
+  if (target === Target.C && functionSignature.includes("process(")) {
+    // flush-to-zero for the length of the call (see denormals.ts)
+    code += `
+    (void)inputs; // a patch without in() or messages uses neither
+    (void)currentTime;
+    zen_fp_mode zen_fp = zen_denormals_off();
+    zen_render_automation();
+`;
+  }
+
   if (target === Target.Javascript) {
     code += `let memory = this.memory;`;
     if (functionSignature.includes("process(")) {
@@ -311,62 +511,87 @@ ${functionSignature} {
   }
 
   let i = 0;
-  for (const block of blocks) {
-    const isLast = i === blocks.length - 1;
+  for (const batch of target === Target.C ? batchCalls(blocks, functions) : blocks.map((x) => [x])) {
+    i += batch.length;
+    const isLast = i === blocks.length;
+    const printed =
+      batch.length > 1
+        ? printBatch(batch, sections)
+        : profile(
+            batch[0],
+            printBlock(
+              outputName,
+              batch[0],
+              totalInvocations,
+              isLast,
+              forceScalar,
+              target,
+              numberOfOutputs,
+            ),
+            sections,
+          );
     post += `
-${printBlock(outputName, block, totalInvocations, isLast, forceScalar, target)
+${printed
   .split("\n")
   .map((x) => (x === "" ? x : `    ${x}`))
   .join("\n")}`;
-    i++;
   }
 
-  const constants = post
-    .split("\n")
-    .filter((x) => x.includes("v128_t constant"))
-    .join("\n");
+  // splats of constants and uniforms are the same for every sample, so they're hoisted
+  // above all the loops
+  const isHoisted = (x: string) => x.includes("v128_t constant") || x.includes("v128_t uniform");
+  const constants = post.split("\n").filter(isHoisted).join("\n");
   post = post
     .split("\n")
-    .filter((x) => !x.includes("v128_t constant"))
+    .filter((x) => !isHoisted(x))
     .join("\n");
+  const hoisted = dedupeConstants(constants);
+  post = post.replace(/\b(constant|uniform)\w*/g, (x) => hoisted.aliases.get(x) || x);
 
   if (functionSignature.includes("process(")) {
     if (target === Target.C) {
-      post += "\nelapsed += 128;\n";
+      post += "\nelapsed += BLOCK_SIZE;\npublish_messages();\nzen_denormals_restore(zen_fp);\n";
     } else {
       post += "\nthis.elapsed += 128;\n";
       post += "\nthis.messageCounter ++;\n";
     }
   }
   if (target === Target.C) {
+    post += epilogue;
   } else {
     post += "return true;\n";
   }
   post += "\n}\n";
-  return replaceAll(code + dedupeConstants(constants) + post, "double", "float");
+  return replaceAll(code + hoisted.code + post, "double", "float");
 };
 
-const dedupeConstants = (constants: string): string => {
-  const c = constants.split("\n");
+/**
+ * Keeps one splat per distinct value: later splats of the same value become aliases of the
+ * first, which the caller renames in the body rather than copying.
+ */
+const dedupeConstants = (constants: string): { code: string; aliases: Map<string, string> } => {
   const c1: string[] = [];
-
-  const alreadyUsed: any = {};
-  for (let a of c) {
-    a = a.trim();
-    let tokens = a.split("(");
-    let variableName = a.split(" ")[1];
-    if (!variableName) {
+  const aliases = new Map<string, string>();
+  const alreadyUsed = new Map<string, string>();
+  for (let a of constants.split("\n")) {
+    // splats hoisted from different blocks can be built from each other's aliases
+    a = a.trim().replace(/\b(constant|uniform)\w*/g, (x) => aliases.get(x) || x);
+    const equals = a.indexOf("=");
+    const variableName = a.split(" ")[1]?.replace("=", "");
+    if (!variableName || equals === -1) {
       c1.push(a);
       continue;
     }
-    if (alreadyUsed[tokens[1]]) {
-      c1.push("v128_t " + variableName + " " + alreadyUsed[tokens[1]] + ";");
+    const value = a.slice(equals + 1).trim();
+    const original = alreadyUsed.get(value);
+    if (original) {
+      aliases.set(variableName, original);
     } else {
       c1.push(a);
-      alreadyUsed[tokens[1]] = variableName.replace("=", "");
+      alreadyUsed.set(value, variableName);
     }
   }
-  return "\n" + prettify("    ", c1.join("\n"));
+  return { code: "\n" + prettify("    ", c1.join("\n")), aliases };
 };
 
 const prettify = (prefix: string, code: string): string => {
@@ -4,9 +4,9 @@ export const printConstantInitializer = (context: Context): string => {
     let arrays = "";
     let body = "";
     for (let variable in context.constantArrays) {
-        arrays += `float ${variable}[128] __attribute__((aligned(16)));
+        arrays += `float ${variable}[BLOCK_SIZE] __attribute__((aligned(SIMD_ALIGN)));
 `;
-        body += `    for (int i=0; i < 128; i++) {
+        body += `    for (int i=0; i < BLOCK_SIZE; i++) {
         ${variable}[i] = ${context.constantArrays[variable]};
     }
 `
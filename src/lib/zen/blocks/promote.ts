@@ -0,0 +1,177 @@
+/**
+ * Keeps the state a scalar sample loop carries from one sample to the next (histories,
+ * accumulators: every memory[] cell the loop addresses by a constant index) in locals for
+ * the length of the loop. Through memory[] each sample's read waits on the previous
+ * sample's store, since the compiler can't tell what else in the loop might write there;
+ * in a local the chain stays in registers.
+ *
+ *   float zen_state0 = memory[9 + 1*invocation];
+ *   for (int j=0; j < BLOCK_SIZE; j+= 1) { ...zen_state0... }
+ *   memory[9 + 1*invocation] = zen_state0;
+ *
+ * An f64 cell (see precision.ts), read and written through zen_load_f64/zen_store_f64,
+ * becomes a zen_f64 local the same way.
+ *
+ * What else in a loop addresses memory[] by a computed index stays within a buffer: peek
+ * and delay wrap their index into theirs, and a constant base + a loop variable covers
+ * the block at that base. A cell inside such a range is left in memory, and an index
+ * without a constant base (unsafeMemoryFetch) could be anywhere. poke() writes wherever
+ * its index points, and a user function called from the loop (latchcall) reads and writes
+ * memory[] itself, so a loop that does either isn't promoted at all.
+ */
+
+import type { Context } from "../context";
+import { POKE } from "../data";
+import { LATCH_CALL } from "../functions";
+import { F64_CELLS, F64_TYPE } from "../precision";
+
+// memory[N] or memory[N + K*invocation] (per-invocation state of a user function)
+const SLOT = /\bmemory\[\s*(\d+)(\s*\+\s*\d+\s*\*\s*invocation)?\s*\]/g;
+// the same, as the cell of an f64 load or store: zen_store_f64(memory + N, value);
+const F64_SLOT =
+  /\bzen_(load|store)_f64\(\s*(memory\s*\+\s*(\d+)(?:\s*\+\s*\d+\s*\*\s*invocation)?)\s*(?:\)|,\s*([^;]*)\);)/g;
+const ACCESS = /\bmemory\b(\s*\[)?/g;
+const LANE = /\bZEN_LANE\(\d+, (\d+)\)/g;
+const WRITE = /^\s*(?:[-+*/%&|^]?=(?!=)|\+\+|--)/;
+
+// one spelling per cell, the one the code generators print: memory[9 + 1*invocation]
+const cellOf = (access: string) => access.replace(/\s+/g, "").replace(/\+/g, " + ");
+
+export interface PromotedState {
+  // declarations to print before the loop
+  load: string;
+  body: string;
+  // stores to print after it
+  store: string;
+}
+
+// how many variables an index is followed through to its base
+const MAX_INDIRECTION = 8;
+
+/**
+ * The constant an index expression (at `at` in the body) starts from. peek and delay keep
+ * their index in variables (int peekIdx_2 = 12 + ...; int floored = floor(delayIndex);),
+ * so those are followed back to their declarations.
+ */
+const constantBase = (body: string, at: number, depth = 0): number | undefined => {
+  const expression = body.slice(at);
+  const base = expression.match(/^\s*\(?\s*(?:\+\s*)?(\d+)\b/);
+  if (base) {
+    return parseInt(base[1]);
+  }
+  const variable = expression.match(/^\s*(?:floor\s*\(\s*)?\(?\s*([A-Za-z_]\w*)\b(?!\s*\()/);
+  const declared =
+    variable && body.match(new RegExp(`\\b${variable[1]}\\s*=(?!=)\\s*`));
+  if (!declared || depth === MAX_INDIRECTION) {
+    return undefined;
+  }
+  return constantBase(body, declared.index! + declared[0].length, depth + 1);
+};
+
+/**
+ * The ranges of memory[] the loop reaches through computed indices: [start, end).
+ */
+const computedRanges = (body: string, context: Context): [number, number][] => {
+  const ranges: [number, number][] = [];
+  const f64Cells = new Set(
+    Array.from(body.matchAll(F64_SLOT), (x) => x.index! + x[0].indexOf(x[2])),
+  );
+  for (const access of body.matchAll(ACCESS)) {
+    const at = access.index! + access[0].length;
+    const constant = new RegExp(SLOT.source, "y");
+    constant.lastIndex = access.index!;
+    if ((access[1] && constant.test(body)) || f64Cells.has(access.index!)) {
+      continue;
+    }
+    // a pointer or an index with a constant base: the block allocated there
+    const start = constantBase(body, at);
+    if (start === undefined) {
+      ranges.push([0, Infinity]);
+      continue;
+    }
+    const block = context.memory.blocksInUse.find(
+      (x) => (x._idx === undefined ? x.idx : x._idx) === start,
+    );
+    ranges.push([start, block ? start + block.allocatedSize : Infinity]);
+  }
+  // (a forceScalar read of an automated param: memory[idx] behind a macro)
+  for (const lane of body.matchAll(LANE)) {
+    ranges.push([parseInt(lane[1]), parseInt(lane[1]) + 1]);
+  }
+  return ranges;
+};
+
+/**
+ * Rewrites the body of a scalar sample loop (C target) to keep its constant-index
+ * memory[] cells in locals, or returns undefined when there's nothing to promote.
+ */
+export const promoteState = (body: string, context: Context): PromotedState | undefined => {
+  if (body.includes(POKE) || body.includes(LATCH_CALL)) {
+    return undefined;
+  }
+  const ranges = computedRanges(body, context);
+  const inRange = (position: number, cells: number) =>
+    ranges.some(([start, end]) => position < end && position + cells > start);
+  const slots = new Map<string, { local: string; written: boolean }>();
+  const wideSlots = new Map<string, { local: string; written: boolean }>();
+  for (const match of body.matchAll(F64_SLOT)) {
+    if (inRange(parseInt(match[3]), F64_CELLS)) {
+      continue;
+    }
+    const key = cellOf(match[2]);
+    let slot = wideSlots.get(key);
+    if (!slot) {
+      slot = { local: `zen_state${slots.size + wideSlots.size}`, written: false };
+      wideSlots.set(key, slot);
+    }
+    slot.written ||= match[1] === "store";
+  }
+  for (const match of body.matchAll(SLOT)) {
+    if (inRange(parseInt(match[1]), 1)) {
+      continue;
+    }
+    const key = cellOf(match[0]);
+    let slot = slots.get(key);
+    if (!slot) {
+      slot = { local: `zen_state${slots.size + wideSlots.size}`, written: false };
+      slots.set(key, slot);
+    }
+    const before = body.slice(0, match.index).trimEnd();
+    if (
+      WRITE.test(body.slice(match.index! + match[0].length)) ||
+      before.endsWith("++") ||
+      before.endsWith("--")
+    ) {
+      slot.written = true;
+    }
+  }
+  if (slots.size + wideSlots.size === 0) {
+    return undefined;
+  }
+  const load: string[] = [];
+  const store: string[] = [];
+  for (const [cell, { local, written }] of Array.from(slots)) {
+    load.push(`float ${local} = ${cell};`);
+    if (written) {
+      store.push(`${cell} = ${local};`);
+    }
+  }
+  for (const [cell, { local, written }] of Array.from(wideSlots)) {
+    load.push(`${F64_TYPE} ${local} = zen_load_f64(${cell});`);
+    if (written) {
+      store.push(`zen_store_f64(${cell}, ${local});`);
+    }
+  }
+  const promoted = body.replace(F64_SLOT, (match, op, cell, _, value) => {
+    const slot = wideSlots.get(cellOf(cell));
+    if (!slot) {
+      return match;
+    }
+    return op === "load" ? slot.local : `${slot.local} = ${value};`;
+  });
+  return {
+    load: load.join("\n"),
+    body: promoted.replace(SLOT, (match) => slots.get(cellOf(match))?.local || match),
+    store: store.join("\n"),
+  };
+};
@@ -33,13 +33,14 @@ export const click = (): Clicker => {
   let _context: Context;
   let clickVar: string;
   let contextBlocks: ContextualBlock[] = [];
+  const id = uuid();
 
   const clicker: Clicker = simdMemo((context: Context): Generated => {
     const contextChanged = context !== _context;
     _context = context;
 
     if (block === undefined || contextChanged) {
-      block = context.alloc(1);
+      block = context.alloc(1, id);
       clickVar = context.useVariables("clickVal")[0];
 
       // Clean up disposed contexts and add current one
@@ -50,9 +51,7 @@ export const click = (): Clicker => {
     // Generate pulse: set memory back to 0 immediately after reading a positive value
     const code = `
 ${context.varKeyword} ${clickVar} = memory[${block.idx}];
-if (${clickVar} > 0) {
-  memory[${block.idx}] = 0;
-}`;
+memory[${block.idx}] = ${clickVar} > 0 ? 0 : ${clickVar};`;
 
     return context.emit(code, clickVar);
   });
@@ -0,0 +1,255 @@
+/**
+ * Content-addressed cache of compiled modules, so reloading a patch (or switching back to
+ * a preset) whose generated C hasn't changed skips the compile server entirely.
+ *
+ * The key is a hash of the compiler's version and the normalized source: whitespace is
+ * collapsed and the numbered variables (addVal77, block_phasor3...) are renumbered in order
+ * of appearance, since the numbers come from global counters and differ every time a graph
+ * is rebuilt, while the code they name is the same.
+ *
+ * Modules are kept in memory, and in a ModuleStore that outlives the page: IndexedDB in
+ * the browser, a directory on the native/Node side (native/moduleStore.ts). Both are
+ * evicted by total size (least recently used first) and by age.
+ */
+
+export interface CachePolicy {
+  // total bytes of modules kept
+  maxBytes: number;
+  // modules unused for longer than this (ms) are dropped
+  maxAge: number;
+}
+
+export interface StoredModule {
+  key: string;
+  size: number;
+  lastUsed: number;
+}
+
+/**
+ * Where modules persist between sessions. Failures are never fatal: a store that throws
+ * just means the module gets compiled again.
+ */
+export interface ModuleStore {
+  get(key: string): Promise<ArrayBuffer | undefined>;
+  put(key: string, bytes: ArrayBuffer): Promise<void>;
+  // records a hit, for least-recently-used eviction
+  touch(key: string): Promise<void>;
+  delete(key: string): Promise<void>;
+  entries(): Promise<StoredModule[]>;
+}
+
+/**
+ * Turns generated C into a module. version names the toolchain and its flags, so modules
+ * an older compiler built stop matching once it changes.
+ */
+export interface Compiler {
+  version: string;
+  compile: (source: string) => Promise<ArrayBuffer>;
+}
+
+const DAY = 24 * 60 * 60 * 1000;
+
+export const DEFAULT_MEMORY_POLICY: CachePolicy = { maxBytes: 64 * 1024 * 1024, maxAge: DAY };
+export const DEFAULT_STORE_POLICY: CachePolicy = {
+  maxBytes: 256 * 1024 * 1024,
+  maxAge: 30 * DAY,
+};
+
+// identifiers ending in a number that aren't generated variables
+const RESERVED = new Set(["log2", "log10", "exp2", "atan2", "__m128", "__m256", "__m512"]);
+
+export const normalizeSource = (source: string): string => {
+  const names = new Map<string, string>();
+  return source
+    .split("\n")
+    .map((line) => line.trim().replace(/\s+/g, " "))
+    .filter((line) => line !== "")
+    .join("\n")
+    .replace(/\b[A-Za-z_]\w*?\d+\b/g, (name) => {
+      if (RESERVED.has(name)) {
+        return name;
+      }
+      if (!names.has(name)) {
+        names.set(name, `$${names.size}`);
+      }
+      return names.get(name)!;
+    });
+};
+
+export const hashSource = async (source: string): Promise<string> => {
+  const digest = await crypto.subtle.digest("SHA-256", new TextEncoder().encode(source));
+  return Array.from(new Uint8Array(digest))
+    .map((x) => x.toString(16).padStart(2, "0"))
+    .join("");
+};
+
+export const cacheKey = (source: string, compiler: Compiler): Promise<string> =>
+  hashSource(`${compiler.version}\n${normalizeSource(source)}`);
+
+/**
+ * The entries of a store to delete so the rest fits a policy: everything too old, then
+ * the least recently used until it's under maxBytes.
+ */
+export const entriesToEvict = (
+  entries: StoredModule[],
+  policy: CachePolicy,
+  now = Date.now(),
+): StoredModule[] => {
+  const evicted = entries.filter((x) => now - x.lastUsed > policy.maxAge);
+  const kept = entries
+    .filter((x) => !evicted.includes(x))
+    .sort((a, b) => b.lastUsed - a.lastUsed);
+  let total = 0;
+  for (const entry of kept) {
+    total += entry.size;
+    if (total > policy.maxBytes) {
+      evicted.push(entry);
+    }
+  }
+  return evicted;
+};
+
+interface MemoryEntry extends StoredModule {
+  bytes: ArrayBuffer;
+}
+
+export class ModuleCache {
+  private memory = new Map<string, MemoryEntry>();
+  // compiles in flight, so loading the same patch twice at once compiles it once
+  private pending = new Map<string, Promise<ArrayBuffer>>();
+
+  constructor(
+    private store?: ModuleStore,
+    private memoryPolicy: CachePolicy = DEFAULT_MEMORY_POLICY,
+    private storePolicy: CachePolicy = DEFAULT_STORE_POLICY,
+  ) {}
+
+  /**
+   * The compiled module for source, compiling it only if neither memory nor the store has
+   * one for the same normalized source and compiler version.
+   */
+  async get(source: string, compiler: Compiler) {
+    const key = await cacheKey(source, compiler);
+    const cached = this.memory.get(key);
+    if (cached) {
+      cached.lastUsed = Date.now();
+      return cached.bytes;
+    }
+    if (!this.pending.has(key)) {
+      this.pending.set(
+        key,
+        this.load(key, source, compiler).finally(() => this.pending.delete(key)),
+      );
+    }
+    return this.pending.get(key)!;
+  }
+
+  private async load(
+    key: string,
+    source: string,
+    compiler: Compiler,
+  ): Promise<ArrayBuffer> {
+    let bytes = await this.store?.get(key).catch(() => undefined);
+    if (bytes) {
+      this.store!.touch(key).catch(() => {});
+    } else {
+      bytes = await compiler.compile(source);
+      this.persist(key, bytes);
+    }
+    this.remember(key, bytes);
+    return bytes;
+  }
+
+  private remember(key: string, bytes: ArrayBuffer) {
+    this.memory.set(key, { key, bytes, size: bytes.byteLength, lastUsed: Date.now() });
+    for (const entry of entriesToEvict(Array.from(this.memory.values()), this.memoryPolicy)) {
+      this.memory.delete(entry.key);
+    }
+  }
+
+  private async persist(key: string, bytes: ArrayBuffer) {
+    if (!this.store) {
+      return;
+    }
+    try {
+      await this.store.put(key, bytes);
+      for (const entry of entriesToEvict(await this.store.entries(), this.storePolicy)) {
+        await this.store.delete(entry.key);
+      }
+    } catch (e) {
+      console.log("could not cache compiled module", e);
+    }
+  }
+
+  clear() {
+    this.memory.clear();
+  }
+}
+
+const DATABASE = "zen-modules";
+const MODULES = "modules";
+// sizes and last use, kept apart so eviction doesn't read every module
+const METADATA = "metadata";
+
+const request = <T>(r: IDBRequest<T>): Promise<T> =>
+  new Promise((resolve, reject) => {
+    r.onsuccess = () => resolve(r.result);
+    r.onerror = () => reject(r.error);
+  });
+
+export class IndexedDBStore implements ModuleStore {
+  private db?: Promise<IDBDatabase>;
+
+  private open(): Promise<IDBDatabase> {
+    if (!this.db) {
+      const r = indexedDB.open(DATABASE, 1);
+      r.onupgradeneeded = () => {
+        r.result.createObjectStore(MODULES);
+        r.result.createObjectStore(METADATA, { keyPath: "key" });
+      };
+      this.db = request(r);
+    }
+    return this.db;
+  }
+
+  private async transaction(mode: IDBTransactionMode) {
+    const db = await this.open();
+    const t = db.transaction([MODULES, METADATA], mode);
+    return { modules: t.objectStore(MODULES), metadata: t.objectStore(METADATA) };
+  }
+
+  async get(key: string) {
+    const { modules } = await this.transaction("readonly");
+    return (await request(modules.get(key))) as ArrayBuffer | undefined;
+  }
+
+  async put(key: string, bytes: ArrayBuffer) {
+    const { modules, metadata } = await this.transaction("readwrite");
+    await Promise.all([
+      request(modules.put(bytes, key)),
+      request(metadata.put({ key, size: bytes.byteLength, lastUsed: Date.now() })),
+    ]);
+  }
+
+  async touch(key: string) {
+    const { metadata } = await this.transaction("readwrite");
+    const entry = (await request(metadata.get(key))) as StoredModule | undefined;
+    if (entry) {
+      await request(metadata.put({ ...entry, lastUsed: Date.now() }));
+    }
+  }
+
+  async delete(key: string) {
+    const { modules, metadata } = await this.transaction("readwrite");
+    await Promise.all([request(modules.delete(key)), request(metadata.delete(key))]);
+  }
+
+  async entries() {
+    const { metadata } = await this.transaction("readonly");
+    return (await request(metadata.getAll())) as StoredModule[];
+  }
+}
+
+export const moduleCache = new ModuleCache(
+  typeof indexedDB !== "undefined" ? new IndexedDBStore() : undefined,
+);
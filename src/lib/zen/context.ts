@@ -1,4 +1,4 @@
-import { Memory } from "./memory-helper";
+import { Memory, Arena } from "./memory-helper";
 import { emitBlocks, CodeBlock, SIMDBlock } from "./simd";
 import { CodeFragment, emitCode, emitCodeHelper, printCodeFragments } from "./emitter";
 import { Block, MemoryBlock, LoopMemoryBlock } from "./block";
@@ -8,6 +8,10 @@ import { emitParams, emitHistory, emitOutputHistory, emitOuterHistory } from "./
 import { emitArguments, emitFunctions } from "./functions";
 import type { Range } from "./loop";
 import { Target } from "./targets";
+import type { ProfileSection } from "./memory/profile";
+import { ownerOf } from "./memory/profile";
+import type { MathPrecision } from "./vectorMath";
+import { DEFAULT_BLOCK_SIZE } from "./blockSize";
 
 export interface IContext {
   forceScalar?: boolean;
@@ -63,6 +67,12 @@ type ConstantArrays = {
 };
 
 let contextId = 0;
+// the patch node that created the UGen, failing that the history's name
+const ownerOfState = (ugen?: number, name?: string): string | undefined => {
+  const node = ugen === undefined ? undefined : ownerOf(ugen);
+  return node !== undefined ? `node ${node}` : name !== undefined ? `history ${name}` : undefined;
+};
+
 export class Context {
   memory: Memory;
   idx: number;
@@ -100,6 +110,15 @@ export class Context {
 
   emittedStatements: Generated[];
   constantArrays: ConstantArrays;
+  // memory index of the param behind each automation lane
+  automationLanes: number[];
+  // accuracy tier of the vector exp/log/pow/sin/cos/tanh (see vectorMath.ts)
+  mathPrecision: MathPrecision;
+  // times every block of process() (see memory/profile.ts)
+  profile: boolean;
+  profileSections?: ProfileSection[];
+  // samples per process() call (see blockSize.ts)
+  blockSize: number;
 
   constructor(target = Target.Javascript, baseContext?: Context) {
     this.id = contextId++;
@@ -132,7 +151,11 @@ export class Context {
 
     this.baseContext = baseContext || this;
     this.forceScalar = this.baseContext.forceScalar;
+    this.mathPrecision = baseContext ? baseContext.mathPrecision : "precise";
+    this.profile = baseContext ? baseContext.profile : false;
+    this.blockSize = baseContext ? baseContext.blockSize : DEFAULT_BLOCK_SIZE;
     this.constantArrays = {};
+    this.automationLanes = [];
   }
 
   // used for calling SIMD functions
@@ -142,6 +165,15 @@ export class Context {
     return variableName;
   }
 
+  // sample-accurate automation for the param at memory[idx] (see memory/automation.ts)
+  useAutomationLane(idx: number): number {
+    const lanes = this.baseContext.automationLanes;
+    if (!lanes.includes(idx)) {
+      lanes.push(idx);
+    }
+    return lanes.indexOf(idx);
+  }
+
   get varKeyword() {
     return this.target === Target.C ? "double" : "let";
   }
@@ -180,17 +212,23 @@ export class Context {
     return this;
   }
 
-  alloc(size: number): MemoryBlock {
+  /**
+   * ugen (the zen id of the UGen allocating) and name (a history's debug name) identify the
+   * block across recompiles, so a hot swap can carry its state over (see memory/migrate.ts)
+   */
+  alloc(size: number, ugen?: number, name?: string): MemoryBlock {
     const loopContext: LoopContext | null = this.getLoopContextIfAny();
-    if (loopContext) {
-      return this.loopAlloc(size, loopContext);
-    }
-    return this.memory.alloc(size);
+    const block = loopContext ? this.loopAlloc(size, loopContext) : this.memory.alloc(size);
+    block.owner = ownerOfState(ugen, name);
+    return block;
   }
 
   loopAlloc(size: number, context: LoopContext): LoopMemoryBlock {
-    let allocSize = size * context.loopSize;
-    const block: MemoryBlock = this.memory.alloc(size * context.loopSize);
+    const block: MemoryBlock = this.memory.allocInArena(
+      context.arena,
+      size * context.loopSize,
+      context.loopSize,
+    );
     const index = this.memory.blocksInUse.indexOf(block);
     const _block = new LoopMemoryBlock(context, block.idx as number, block.size, size); //block.allocatedSize);
     this.memory.blocksInUse[index] = _block;
@@ -477,6 +515,7 @@ export class LoopContext extends Context {
   loopSize: number;
   context: Context | LoopContext;
   isLoop: boolean;
+  arena: Arena;
 
   constructor(loopIdx: string, range: Range, context: Context | LoopContext) {
     super();
@@ -486,6 +525,7 @@ export class LoopContext extends Context {
     this.loopIdx = loopIdx;
     this.loopSize = (range.max as number) - (range.min as number);
     this.memory = context.memory;
+    this.arena = new Arena();
     this.idx = context.idx;
     this.histories = context.histories;
     this.numberOfInputs = context.numberOfInputs;
@@ -494,6 +534,7 @@ export class LoopContext extends Context {
     this.worklets = context.worklets;
     this.target = context.target;
     this.forceScalar = context.forceScalar;
+    this.blockSize = context.blockSize;
   }
 
   /*
@@ -509,14 +550,20 @@ export class LoopContext extends Context {
     return ret;
   }
 
-  alloc(size: number): MemoryBlock {
-    let block: MemoryBlock = this.memory.alloc(size * this.loopSize);
+  alloc(size: number, ugen?: number, name?: string): MemoryBlock {
+    let block: MemoryBlock = this.memory.allocInArena(this.arena, size * this.loopSize, this.loopSize);
     let index = this.memory.blocksInUse.indexOf(block);
     let context = this.context;
     let _block = new LoopMemoryBlock(this, block.idx as number, block.size, size);
+    _block.owner = ownerOfState(ugen, name);
     this.memory.blocksInUse[index] = _block;
     return _block;
   }
+
+  // once the body has been generated, the rest of the arena can go to other allocations
+  releaseArena() {
+    this.memory.releaseArena(this.arena);
+  }
 }
 
 export { emitCodeHelper, emitCode };
@@ -8,6 +8,14 @@ import {
   prettyPrint,
 } from "./worklet";
 import { ZenGraph } from "./zen";
+import { EVENT_RING_SIZE, EVENT_STRIDE } from "./memory/automation";
+import {
+  MESSAGE_BYTES,
+  MESSAGE_HEADER_BYTES,
+  MESSAGE_RING_SIZE,
+  MESSAGE_WANTED,
+} from "./memory/messages";
+import { PROFILE_STRIDE } from "./memory/profile";
 
 export const createWorkletCode = (name: string, graph: ZenGraph): CodeOutput => {
   // first lets replace all instances of @message with what we want
@@ -42,7 +50,8 @@ try {
     const wasmModule = await WebAssembly.compile(wasmBuffer);
     const importObject = {
     env: {
-      memory: new WebAssembly.Memory({ initial: 256, maximum: 256 })
+      memory: new WebAssembly.Memory({ initial: 256, maximum: 256 }),
+      zen_clock: () => this.clock()
     },
  GOT: {
     mem: {}
@@ -52,15 +61,24 @@ try {
     const wasmInstance = await WebAssembly.instantiate(wasmModule, importObject);
     this.wasmModule = wasmInstance;
     this.elapsed = 0;
-    const BLOCK_SIZE = 128;
+    const BLOCK_SIZE = ${graph.context.blockSize};
     this.inputPtr = wasmInstance.exports.my_malloc(BLOCK_SIZE * 4 * ${graph.numberOfInputs});
     this.input = new Float32Array(wasmInstance.exports.memory.buffer, this.inputPtr, BLOCK_SIZE * ${graph.numberOfInputs});
     this.outputPtr = wasmInstance.exports.my_malloc(BLOCK_SIZE * 4 * ${graph.numberOfOutputs});
     this.output = new Float32Array(wasmInstance.exports.memory.buffer, this.outputPtr, BLOCK_SIZE * ${graph.numberOfOutputs});
+    const ringPtr = wasmInstance.exports.get_event_ring();
+    this.eventIndices = new Uint32Array(wasmInstance.exports.memory.buffer, ringPtr, 2);
+    this.eventInts = new Int32Array(wasmInstance.exports.memory.buffer, ringPtr + 8, ${EVENT_RING_SIZE * EVENT_STRIDE});
+    this.eventFloats = new Float32Array(wasmInstance.exports.memory.buffer, ringPtr + 8, ${EVENT_RING_SIZE * EVENT_STRIDE});
+    this.openMessageRing(wasmInstance);
+    if (wasmInstance.exports.get_profile) {
+      this.profile = new Uint32Array(wasmInstance.exports.memory.buffer, wasmInstance.exports.get_profile(), wasmInstance.exports.get_profile_sections() * ${PROFILE_STRIDE});
+      this.flushProfile = new Uint32Array(${PROFILE_STRIDE});
+    }
     this.port.postMessage({type: "wasm-ready"});
     this.wasmModule.exports.initSineTable();
 } catch ( E) {
-this.port.postMessage({type: "error-compiling", data: "yo"});
+this.port.postMessage({type: "error-compiling", body: String(E)});
 }
   }
 
@@ -78,6 +96,15 @@ this.port.postMessage({type: "error-compiling", data: "yo"});
     this.messageQueue = {}; // Map of type/subType -> array of messages
     this.lastMessageTime = new Map(); // Map of type/subType -> last message time
     this.messageInterval = 100; // Minimum interval between messages for a given type/subType (in milliseconds)
+    // nanoseconds (wrapping), for profiling builds. Date.now() is only a fallback for
+    // browsers without performance in the worklet scope: too coarse for anything but totals
+    this.clock = typeof performance !== "undefined"
+      ? () => (performance.now() * 1e6) >>> 0
+      : () => ((Date.now() % 4294) * 1e6) >>> 0;
+    this.gain = 1;
+    this.fadeTarget = 1;
+    this.fadeStep = 0;
+    this.fadeRemaining = 0;
 
     ${prettyPrint("    ", genMemory(graph))}
 
@@ -90,7 +117,11 @@ this.port.postMessage({type: "error-compiling", data: "yo"});
        if (e.data.type === "memory-set") {
          let {idx, value} = e.data.body;
          if (this.wasmModule) {
-           this.wasmModule.exports.setMemorySlot(idx, value);
+           // a write that finds the ring full waits in events for the next block, and later
+           // ones queue behind it, so writes to a cell land in the order they were sent
+           if (this.events.some((x) => x.time <= 0) || !this.pushEvent(idx, value, 0, 0)) {
+             this.events.push({idx, value, time: 0});
+           }
          } else {
             this.memory[idx] = value;
          }
@@ -139,6 +170,33 @@ this.port.postMessage({type: "error-compiling", data: "yo"});
                body: this.memory.slice(idx, idx+allocatedSize)
              });
            }
+       } else if (e.data.type === "state-get") {
+           // the state of a kernel being replaced, read between two blocks (see hotSwap.ts)
+           const view = this.stateView();
+           const ranges = e.data.body;
+           const state = new Float32Array(ranges.reduce((size, x) => size + x.size, 0));
+           let offset = 0;
+           for (const {from, size} of ranges) {
+             state.set(view.subarray(from, from + size), offset);
+             offset += size;
+           }
+           this.port.postMessage({type: "state-get", body: state}, [state.buffer]);
+       } else if (e.data.type === "state-set") {
+           const view = this.stateView();
+           const {ranges, state} = e.data.body;
+           let offset = 0;
+           for (const {to, size} of ranges) {
+             view.set(state.subarray(offset, offset + size), to);
+             offset += size;
+           }
+       } else if (e.data.type === "fade") {
+           let {from, to, samples} = e.data.body;
+           if (from !== undefined) {
+             this.gain = from;
+           }
+           this.fadeTarget = to;
+           this.fadeRemaining = Math.max(1, samples);
+           this.fadeStep = (to - this.gain) / this.fadeRemaining;
        } else if (e.data.type === "dispose") {
            this.disposed = true;
            this.memory = null;
@@ -148,6 +206,31 @@ this.port.postMessage({type: "error-compiling", data: "yo"});
     }
   }
 
+  stateView() {
+    if (this.wasmModule) {
+      const memPointer = this.wasmModule.exports.get_memory();
+      return new Float32Array(this.wasmModule.exports.memory.buffer, memPointer, this.memory.length);
+    }
+    return this.memory;
+  }
+
+  // scales the block by the gain ramp a "fade" message started, sample by sample. a kernel
+  // faded out to 0 stays silent until it's disposed
+  applyFade(outputChannels) {
+    if (this.fadeRemaining === 0 && this.gain === 1) {
+      return;
+    }
+    const length = outputChannels[0] ? outputChannels[0].length : 0;
+    for (let i = 0; i < length; i++) {
+      if (this.fadeRemaining > 0) {
+        this.gain = --this.fadeRemaining === 0 ? this.fadeTarget : this.gain + this.fadeStep;
+      }
+      for (let j = 0; j < outputChannels.length; j++) {
+        outputChannels[j][i] *= this.gain;
+      }
+    }
+  }
+
   cancelSchedule(uuid) {
     this.events = this.events.filter(x => x.uuid !== uuid);
   }
@@ -161,19 +244,43 @@ this.port.postMessage({type: "error-compiling", data: "yo"});
     }
   }
 
+  // writes an event into the kernel's ring (see memory/automation.ts) and publishes it by
+  // advancing the write index. returns false if the ring is full, so the caller can retry
+  pushEvent(idx, value, offset, ramp) {
+      const write = this.eventIndices[0];
+      if (write - this.eventIndices[1] >= ${EVENT_RING_SIZE}) {
+        return false;
+      }
+      const i = (write & ${EVENT_RING_SIZE - 1}) * ${EVENT_STRIDE};
+      this.eventInts[i] = idx;
+      this.eventInts[i + 1] = offset;
+      this.eventFloats[i + 2] = value;
+      this.eventInts[i + 3] = ramp;
+      this.eventIndices[0] = write + 1;
+      return true;
+  }
+
   toDelete = [];
   scheduleEvents(time=1) {
       this.toDelete.length = 0;
+      if (this.wasmModule) {
+        // events due within the next block go to the ring at their sample offset, in time
+        // order, and process() applies them on that sample (ramps included)
+        this.events.sort((a, b) => a.time - b.time);
+      }
       for (let event of this.events) {
           let idx = event.idx;
           let value = event.value;
-          event.time -= time;
-          if (event.time <= 0) {
-             if (this.wasmModule) {
-                this.wasmModule.exports.setMemorySlot(idx, value);
-             } else {
-               this.memory[idx] = value;
+          if (this.wasmModule && event.time < time) {
+             if (this.pushEvent(idx, value, Math.max(0, Math.floor(event.time)), Math.round(event.ramp || 0))) {
+               this.toDelete.push(event);
+               continue;
              }
+          }
+          event.time -= time;
+          if (!this.wasmModule && event.time <= 0) {
+             // the javascript target has no lanes: the value (or ramp target) lands on the block
+             this.memory[idx] = value;
              this.toDelete.push(event);
           }
      }
@@ -185,55 +292,68 @@ this.port.postMessage({type: "error-compiling", data: "yo"});
      }
   }
 
+  // messages come out of the kernel's ring (see memory/messages.ts), already coalesced per
+  // type/subType: the pending records are copied out in one go and handed to the worker as
+  // a single transferable batch
+  openMessageRing(wasmInstance) {
+    this.messageRingPtr = wasmInstance.exports.get_message_ring();
+    this.messageRing = new Uint32Array(wasmInstance.exports.memory.buffer, this.messageRingPtr, ${MESSAGE_HEADER_BYTES / 4});
+    this.messageRecords = new Uint8Array(wasmInstance.exports.memory.buffer, this.messageRingPtr + ${MESSAGE_HEADER_BYTES}, ${MESSAGE_RING_SIZE * MESSAGE_BYTES});
+    this.messagePort.postMessage({type: "message-keys", body: this.messageKeys});
+  }
+
+   // the kernel publishes what it has pending at the end of its next block
+   requestMessages() {
+      if (this.wasmModule) {
+        this.messageRing[${MESSAGE_WANTED}] = 1;
+      }
+   }
+
    flushWASMMessages() {
       if (!this.wasmModule) {
          return;
       }
-      let numMessages = this.wasmModule.exports.get_message_counter();
-      if (numMessages === 0) {
+      const write = this.messageRing[0];
+      const read = this.messageRing[1];
+      const count = (write - read) >>> 0;
+      if (count === 0) {
         return;
       }
-      const messageArrayPtr = this.wasmModule.exports.flush_messages();
-      const messageArray = new Float32Array(this.wasmModule.exports.memory.buffer, messageArrayPtr, 1000 * 24);
-      let messages = {
-       };
-      let times = {
-       };
-      let heap32 = new Int32Array(this.wasmModule.exports.memory.buffer);
-      //let heapF64 = new Float64Array(this.wasmModule.exports.memory.buffer);
-      let heapF32 = new Float32Array(this.wasmModule.exports.memory.buffer);
-let ids = [];
-let keys = [];
-      for (let i=0; i < numMessages*28; i+=28) {
-          let messagePtr = messageArrayPtr + i;
-          let _type = heap32[messagePtr / 4] - 1;
-          let subType = heapF32[(messagePtr + 4) / 4];
-          let body = heapF32[(messagePtr + 8) / 4];
-          let time = heapF32[(messagePtr + 12) / 4];
-
-         let type = this.messageKeys[_type];
-         ids.push(_type);
-         keys.push(type);
-         if (!messages[type]) {
-            messages[type] = {};
-         }
-         messages[type][subType] = body;
-         if (!times[type]) {
-            times[type] = {};
-         }
-         times[type][subType] = time;
-      }
-      for (let type in messages) {
-          for (let subType in messages[type]) {
-             subType = parseFloat(subType);
-let msg = {type, subType, body: messages[type][subType], time: times[type][subType]};
-             this.port.postMessage(msg);
-          }
-      }
-      this.wasmModule.exports.empty_messages();
+      const batch = new Uint8Array(count * ${MESSAGE_BYTES});
+      const start = (read % ${MESSAGE_RING_SIZE}) * ${MESSAGE_BYTES};
+      const first = Math.min(batch.length, this.messageRecords.length - start);
+      batch.set(this.messageRecords.subarray(start, start + first));
+      batch.set(this.messageRecords.subarray(0, batch.length - first), first);
+      this.messageRing[1] = write;
+      this.messagePort.postMessage({type: "message-batch", body: batch.buffer, dropped: this.messageRing[2]}, [batch.buffer]);
    }
 
 
+  // the flush runs outside the kernel, so it's timed here, into a row laid out like the
+  // kernel's (see memory/profile.ts), which is sent after the kernel's rows
+  flushMessagesProfiled() {
+    if (!this.profile) {
+      this.flushWASMMessages();
+      return;
+    }
+    const start = this.clock();
+    this.flushWASMMessages();
+    const t = (this.clock() - start) >>> 0;
+    const row = this.flushProfile;
+    if (row[0]++ === 0 || t < row[1]) row[1] = t;
+    if (t > row[2]) row[2] = t;
+    const low = (row[3] + t) >>> 0;
+    row[4] += low < t ? 1 : 0;
+    row[3] = low;
+    const octave = 31 - Math.clz32(t | 1);
+    row[5 + (octave === 0 ? 0 : 2 * octave + ((t >>> (octave - 1)) & 1))]++;
+
+    const report = new Uint32Array(this.profile.length + row.length);
+    report.set(this.profile);
+    report.set(row, this.profile.length);
+    this.port.postMessage({type: "profile", body: report}, [report.buffer]);
+  }
+
    copyDataToWasmMemory(data, ptr) {
      const bytesPerElement = Float32Array.BYTES_PER_ELEMENT;
      const memory = this.wasmModule.exports.memory;
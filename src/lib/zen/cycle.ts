@@ -2,14 +2,19 @@ import { UGen, Arg, Generated, float } from './zen'
 import { uuid } from './uuid';
 import { phasor } from './phasor';
 import { simdMemo } from './memo-simd';
-import { Context } from './context';
+import { Context, SIMDContext } from './context';
+import { SIMDOutput } from './memo';
+import { isBlockRate } from './simdMath';
+import { printHermite } from './vectorLookup';
 import { add, wrap, mult, sub, floor } from './math';
 import { Target } from './targets';
 import { cKeywords } from './math';
 
 const SINE_TABLE_SIZE = 1024;
 
-export const cycleHelper = (index: Arg, nextIndex: Arg, frac: Arg) => {
+export type CycleInterpolation = "linear" | "hermite";
+
+export const cycleHelper = (index: Arg, nextIndex: Arg, frac: Arg, interpolation: CycleInterpolation = "linear") => {
     let id = uuid();
     return simdMemo((context: Context, _index: Generated, _nextIndex: Generated, _frac: Generated) => {
         let [
@@ -27,9 +32,38 @@ export const cycleHelper = (index: Arg, nextIndex: Arg, frac: Arg) => {
         let out = `
 ${varKeyword} ${lerp} = (1.0-${_frac.variable})*${SINE_TABLE}[${caster} ${_index.variable}] + ${_frac.variable}*${SINE_TABLE}[${caster} ${_nextIndex.variable}];
 `;
+        if (interpolation === "hermite") {
+            // the table size is a power of 2, so the neighbours wrap with a mask
+            let at = (i: string) => `${SINE_TABLE}[(${caster} ${i}) & ${SINE_TABLE_SIZE - 1}]`;
+            out = `
+${varKeyword} ${lerp} = ${printHermite(at(`${_index.variable} - 1`), at(_index.variable!), at(_nextIndex.variable!), at(`${_nextIndex.variable} + 1`), _frac.variable!)};
+`;
+        }
         return context.emit(out, lerp, _index, _nextIndex, _frac);
     },
-        undefined,
+        (context: SIMDContext, _index: Generated, _nextIndex: Generated, _frac: Generated): SIMDOutput => {
+            if ([_index, _nextIndex, _frac].some(isBlockRate)) {
+                return { type: "SIMD_NOT_SUPPORTED" };
+            }
+            let [lerp, tableSize] = context.useCachedVariables(id, "clerp", "constantVector");
+            let code = `v128_t ${lerp} = zen_f32x4_lerp(zen_f32x4_gather(sineTable, ${_index.variable}), zen_f32x4_gather(sineTable, ${_nextIndex.variable}), ${_frac.variable});
+`;
+            if (interpolation === "hermite") {
+                let at = (i: string) => `zen_f32x4_gather(sineTable, zen_f32x4_wrap_index(${i}, ${tableSize}))`;
+                code = `v128_t ${tableSize}= wasm_f32x4_splat(${SINE_TABLE_SIZE});
+v128_t ${lerp} = zen_f32x4_hermite(
+    ${at(`wasm_f32x4_sub(${_index.variable}, wasm_f32x4_splat(1.0f))`)},
+    zen_f32x4_gather(sineTable, ${_index.variable}),
+    zen_f32x4_gather(sineTable, ${_nextIndex.variable}),
+    ${at(`wasm_f32x4_add(${_nextIndex.variable}, wasm_f32x4_splat(1.0f))`)},
+    ${_frac.variable});
+`;
+            }
+            return {
+                type: "SUCCESS",
+                generated: context.emitSIMD(code, lerp, _index, _nextIndex, _frac),
+            };
+        },
         index,
         nextIndex,
         frac);
@@ -37,7 +71,8 @@ ${varKeyword} ${lerp} = (1.0-${_frac.variable})*${SINE_TABLE}[${caster} ${_index
 
 export const cycle = (
     freq: Arg,
-    phase: Arg = 0
+    phase: Arg = 0,
+    interpolation: CycleInterpolation = "linear"
 ): UGen => {
 
     let cyclePhase = wrap(
@@ -50,5 +85,5 @@ export const cycle = (
     let index = floor(floatIndex);
     let frac = sub(floatIndex, index);
     let nextIndex = wrap(add(index, 1), 0, SINE_TABLE_SIZE);
-    return cycleHelper(index, nextIndex, frac);
+    return cycleHelper(index, nextIndex, frac, interpolation);
 };
@@ -7,6 +7,10 @@ import { cKeywords } from "./math";
 import { add, mult, wrap } from "./math";
 import { LoopMemoryBlock, Block, MemoryBlock } from "./block";
 import { uuid } from "./uuid";
+import type { SIMDContext } from "./context";
+import type { SIMDOutput } from "./memo";
+import { isBlockRate, splatBlockRate, withoutBlockRateDependencies } from "./simdMath";
+import { printHermite } from "./vectorLookup";
 
 /*
 export type MultiChannelBlock  = (LoopMemoryBlock | Block) & {
@@ -20,7 +24,7 @@ export type MultiChannelBlock  = (LoopMemoryBlock | Block) & {
 //class MultiChannelBlock extends MemoryBlock {
 //}
 
-export type Interpolation = "linear" | "none";
+export type Interpolation = "linear" | "hermite" | "none";
 
 export interface Gettable<t> {
   get?: () => Promise<t>;
@@ -34,6 +38,8 @@ export interface Gettable<t> {
 export type BlockGen = ((c: Context) => MemoryBlock) &
   Gettable<Float32Array> & {
     interpolation?: Interpolation;
+    // set by poke(): a peek that reads a whole SIMD block ahead would miss these writes
+    poked?: boolean;
   };
 
 export const data = (
@@ -48,6 +54,7 @@ export const data = (
   let contextBlocks: ContextualBlock[] = [];
   let lastData: Float32Array;
   let initted = false;
+  const id = uuid();
   let resp: BlockGen = (context: Context): MemoryBlock => {
     initted = true;
     if (lastData) {
@@ -63,7 +70,7 @@ export const data = (
       context = variableContext;
 
       if (!block) {
-        block = context.alloc(size * channels);
+        block = context.alloc(size * channels, id);
       }
 
       block.initData = initData;
@@ -215,6 +222,36 @@ ${intKeyword} ${peekIdx3} = ${idx} + ${nextIdx};
 ${varKeyword} ${peekVal} = (1 - ${frac})*memory[${peekIdx2}] + (${frac})*memory[${peekIdx3}];
 `;
 
+      if (data.interpolation === "hermite") {
+        // the 4 points around preIdx, wrapped within the channel
+        const [start, i1, hermiteIdx] = variableContext.useCachedVariables(
+          id,
+          "channelStart",
+          "peekIdx_1",
+          "hermiteIdx",
+        );
+        const at = (offset: number) => {
+          const i = `${hermiteIdx}_${offset + 1}`;
+          return `${intKeyword} ${i} = ${i1} + ${offset};
+if (${i} < 0) ${i} += ${maxChannel};
+else if (${i} >= ${maxChannel}) ${i} -= ${maxChannel};
+`;
+        };
+        const y = (offset: number) => `memory[${idx} + ${start} + ${hermiteIdx}_${offset + 1}]`;
+        code = `
+${varKeyword} ${preIdx} = ${_index.variable};
+if (${preIdx} > ${multichannelBlock.length} - 1) ${preIdx} = 0;
+else if (${preIdx} < 0) ${preIdx} += ${multichannelBlock.length};
+${intKeyword} ${channelIdx} = ${_channel.variable};
+if (${channelIdx} > ${multichannelBlock.channels}) ${channelIdx} -= ${multichannelBlock.channels};
+else if (${channelIdx} < 0) ${channelIdx} += ${multichannelBlock.channels};
+${intKeyword} ${start} = ${perChannel} * ${channelIdx};
+${intKeyword} ${i1} = ${floor}(${preIdx});
+${varKeyword} ${frac} = ${preIdx} - ${i1};
+${at(-1)}${at(0)}${at(1)}${at(2)}${varKeyword} ${peekVal} = ${printHermite(y(-1), y(0), y(1), y(2), frac)};
+`;
+      }
+
       if (data.interpolation === "none") {
         code = `
 ${intKeyword} ${preIdx} = ${_index.variable};
@@ -235,14 +272,91 @@ ${varKeyword} ${peekVal} = memory[${peekIdx2}];
       let peeked = __context.emit(code, peekVal, _index, _channel);
       return peeked;
     },
-    undefined,
+    (context: SIMDContext, _index: Generated, _channel: Generated): SIMDOutput => {
+      const multichannelBlock: MemoryBlock = data(context);
+      const idx =
+        multichannelBlock._idx === undefined ? multichannelBlock.idx : multichannelBlock._idx;
+      // a runtime length, a buffer indexed per loop iteration or written by the graph stays
+      // scalar
+      if (length !== undefined || typeof idx !== "number" || data.poked || isBlockRate(_index)) {
+        return { type: "SIMD_NOT_SUPPORTED" };
+      }
+      const [peekVal, preIdx, channelIdx, peekIdx, frac] = context.useCachedVariables(
+        id,
+        "peekVal",
+        "preIdx",
+        "channelIdx",
+        "peekIdx",
+        "frac",
+      );
+      let code = "";
+      let channelVariable = _channel.variable!;
+      if (isBlockRate(_channel)) {
+        const splat = splatBlockRate(context, id, _channel);
+        code += splat.code;
+        channelVariable = splat.variable;
+      }
+      const perChannel = multichannelBlock.length!;
+      const channels = multichannelBlock.channels!;
+      const splat = (x: number) => `wasm_f32x4_splat(${x})`;
+      // the same wraps as the scalar code, as masks: the first select of each pair is the
+      // scalar "if", and can't make the second one true
+      const none = data.interpolation === "none";
+      code += `
+v128_t ${preIdx} = ${none ? `wasm_f32x4_trunc(${_index.variable})` : _index.variable};
+${
+  none
+    ? `${preIdx} = wasm_v128_bitselect(wasm_f32x4_sub(${preIdx}, ${splat(perChannel)}), ${preIdx}, wasm_f32x4_gt(${preIdx}, ${splat(perChannel)}));`
+    : `${preIdx} = wasm_v128_and(${preIdx}, wasm_f32x4_le(${preIdx}, ${splat(perChannel - 1)}));`
+}
+${preIdx} = wasm_v128_bitselect(wasm_f32x4_add(${preIdx}, ${splat(perChannel)}), ${preIdx}, wasm_f32x4_lt(${preIdx}, ${splat(0)}));
+v128_t ${channelIdx} = wasm_f32x4_trunc(${channelVariable});
+${channelIdx} = wasm_v128_bitselect(wasm_f32x4_sub(${channelIdx}, ${splat(channels)}), ${channelIdx}, wasm_f32x4_gt(${channelIdx}, ${splat(channels)}));
+${channelIdx} = wasm_v128_bitselect(wasm_f32x4_add(${channelIdx}, ${splat(channels)}), ${channelIdx}, wasm_f32x4_lt(${channelIdx}, ${splat(0)}));
+v128_t ${peekIdx} = wasm_f32x4_add(wasm_f32x4_mul(${splat(perChannel)}, ${channelIdx}), ${preIdx});
+`;
+      if (none) {
+        code += `v128_t ${peekVal} = zen_f32x4_gather(memory + ${idx}, ${peekIdx});
+`;
+      } else if (data.interpolation === "hermite") {
+        const [start, i1] = context.useCachedVariables(id, "channelStart", "peekIdx_1");
+        const at = (offset: number) =>
+          `zen_f32x4_gather(memory + ${idx}, wasm_f32x4_add(${start}, zen_f32x4_wrap_index(wasm_f32x4_add(${i1}, ${splat(offset)}), ${splat(perChannel)})))`;
+        code += `v128_t ${start} = wasm_f32x4_mul(${splat(perChannel)}, ${channelIdx});
+v128_t ${i1} = wasm_f32x4_floor(${preIdx});
+v128_t ${frac} = wasm_f32x4_sub(${preIdx}, ${i1});
+v128_t ${peekVal} = zen_f32x4_hermite(${at(-1)}, ${at(0)}, ${at(1)}, ${at(2)}, ${frac});
+`;
+      } else {
+        const [floored, nextIdx] = context.useCachedVariables(id, "peekIdx_2", "nextIdx");
+        code += `v128_t ${floored} = wasm_f32x4_floor(${peekIdx});
+v128_t ${frac} = wasm_f32x4_sub(${peekIdx}, ${floored});
+v128_t ${nextIdx} = wasm_f32x4_add(${floored}, ${splat(1)});
+v128_t ${channelIdx}_start = wasm_f32x4_mul(${splat(perChannel)}, ${channelVariable});
+${nextIdx} = wasm_v128_bitselect(${channelIdx}_start, ${nextIdx}, wasm_f32x4_ge(${nextIdx}, wasm_f32x4_add(${channelIdx}_start, ${splat(perChannel)})));
+v128_t ${peekVal} = zen_f32x4_lerp(zen_f32x4_gather(memory + ${idx}, ${floored}), zen_f32x4_gather(memory + ${idx}, ${nextIdx}), ${frac});
+`;
+      }
+      return {
+        type: "SUCCESS",
+        generated: context.emitSIMD(
+          code,
+          peekVal,
+          ...withoutBlockRateDependencies([_index, _channel]),
+        ),
+      };
+    },
     index,
     channel,
   );
 };
 
+// marks poke()'s code, whose index isn't bounded to its buffer (see blocks/promote.ts)
+export const POKE = "// begin poke";
+
 export const poke = (data: BlockGen, index: Arg, channel: Arg, value: Arg): UGen => {
   let id = uuid();
+  data.poked = true;
   return simdMemo(
     (context: Context, _index: Generated, _channel: Generated, _value: Generated): Generated => {
       let multichannelBlock = data(context);
@@ -256,7 +370,7 @@ export const poke = (data: BlockGen, index: Arg, channel: Arg, value: Arg): UGen
       let floor = context.target === Target.C ? cKeywords["Math.floor"] : "Math.floor";
       let pokeIdx = `${perChannel} * ${_channel.variable} + ${floor}(${_index.variable})`;
       let code = `
-// begin poke
+${POKE}
 ${intKeyword} ${_idx2} = ${multichannelBlock._idx || multichannelBlock.idx} + ${pokeIdx};
 memory[${_idx2}] = ${_value.variable};
 ${context.varKeyword} ${pokeVal} = ${_value.variable};
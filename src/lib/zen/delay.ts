@@ -7,13 +7,28 @@ import { accum } from "./accum";
 import { lerpPeek } from "./lerp";
 import { uuid } from "./uuid";
 import { MemoryBlock } from "./block";
+import { type Precision, F64_TYPE, isF64 } from "./precision";
 
 const MAX_SIZE = 4 * 44100; // 4 sec max
 
-export const delay = (input: Arg, delayTime: Arg): UGen => {
-  const buf = data(MAX_SIZE + 1, 1);
+// past this heap position an f32 read position resolves less than 1/128th of a sample
+const F32_EXACT_POSITIONS = 1 << 16;
+
+/**
+ * The read position is an absolute memory[] index, so its resolution drops the further
+ * into the heap the buffer lands: unless precision says otherwise it's kept in f64
+ * wherever f32 would audibly quantize a modulated delay time.
+ */
+export const delay = (input: Arg, delayTime: Arg, precision?: Precision): UGen => {
+  // a fixed delay time only needs a ring long enough to reach back that far (plus the
+  // sample after it, for the lerp), instead of the full 4 seconds
+  const size =
+    typeof delayTime === "number" && delayTime >= 0
+      ? Math.min(MAX_SIZE, Math.ceil(delayTime) + 2)
+      : MAX_SIZE;
+  const buf = data(size + 1, 1);
   const id = uuid();
-  const a = accum(1, 0, { min: 0, max: MAX_SIZE, exclusive: true });
+  const a = accum(1, 0, { min: 0, max: size, exclusive: true });
 
   return simdMemo(
     (context: Context, _input: Generated, _delayTime: Generated): Generated => {
@@ -29,16 +44,23 @@ export const delay = (input: Arg, delayTime: Arg): UGen => {
 
       let _accum = a(context);
       let index = `${buffer.idx} + (${_accum.variable})`;
+      let wide = isF64(
+        precision ||
+          (typeof buffer.idx === "number" && buffer.idx + size > F32_EXACT_POSITIONS
+            ? "f64"
+            : "f32"),
+        context.target,
+      );
       let lerped = lerpPeek(id, context, buffer, delayIndexName);
       //${_accum.code}
       let out = `
 ${context.target === Target.C ? "int" : "let"} ${indexName} = ${index};
 memory[${indexName}] = ${_input.variable};
-${context.target === Target.C ? "double" : "let"} ${delayIndexName} = ${indexName} - ${_delayTime.variable};
+${context.target === Target.C ? (wide ? F64_TYPE : "double") : "let"} ${delayIndexName} = ${indexName} - ${_delayTime.variable};
 if (${delayIndexName} < ${buffer.idx}) {
-  ${delayIndexName} += ${MAX_SIZE};
+  ${delayIndexName} += ${size};
 } else if (${delayIndexName} >= ${buffer.idx} + ${buffer.length} - 1) {
-  ${delayIndexName} -= ${MAX_SIZE};
+  ${delayIndexName} -= ${size};
 }
 ${lerped.code}
 ${context.varKeyword} ${delayName} = ${lerped.variable};
@@ -0,0 +1,87 @@
+import { Target } from "./targets";
+
+/**
+ * Feedback decaying towards silence (histories, t60/decay, filter state, delay feedback)
+ * ends up in subnormal floats once the input stops, and x86 runs subnormal arithmetic
+ * through microcode, at 10-100x the cost: a patch going quiet is a CPU spike.
+ *
+ * Native kernels set FTZ/DAZ (the MXCSR bits on x86, FPCR.FZ on arm64) for the length of
+ * process(), restoring the host's mode on the way out. Wasm has no such mode, so there
+ * every feedback write goes through ZEN_SNAP, which zeroes anything below
+ * DENORMAL_THRESHOLD (~-300dB, long past audible but ~23 decades above the subnormals).
+ * Natively ZEN_SNAP is free: the hardware already flushes.
+ *
+ * Built with -DZEN_ALLOW_DENORMALS a native kernel does neither, and with -DZEN_NO_FTZ it
+ * snaps like wasm does instead of setting FTZ (test/zen-native-denormals.ts compares all
+ * three).
+ */
+export const DENORMAL_THRESHOLD = "1e-15f";
+
+// the feedback write of a float (or zen_f64) variable
+export const printSnap = (variable: string): string => `ZEN_SNAP(${variable})`;
+
+export const printSnapLanes = (value: string): string => `ZEN_SNAP_LANES(${value})`;
+
+const printSnapping = () => `
+#define ZEN_SNAP(x) ((x) > -${DENORMAL_THRESHOLD} && (x) < ${DENORMAL_THRESHOLD} ? 0 : (x))
+static inline v128_t zen_snap_lanes(v128_t x) {
+    v128_t small = wasm_f32x4_lt(wasm_f32x4_abs(x), wasm_f32x4_splat(${DENORMAL_THRESHOLD}));
+    return wasm_v128_andnot(x, small);
+}
+#define ZEN_SNAP_LANES(x) zen_snap_lanes(x)`;
+
+const printNoMode = () => `
+typedef int zen_fp_mode;
+static inline zen_fp_mode zen_denormals_off(void) { return 0; }
+static inline void zen_denormals_restore(zen_fp_mode mode) { (void)mode; }
+#define zen_denormals_task()`;
+
+/**
+ * The flush-to-zero mode and ZEN_SNAP for a kernel printed for target.
+ */
+export const printDenormalHelpers = (target: Target): string => {
+  if (target !== Target.NativeC) {
+    return `${printNoMode()}
+${printSnapping()}`;
+  }
+  return `
+#if !defined(ZEN_ALLOW_DENORMALS) && !defined(ZEN_NO_FTZ) && (defined(__x86_64__) || defined(__i386__))
+#include <xmmintrin.h>
+typedef unsigned int zen_fp_mode;
+static inline zen_fp_mode zen_denormals_off(void) {
+    zen_fp_mode mode = _mm_getcsr();
+    _mm_setcsr(mode | 0x8040); // FTZ | DAZ
+    return mode;
+}
+static inline void zen_denormals_restore(zen_fp_mode mode) { _mm_setcsr(mode); }
+#define ZEN_FTZ
+#elif !defined(ZEN_ALLOW_DENORMALS) && !defined(ZEN_NO_FTZ) && defined(__aarch64__)
+typedef uint64_t zen_fp_mode;
+static inline zen_fp_mode zen_denormals_off(void) {
+    zen_fp_mode mode;
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(mode));
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(mode | (1ull << 24))); // FZ
+    return mode;
+}
+static inline void zen_denormals_restore(zen_fp_mode mode) {
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(mode));
+}
+#define ZEN_FTZ
+#else${printNoMode()}
+#endif
+
+#if defined(ZEN_FTZ)
+// the mode is per thread: a batch's OpenMP workers set it for themselves (and keep it)
+#if defined(_OPENMP)
+#define zen_denormals_task() zen_denormals_off()
+#else
+#define zen_denormals_task()
+#endif
+#define ZEN_SNAP(x) (x)
+#define ZEN_SNAP_LANES(x) (x)
+#elif defined(ZEN_ALLOW_DENORMALS)
+#define ZEN_SNAP(x) (x)
+#define ZEN_SNAP_LANES(x) (x)
+#else${printSnapping()}
+#endif`;
+};
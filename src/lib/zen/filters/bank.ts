@@ -0,0 +1,466 @@
+import { Arg, UGen, Generated } from "../zen";
+import { Context, SIMDContext } from "../context";
+import { simdMemo } from "../memo-simd";
+import { SIMDOutput } from "../memo";
+import { Target } from "../targets";
+import { uuid } from "../uuid";
+import { printSnapLanes } from "../denormals";
+
+/**
+ * Filter banks: N instances of one recursive filter run side by side, one instance per
+ * SIMD lane.
+ *
+ * A filter's feedback recurrence means a single instance can never be vectorized along
+ * the sample axis, so onepole/biquad/svf/zdf always force scalar blocks and a 32 voice
+ * synth runs 32 scalar filters per sample. The instances of a bank are independent, so
+ * every sample the bank steps SIMD_WIDTH of them per instruction instead: state and
+ * coefficients are laid out SoA (state k of instance v at S + k*lanes + v), and the
+ * per-voice inputs and params are gathered into lane arrays first.
+ *
+ * Each voice's output is written to its own BLOCK_SIZE run of memory, so whatever reads
+ * it (typically a mix of the voices) can itself be a SIMD block.
+ *
+ * Params are either one Arg shared by every voice, or an array with an Arg per voice.
+ */
+export type BankParam = Arg | Arg[];
+
+// lanes are padded to the widest SIMD_WIDTH, so any build steps whole vectors
+const MAX_SIMD_WIDTH = 16;
+
+/**
+ * Prints lane-wise arithmetic: v128_t ops in C, where the step runs SIMD_WIDTH voices at a
+ * time, and plain scalar expressions in JS, where the step is unrolled per voice.
+ */
+export interface Lanes {
+  vector: boolean;
+  splat: (x: number | string) => string;
+  add: (a: string, b: string) => string;
+  sub: (a: string, b: string) => string;
+  mul: (a: string, b: string) => string;
+  div: (a: string, b: string) => string;
+  min: (a: string, b: string) => string;
+  max: (a: string, b: string) => string;
+  abs: (a: string) => string;
+  sin: (a: string) => string;
+  cos: (a: string) => string;
+  tan: (a: string) => string;
+}
+
+const vectorLanes: Lanes = {
+  vector: true,
+  splat: (x) => `wasm_f32x4_splat(${x})`,
+  add: (a, b) => `wasm_f32x4_add(${a}, ${b})`,
+  sub: (a, b) => `wasm_f32x4_sub(${a}, ${b})`,
+  mul: (a, b) => `wasm_f32x4_mul(${a}, ${b})`,
+  div: (a, b) => `wasm_f32x4_div(${a}, ${b})`,
+  min: (a, b) => `wasm_f32x4_min(${a}, ${b})`,
+  max: (a, b) => `wasm_f32x4_max(${a}, ${b})`,
+  abs: (a) => `wasm_f32x4_abs(${a})`,
+  sin: (a) => `zen_f32x4_sin(${a})`,
+  cos: (a) => `zen_f32x4_cos(${a})`,
+  tan: (a) => `wasm_f32x4_div(zen_f32x4_sin(${a}), zen_f32x4_cos(${a}))`,
+};
+
+const scalarLanes: Lanes = {
+  vector: false,
+  splat: (x) => `${x}`,
+  add: (a, b) => `(${a} + ${b})`,
+  sub: (a, b) => `(${a} - ${b})`,
+  mul: (a, b) => `(${a} * ${b})`,
+  div: (a, b) => `(${a} / ${b})`,
+  min: (a, b) => `Math.min(${a}, ${b})`,
+  max: (a, b) => `Math.max(${a}, ${b})`,
+  abs: (a) => `Math.abs(${a})`,
+  sin: (a) => `Math.sin(${a})`,
+  cos: (a) => `Math.cos(${a})`,
+  tan: (a) => `Math.tan(${a})`,
+};
+
+/**
+ * What a kernel's step prints with. Temporaries and state writes are collected in order,
+ * the step itself returns the output expression.
+ */
+export class Step {
+  code = "";
+
+  constructor(
+    private l: Lanes,
+    private prefix: string,
+    private stateAt: (k: number) => string,
+  ) {}
+
+  // this sample's value of the k-th state
+  state(k: number): string {
+    return this.l.vector ? `wasm_v128_load(${this.stateAt(k)})` : this.stateAt(k);
+  }
+
+  // the k-th state for the next sample (decaying towards silence, so denormals are snapped)
+  next(k: number, value: string) {
+    this.code += this.l.vector
+      ? `wasm_v128_store(${this.stateAt(k)}, ${printSnapLanes(value)});\n`
+      : `${this.stateAt(k)} = ${value};\n`;
+  }
+
+  let(name: string, expr: string): string {
+    const variable = `${this.prefix}_${name}`;
+    this.code += `${this.l.vector ? "v128_t" : "let"} ${variable} = ${expr};\n`;
+    return variable;
+  }
+}
+
+export interface BankKernel {
+  name: string;
+  states: number;
+  // one step of the filter for a group of lanes, returning the output
+  step: (l: Lanes, s: Step, x: string, params: string[], context: Context) => string;
+}
+
+/**
+ * Prints one step of kernel: SIMD_WIDTH lanes at a time (vector) or a single voice.
+ * stateAt(k) is where the k-th state of the lanes being stepped lives.
+ */
+export const printStep = (
+  kernel: BankKernel,
+  vector: boolean,
+  prefix: string,
+  stateAt: (k: number) => string,
+  x: string,
+  params: string[],
+  context: Context,
+): { code: string; output: string } => {
+  const l = vector ? vectorLanes : scalarLanes;
+  const s = new Step(l, prefix, stateAt);
+  const output = kernel.step(l, s, x, params, context);
+  return { code: s.code, output };
+};
+
+const filterBank = (
+  kernel: BankKernel,
+  inputs: Arg[],
+  params: BankParam[],
+  shared: boolean[] = [],
+): UGen[] => {
+  const voices = inputs.length;
+  const lanes = Math.ceil(voices / MAX_SIMD_WIDTH) * MAX_SIMD_WIDTH;
+  for (let p = 0; p < params.length; p++) {
+    const param = params[p];
+    if (Array.isArray(param) && (shared[p] || param.length !== voices)) {
+      throw new Error(
+        `${kernel.name} bank: param ${p} must be ${shared[p] ? "shared by every voice" : `one Arg or ${voices} Args`}`,
+      );
+    }
+  }
+  // every Arg the step reads, so simdMemo generates them: the inputs, then the params
+  const args: Arg[] = [...inputs, ...params.flatMap((p) => (Array.isArray(p) ? p : [p]))];
+
+  const id = uuid();
+  let outputIdx: number | string | undefined;
+  const bank = simdMemo(
+    (context: Context, ..._args: Generated[]): Generated => {
+      const [out, lanesOut, x, p] = context.useCachedVariables(
+        id,
+        `${kernel.name}Bank`,
+        "bankOut",
+        "bankIn",
+        "bankParam",
+      );
+      const state = context.alloc(kernel.states * lanes, id);
+      const output = context.alloc(voices * context.blockSize);
+      outputIdx = output.idx;
+      const S = `${state.idx}`;
+      const O = `${output.idx}`;
+
+      // where each param's per-voice values come from
+      const _inputs = _args.slice(0, voices);
+      let cursor = voices;
+      const _params = params.map((param) => {
+        if (Array.isArray(param)) {
+          const voiceArgs = _args.slice(cursor, cursor + voices);
+          cursor += voices;
+          return voiceArgs;
+        }
+        return _args[cursor++];
+      });
+
+      let code = "";
+      if (context.target === Target.C) {
+        // gather the voices into lanes, step SIMD_WIDTH voices at a time. The lane arrays
+        // are static, so the padding past the last voice is zeroed once, when the module
+        // loads, and a sample only copies in the voices (per thread, for parallel batches)
+        const laneArray = (name: string, values: Generated[] = []) =>
+          `static ZEN_THREAD_LOCAL float ${name}[${lanes}] __attribute__((aligned(SIMD_ALIGN)));
+${values.map((value, v) => `${name}[${v}] = ${value.variable};`).join("\n")}
+`;
+        code += laneArray(x, _inputs);
+        const paramLanes = _params.map((param, k) => {
+          if (Array.isArray(param)) {
+            code += laneArray(`${p}${k}`, param);
+            return `wasm_v128_load(${p}${k} + v)`;
+          }
+          return shared[k] ? param.variable! : vectorLanes.splat(param.variable!);
+        });
+        const step = printStep(
+          kernel,
+          true,
+          lanesOut,
+          (k) => `memory + ${S} + ${k * lanes} + v`,
+          `wasm_v128_load(${x} + v)`,
+          paramLanes,
+          context,
+        );
+        code += `${laneArray(lanesOut)}for (int v = 0; v < ${voices}; v += SIMD_WIDTH) {
+${step.code}wasm_v128_store(${lanesOut} + v, ${step.output});
+}
+for (int v = 0; v < ${voices}; v++) {
+memory[${O} + v*${context.blockSize} + j] = ${lanesOut}[v];
+}
+`;
+      } else {
+        // no vectors in JS: the same step, unrolled per voice
+        for (let v = 0; v < voices; v++) {
+          const step = printStep(
+            kernel,
+            false,
+            `${lanesOut}_${v}`,
+            (k) => `memory[${S} + ${k * lanes + v}]`,
+            _inputs[v].variable!,
+            _params.map((param) => (Array.isArray(param) ? param[v] : param).variable!),
+            context,
+          );
+          code += `${step.code}memory[${O} + ${v * context.blockSize} + j] = ${step.output};
+`;
+        }
+      }
+      // the bank's own variable is the first voice, so it can cross blocks like any float
+      code += `${context.varKeyword} ${out} = memory[${O} + j];
+`;
+      return context.emit(code, out, ..._args);
+    },
+    undefined,
+    ...args,
+  );
+
+  return inputs.map((_, v) => voiceOutput(bank, v, () => outputIdx));
+};
+
+/**
+ * Reads one voice of a bank: its BLOCK_SIZE run of outputs, so it loads as a vector.
+ */
+const voiceOutput = (
+  bank: UGen,
+  voice: number,
+  outputIdx: () => number | string | undefined,
+): UGen => {
+  const id = uuid();
+  return simdMemo(
+    (context: Context, _bank: Generated): Generated => {
+      const [out] = context.useCachedVariables(id, "bankVoice");
+      return context.emit(
+        `${context.varKeyword} ${out} = memory[${outputIdx()} + ${voice * context.blockSize} + j];\n`,
+        out,
+        _bank,
+      );
+    },
+    (context: SIMDContext, _bank: Generated): SIMDOutput => {
+      const [out] = context.useCachedVariables(id, "bankVoice");
+      return {
+        type: "SUCCESS",
+        generated: context.emitSIMD(
+          `v128_t ${out} = wasm_v128_load(memory + ${outputIdx()} + ${voice * context.blockSize} + j);\n`,
+          out,
+          _bank,
+        ),
+      };
+    },
+    bank,
+  );
+};
+
+export const onepoleKernel: BankKernel = {
+  name: "onepole",
+  states: 1,
+  step: (l, s, x, [cutoff]) => {
+    const y = s.let("y", l.add(l.mul(s.state(0), cutoff), l.mul(x, l.sub(l.splat(1), cutoff))));
+    s.next(0, y);
+    return y;
+  },
+};
+
+/**
+ * Same math as biquad(): the RBJ cookbook coefficients, by mode lowpass, highpass,
+ * bandpass (peak gain Q), bandpass (0dB peak), notch, allpass.
+ */
+export const biquadKernel: BankKernel = {
+  name: "biquad",
+  states: 4,
+  step: (l, s, x, [cutoff, resonance, gain, mode]) => {
+    const w = s.let("w", l.mul(l.abs(cutoff), l.splat(0.00014247585730565955)));
+    const c = s.let("c", l.cos(w));
+    const sn = s.let("sn", l.sin(w));
+    const alpha = s.let("alpha", l.div(l.mul(sn, l.splat(0.5)), l.abs(resonance)));
+    const r = s.let("r", l.div(l.splat(1), l.add(alpha, l.splat(1))));
+    const g = s.let("g", l.mul(r, gain));
+    const halfSn = l.mul(sn, l.splat(0.5));
+    const twoC = l.mul(c, l.splat(-2));
+    // mode is shared by every voice, so it picks each coefficient with a plain branch,
+    // like the selector() in biquad()
+    const select = (...byMode: string[]) =>
+      `(${mode} <= -1 ? ${l.splat(0)} : ${mode} <= 0 ? ${byMode[0]} : ${mode} >= 5 ? ${byMode[5]} : ${byMode
+        .slice(1, 5)
+        .map((coefficient, m) => `${mode} == ${m + 1} ? ${coefficient} : `)
+        .join("")}${l.splat(0)})`;
+    const one = l.splat(1);
+    const b0 = s.let(
+      "b0",
+      l.mul(
+        select(
+          l.div(l.sub(one, c), l.splat(2)),
+          l.div(l.add(one, c), l.splat(2)),
+          alpha,
+          halfSn,
+          one,
+          l.sub(one, alpha),
+        ),
+        g,
+      ),
+    );
+    const b1 = s.let(
+      "b1",
+      l.mul(select(l.sub(one, c), l.sub(l.splat(-1), c), l.splat(0), l.splat(0), twoC, twoC), g),
+    );
+    const b2 = s.let(
+      "b2",
+      l.mul(
+        select(
+          l.div(l.sub(one, c), l.splat(2)),
+          l.div(l.add(one, c), l.splat(2)),
+          l.mul(alpha, l.splat(-1)),
+          l.mul(halfSn, l.splat(-1)),
+          one,
+          l.add(alpha, one),
+        ),
+        g,
+      ),
+    );
+    const a1 = s.let("a1", l.mul(twoC, r));
+    const a2 = s.let("a2", l.mul(l.sub(one, alpha), r));
+    // states: x[n-1], x[n-2], y[n-1], y[n-2]. Like biquad(), the output is y[n-1]
+    const previous = s.let("previous", s.state(2));
+    const y = s.let(
+      "y",
+      l.sub(
+        l.add(l.add(l.mul(x, b0), l.mul(s.state(0), b1)), l.mul(s.state(1), b2)),
+        l.add(l.mul(s.state(2), a1), l.mul(s.state(3), a2)),
+      ),
+    );
+    s.next(1, s.state(0));
+    s.next(0, x);
+    s.next(3, s.state(2));
+    s.next(2, y);
+    return previous;
+  },
+};
+
+// same math as svf(): mode crossfades lowpass -> highpass -> bandpass
+export const svfKernel: BankKernel = {
+  name: "svf",
+  states: 2,
+  step: (l, s, x, [cutoff, resonance, mode]) => {
+    const t = s.let("t", l.tan(l.mul(cutoff, l.splat(0.7853981633974483))));
+    const a = s.let("a", l.div(t, l.add(t, l.splat(1))));
+    const r = s.let("r", l.div(l.splat(1), resonance));
+    const hp = s.let(
+      "hp",
+      l.mul(
+        l.sub(x, l.add(s.state(0), l.mul(s.state(1), l.add(a, r)))),
+        l.div(l.splat(1), l.add(l.add(l.mul(a, a), l.mul(a, r)), l.splat(1))),
+      ),
+    );
+    const v1 = s.let("v1", l.mul(hp, a));
+    const bp = s.let("bp", l.add(v1, s.state(1)));
+    const v2 = s.let("v2", l.mul(bp, a));
+    const lp = s.let("lp", l.add(v2, s.state(0)));
+    s.next(0, l.add(lp, v2));
+    s.next(1, l.add(v1, bp));
+    const mt = s.let("mt", l.sub(l.splat(1), mode));
+    return l.add(
+      l.add(l.mul(l.mul(lp, mt), mt), l.mul(l.mul(l.mul(l.splat(2), hp), mt), mode)),
+      l.mul(l.mul(bp, mode), mode),
+    );
+  },
+};
+
+// same math as zdf()
+export const zdfKernel: BankKernel = {
+  name: "zdf",
+  states: 4,
+  step: (l, s, x, [cutoff, resonance], { sampleRate }) => {
+    // the rational tanh approximation zdf() uses
+    const saturate = (name: string, v: string) => {
+      const v2 = s.let(`${name}2`, l.mul(v, v));
+      return s.let(
+        name,
+        l.div(l.mul(v, l.add(l.splat(27), v2)), l.add(l.splat(27), l.mul(l.splat(9), v2))),
+      );
+    };
+    const omega = l.div(
+      l.mul(l.splat(2 * Math.PI), l.min(cutoff, l.splat(0.1 * sampleRate))),
+      l.splat(sampleRate),
+    );
+    const g = s.let("g", l.mul(omega, l.splat(1.989)));
+    const g2 = s.let("g2", l.mul(g, g));
+    const g3 = s.let("g3", l.mul(g2, g));
+    const A = s.let("A", l.div(l.splat(1), l.add(l.splat(1), l.mul(resonance, l.mul(g3, g)))));
+    const [z1, z2, z3, z4] = [0, 1, 2, 3].map((k) => s.let(`z${k + 1}`, s.state(k)));
+    const feedback = l.mul(
+      l.add(z4, l.mul(g, l.add(z3, l.mul(g2, l.add(z2, l.mul(g3, z1)))))),
+      resonance,
+    );
+    const fb = s.let("fb", l.min(l.max(feedback, l.splat(-1)), l.splat(1)));
+    const u = s.let("u", l.sub(x, saturate("ufb", l.mul(A, fb))));
+    const y1 = saturate("y1", l.add(z1, l.mul(g, u)));
+    const y2 = saturate("y2", l.add(z2, l.mul(g, y1)));
+    const y3 = saturate("y3", l.add(z3, l.mul(g, y2)));
+    const y4 = saturate("y4", l.add(z4, l.mul(g, y3)));
+    const twoG = s.let("twoG", l.mul(l.splat(2), g));
+    s.next(0, l.add(z1, l.mul(twoG, l.sub(u, y1))));
+    s.next(1, l.add(z2, l.mul(twoG, l.sub(y1, y2))));
+    s.next(2, l.add(z3, l.mul(twoG, l.sub(y2, y3))));
+    s.next(3, l.add(z4, l.mul(twoG, l.sub(y3, y4))));
+    return y4;
+  },
+};
+
+/**
+ * onepole() for every input, as one bank. Returns the filtered voices, in input order.
+ */
+export const onepoleBank = (inputs: Arg[], cutoff: BankParam): UGen[] =>
+  filterBank(onepoleKernel, inputs, [cutoff]);
+
+/**
+ * biquad() for every input, as one bank. mode must be shared by every voice.
+ */
+export const biquadBank = (
+  inputs: Arg[],
+  cutoff: BankParam,
+  resonance: BankParam,
+  gain: BankParam,
+  mode: Arg,
+): UGen[] =>
+  filterBank(biquadKernel, inputs, [cutoff, resonance, gain, mode], [false, false, false, true]);
+
+/**
+ * svf() for every input, as one bank.
+ */
+export const svfBank = (
+  inputs: Arg[],
+  cutoff: BankParam,
+  resonance: BankParam,
+  mode: BankParam,
+): UGen[] => filterBank(svfKernel, inputs, [cutoff, resonance, mode]);
+
+/**
+ * zdf() for every input, as one bank.
+ */
+export const zdfBank = (inputs: Arg[], cutoff: BankParam, resonance: BankParam): UGen[] =>
+  filterBank(zdfKernel, inputs, [cutoff, resonance]);
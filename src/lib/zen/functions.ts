@@ -26,6 +26,8 @@ import { CodeFragment, printCodeFragments } from "./emitter";
 export type Function = {
   name: string;
   size: number;
+  // set by gatedDefun: the output holding the activity signal, and the wake arguments
+  gate?: { output: number; wake: number[] };
 } & Generated;
 
 export type LazyFunction = (context: Context, forceScalar: boolean) => Function;
@@ -51,6 +53,7 @@ export const defun = (name: string, size: number, ...bodies: UGen[]): LazyFuncti
 
     // evaluate each body with the context
     let _bodies: Generated[] = bodies.map((x, i) => output(x, i)(functionContext));
+    functionContext.releaseArena();
 
     // each of these has fragments
 
@@ -101,6 +104,40 @@ ${arrayName}[${i}] = ${body.variable};
   };
 };
 
+/**
+ * Lets the kernel skip invocations that have nothing to do, e.g. grains whose window has
+ * closed or voices whose envelope has finished.
+ *
+ * An invocation goes idle after a block in which activity was 0 for every sample and no
+ * wake argument was nonzero (a trigger on a block's last sample can't have raised activity
+ * yet). While
+ * it's idle its body isn't run at all (its state doesn't advance) and its outputs are
+ * 0, until a block where one of the wake arguments (its triggers) is nonzero.
+ */
+export interface FunctionGate {
+  activity: UGen;
+  // argument numbers, as passed to argument()
+  wake: number[];
+}
+
+/**
+ * defun, for a function whose invocations are idle most of the time: see FunctionGate.
+ * The activity signal is printed as one more output, after the bodies.
+ */
+export const gatedDefun = (
+  name: string,
+  size: number,
+  gate: FunctionGate,
+  ...bodies: UGen[]
+): LazyFunction => {
+  const lazyFunction = defun(name, size, ...bodies, gate.activity);
+  return (context: Context, forceScalar: boolean): Function => {
+    const func = lazyFunction(context, forceScalar);
+    func.gate = { output: bodies.length, wake: gate.wake };
+    return func;
+  };
+};
+
 const containsCycle = (context: Context, args: Generated[]): boolean => {
   let historiesBeingWritten = getHistoriesBeingWrittenTo(context);
 
@@ -172,7 +209,7 @@ export const call = (lazyFunction: LazyFunction, invocation: number, ...args: Ar
     let totalOutputs = _func.totalOutputs || countOutputs(_func.codeFragments);
     let name = _func.name;
 
-    let arrayOffset = forceScalar ? totalOutputs : 128 * totalOutputs;
+    let arrayOffset = forceScalar ? totalOutputs : context.blockSize * totalOutputs;
     //let [variable] = context.useVariables(`${name}Value`);
     let variable =
       context.target === Target.C
@@ -190,7 +227,7 @@ export const call = (lazyFunction: LazyFunction, invocation: number, ...args: Ar
     let variables: string[] = [];
     for (let evaluatedArg of _args) {
       if (evaluatedArg.scalar !== undefined) {
-        // we need to create a constant array of size 128...
+        // we need to create a constant array of size BLOCK_SIZE...
         if (forceScalar) {
           variables.push(evaluatedArg.variable!);
         } else {
@@ -273,6 +310,9 @@ export const call = (lazyFunction: LazyFunction, invocation: number, ...args: Ar
   };
 };
 
+// marks latchcall()'s code, whose callee reads and writes memory[] (see blocks/promote.ts)
+export const LATCH_CALL = "// begin latchcall";
+
 export const latchcall = (
   lazyFunction: LazyFunction,
   invocation: number,
@@ -347,7 +387,7 @@ export const latchcall = (
     let _func: Function = lazyFunction(context.baseContext.useContext(false, true), true);
     let totalOutputs = _func.totalOutputs || countOutputs(_func.codeFragments);
     let name = _func.name;
-    block = block || context.alloc(totalOutputs);
+    block = block || context.alloc(totalOutputs, id);
 
     // call the function w/ the invocation number
     // how do we route the correct arguments to the right ordering
@@ -365,6 +405,7 @@ export const latchcall = (
     //console.log("latch call function =", _func);
 
     code += `
+${LATCH_CALL}
 if (${_latchCondition.variable} > 0) {
     ${THIS}${name} (${invocation}, ${_args.map((x) => x.variable).join(",")});
 `;
@@ -458,7 +499,7 @@ export const nth = (array: Arg, index: Arg = 0) => {
       // TODO: need to know the function's output count in order to do this correctly.
       let offsetedArray = forceScalar
         ? `${_array.variable} + 1*${indexScalar} `
-        : `${_array.variable} + 128 * ${indexScalar} `;
+        : `${_array.variable} + ${context.blockSize} * ${indexScalar} `;
       let isLatchCall = _array.variable!.includes("memory");
 
       if (context.target === Target.Javascript) {
@@ -534,7 +575,7 @@ export const nth = (array: Arg, index: Arg = 0) => {
       // TODO: need to know the function's output count in order to do this correctly.
       let offsetedArray = forceScalar
         ? `${_array.variable} + ${indexScalar} `
-        : `${_array.variable} + 128 * ${indexScalar} `;
+        : `${_array.variable} + ${context.blockSize} * ${indexScalar} `;
 
       // in latch call's case, we receive a pointer to memory where the latchcalls were saved
       // thus we cant do wasm_v128_load offseted by "j" (aka the for-loop iteration), as that would get
@@ -7,15 +7,33 @@ import { UGen, Generated, Arg, float } from "./zen";
 import { Context, emitCodeHelper, ContextMessageType } from "./context";
 import { emitFunctions, emitArguments } from "./functions";
 import { SIMDContext } from "./index";
+import { Target } from "./targets";
+import {
+  type Precision,
+  F64_CELLS,
+  F64_TYPE,
+  decodeF64,
+  encodeF64,
+  isF64,
+  printLoadF64,
+  printStoreF64,
+} from "./precision";
+import { printSnap } from "./denormals";
 
 export type Samples = number;
 
 interface HistoryParams {
-  inline: boolean;
+  inline?: boolean;
   name?: string;
   min?: number;
   max?: number;
   mc?: boolean;
+  // read per sample from an automation lane (C target), so scheduled values/ramps land
+  // on the exact sample instead of at the next block
+  automated?: boolean;
+  // f64 keeps a plain history's state (and the arithmetic on it) in double precision on the
+  // C target; named, mc and automated histories are always f32
+  precision?: Precision;
 }
 
 /**
@@ -31,7 +49,7 @@ interface HistoryParams {
 
 // A function that also has fields to manipulate the history value at runtime
 export type History = ((input?: UGen, reset?: UGen) => UGen) & {
-  value?: (v: number, time?: number, invocation?: number) => void;
+  value?: (v: number, time?: number, invocation?: number, ramp?: number) => void;
   paramName?: string;
   getInitData?: () => number;
   getIdx?: () => number | undefined;
@@ -66,6 +84,14 @@ export const history = (
   debugName?: string,
   FORCENEW?: boolean,
 ): History => {
+  // precision alone doesn't make a history a param
+  const precision = params?.precision;
+  if (params && Object.keys(params).every((key) => key === "precision")) {
+    params = undefined;
+  }
+  const isWide = (context: Context) =>
+    isF64(precision, context.target) && !params?.name && !params?.mc && !params?.automated;
+
   // State for this history instance
   let block: MemoryBlock | undefined;
   let historyVar: string | undefined;
@@ -208,10 +234,13 @@ export const history = (
     // Allocate a memory block for this history
     const allocateBlock = (context: Context): MemoryBlock => {
       let block = params?.mc
-        ? context.alloc(1)
+        ? context.alloc(1, inputId, debugName)
         : params
           ? context.baseContext.alloc(1)
-          : context.alloc(1);
+          : context.alloc(isWide(context) ? F64_CELLS : 1, inputId, debugName);
+      if (isWide(context)) {
+        block.precision = "f64";
+      }
       contextBlocks = contextBlocks.filter((x) => !x.context.disposed);
       contextBlocks.push({ context: context.baseContext, block });
       return block;
@@ -261,10 +290,21 @@ export const history = (
       }
 
       let IDX = block.idx;
+      const wide = block.precision === "f64";
+
+      // an automated param is read through its lane: ZEN_LANE is memory[IDX] (block-rate) and
+      // printBlock swaps it for the per-sample lane wherever there's a sample loop
+      const automated =
+        params?.automated && !params.mc && context.target === Target.C && /^\d+$/.test(`${IDX}`);
+      const read = automated
+        ? `ZEN_LANE(${context.useAutomationLane(IDX as number)}, ${IDX})`
+        : wide
+          ? printLoadF64(IDX)
+          : `memory[${IDX}]`;
 
       // Define how to read from history (accessing memory)
       let codeGen =
-        `${context.varKeyword} ${historyVar} = memory[${IDX}];` +
+        `${wide ? F64_TYPE : context.varKeyword} ${historyVar} = ${read};` +
         (params ? `/* param ${params.name || ""}*/` : "") +
         "\n";
 
@@ -325,6 +365,22 @@ export const history = (
         codeGen,
         fragmentVariable,
       );
+      if (wide) {
+        out.precision = "f64";
+      }
+
+      // params are only ever written between blocks (events are applied at the start of
+      // process), so reading one is uniform across the block -- unless it's automated
+      if (
+        !_input &&
+        params &&
+        !params.mc &&
+        !params.automated &&
+        context.target === Target.C &&
+        /^\d+$/.test(`${IDX}`)
+      ) {
+        out.uniform = `memory[${IDX}]`;
+      }
 
       // Memoize the results
       if (input !== undefined) {
@@ -337,6 +393,13 @@ export const history = (
 
     // Set initial data for the memory block
     const initializeBlockWithData = (block: MemoryBlock) => {
+      if (block.precision === "f64") {
+        const init = cachedValue !== undefined ? cachedValue : val;
+        if (init !== undefined) {
+          block.initData = encodeF64(init);
+        }
+        return;
+      }
       if (val !== undefined) {
         block.initData = new Float32Array(
           params?.mc ? new Array((block.context as any).loopSize).fill(val) : [val],
@@ -363,13 +426,23 @@ export const history = (
       // Create variable for writing to history
       let [newVariable] = context.useCachedVariables(inputId, debugName || "histVal");
 
+      const wide = block?.precision === "f64";
+      // a feedback write: what decays towards silence through it is snapped to 0 before
+      // it turns subnormal
+      const value =
+        context.target === Target.C ? printSnap(_input.variable!) : _input.variable;
+
       // Write input to memory at the block index
-      let code = `
-memory[${IDX}] = ${_input.variable};
+      let code = wide
+        ? `
+${printStoreF64(IDX, value)}
+`
+        : `
+memory[${IDX}] = ${value};
 `;
       // Handle inline parameter
       if (!params || !params.inline) {
-        code += `${context.varKeyword} ${newVariable} = ${historyVar};
+        code += `${wide ? F64_TYPE : context.varKeyword} ${newVariable} = ${historyVar};
 `;
       }
       if (params && params.inline) {
@@ -450,6 +523,9 @@ memory[${IDX}] = ${_input.variable};
 
   // Get initial data value
   _history.getInitData = () => {
+    if (block?.precision === "f64" && block.initData) {
+      return decodeF64(block.initData);
+    }
     if (block && block.initData && block.initData[0] !== undefined) {
       return block.initData[0];
     }
@@ -457,10 +533,22 @@ memory[${IDX}] = ${_input.variable};
   };
 
   // Set history value in realtime (can be scheduled for later)
-  _history.value = (val: number, time?: Samples, invocation?: number) => {
+  _history.value = (val: number, time?: Samples, invocation?: number, ramp?: Samples) => {
     if (Number.isNaN(val)) {
       return;
     }
+    if (block?.precision === "f64") {
+      // both halves land together; there's no f64 ramp, so a ramp just jumps at time
+      block.initData = encodeF64(val);
+      for (let { context, block } of contextBlocks) {
+        context.baseContext.postMessage({
+          type: "init-memory",
+          body: { idx: block.idx, data: encodeF64(val), time },
+        });
+      }
+      cachedValue = val;
+      return;
+    }
     // Update initData if available
     if (block?.initData && block?.initData[0] !== undefined) {
       block.initData[0] = val;
@@ -474,6 +562,7 @@ memory[${IDX}] = ${_input.variable};
         idx,
         value: val,
         time,
+        ramp,
       };
       context.baseContext.postMessage({
         type: messageType,
@@ -0,0 +1,85 @@
+import type { ZenGraph } from "./zen";
+import { planStateMigration, type StateRange } from "./memory/migrate";
+
+/**
+ * Replacing a running kernel with its recompiled version without resetting it: once the
+ * new kernel is loaded (and its memory initialized), the state of the old one is copied
+ * across (see memory/migrate.ts) and the two are crossfaded, so an edit to a live patch
+ * neither clicks nor restarts its envelopes and delay lines.
+ *
+ * Both worklets read and write memory between process() calls, so the state is taken
+ * and applied on block boundaries. The old kernel runs on for the few blocks the copy
+ * takes, and the crossfade covers that difference.
+ */
+
+export interface RunningKernel {
+  workletNode: AudioWorkletNode;
+  graph: ZenGraph;
+}
+
+export const CROSSFADE_SECONDS = 0.03;
+
+// an old kernel that doesn't answer within this (ms) is faded out without its state
+const STATE_TIMEOUT = 250;
+
+const requestState = (
+  workletNode: AudioWorkletNode,
+  ranges: StateRange[],
+): Promise<Float32Array | undefined> =>
+  new Promise((resolve) => {
+    const onMessage = (e: MessageEvent) => {
+      if (e.data.type === "state-get") {
+        done(e.data.body as Float32Array);
+      }
+    };
+    const timeout = setTimeout(() => done(undefined), STATE_TIMEOUT);
+    const done = (state: Float32Array | undefined) => {
+      clearTimeout(timeout);
+      workletNode.port.removeEventListener("message", onMessage);
+      resolve(state);
+    };
+    workletNode.port.addEventListener("message", onMessage);
+    workletNode.port.postMessage({ type: "state-get", body: ranges });
+  });
+
+/**
+ * Starts next (which must have loaded, but not been sent "ready") in place of previous,
+ * the last of which hands its state over. Resolves once previous have faded out and can
+ * be disposed.
+ */
+export const hotSwap = async (
+  previous: RunningKernel[],
+  next: RunningKernel,
+  fadeSeconds = CROSSFADE_SECONDS,
+): Promise<void> => {
+  const samples = Math.round(fadeSeconds * next.workletNode.context.sampleRate);
+  const running = previous.filter((x) => !x.graph.context.disposed);
+  const source = running[running.length - 1];
+
+  if (source && source.graph.context.target === next.graph.context.target) {
+    const ranges = planStateMigration(source.graph.context, next.graph.context);
+    const state = ranges.length > 0 ? await requestState(source.workletNode, ranges) : undefined;
+    if (state) {
+      next.workletNode.port.postMessage(
+        {
+          type: "state-set",
+          body: { ranges, state },
+        },
+        [state.buffer],
+      );
+    }
+  }
+
+  if (running.length > 0) {
+    next.workletNode.port.postMessage({ type: "fade", body: { from: 0, to: 1, samples } });
+  }
+  next.workletNode.port.postMessage({ type: "ready" });
+  for (const { workletNode } of running) {
+    workletNode.port.postMessage({ type: "fade", body: { to: 0, samples } });
+  }
+
+  if (running.length > 0) {
+    // a couple of blocks on top of the fade, for the messages to arrive
+    await new Promise((resolve) => setTimeout(resolve, fadeSeconds * 1000 + 20));
+  }
+};
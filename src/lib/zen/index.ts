@@ -9,6 +9,7 @@ export * from "./click";
 export * from "./filters/onepole";
 export * from "./filters/biquad";
 export * from "./filters/svf";
+export * from "./filters/bank";
 export * from "./break";
 export * from "./compressor";
 export * from "./functions";
@@ -34,6 +35,7 @@ export * from "./t60";
 export * from "./triangle";
 export * from "./unit";
 export * from "./utils";
+export type { MathPrecision } from "./vectorMath";
 export * from "./selector";
 export { createWorklet } from "./worklet";
 export * from "./zen";
@@ -10,13 +10,11 @@ export const latch = (value: Arg, hold: Arg = 0): UGen => {
   return simdMemo(
     (context: Context, _value: Generated, _hold: Generated): Generated => {
       let [latchVal] = context.useCachedVariables(id, "latchVal");
-      let block: MemoryBlock = context.alloc(1);
+      let block: MemoryBlock = context.alloc(1, id);
 
-      let code = `${context.varKeyword} ${latchVal} = memory[${block.idx}];
-if (${_hold.variable} > 0) {
-  memory[${block.idx}] = ${_value.variable};
-  ${latchVal} = memory[${block.idx}];
-}`;
+      // a select rather than a branch: the hold is usually a trigger, taken once in a while
+      let code = `${context.varKeyword} ${latchVal} = ${_hold.variable} > 0 ? ${_value.variable} : memory[${block.idx}];
+memory[${block.idx}] = ${latchVal};`;
 
       return context.emit(code, latchVal, _value, _hold);
     },
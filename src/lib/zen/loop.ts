@@ -59,6 +59,9 @@ export const sumLoop = (range: Range, body: LoopBody): UGen => {
     const _variable = variable(i);
 
     const _body = body(_variable)(loopContext);
+    if (loopContext instanceof LoopContext) {
+      loopContext.releaseArena();
+    }
 
     const blocks = determineBlocks(..._body.codeFragments);
     const blockWeWant = blocks.find((x) => x.context === loopContext);
@@ -138,6 +141,9 @@ export const rawSumLoop = (range: Range, body: UGen, i: string): UGen => {
     //let _variable = variable(i);
 
     let _body = body(loopContext);
+    if (loopContext instanceof LoopContext) {
+      loopContext.releaseArena();
+    }
     let histories = Array.from(new Set(_body.histories));
     histories = histories.map((x) => replaceAll(x, "let", context.varKeyword) + ";");
     let outerHistories = Array.from(new Set(_body.outerHistories)).filter(
@@ -5,7 +5,7 @@ import { zswitch } from "./switch";
 import { uuid } from "./uuid";
 import { Context } from "./context";
 import { zen_let } from "./let";
-import { simdOp, simdFunc } from "./simdMath";
+import { simdOp, simdFunc, isBlockRate } from "./simdMath";
 
 export const op = (
   operator: string,
@@ -97,6 +97,7 @@ export const cKeywords: Keywords = {
   "Math.tan": "tan",
   "Math.cos": "cos",
   "Math.tanh": "tanh",
+  "Math.log": "log",
   "Math.log2": "(1.0f / log(2)) * log", // C does not have a direct log2 function
   "Math.log10": "log10",
   "Math.pow": "pow",
@@ -126,6 +127,14 @@ export const func = (func: string, name: string, jsFunc?: (...x: number[]) => nu
             : `${context.varKeyword} ${opVar} = ${_func}(${_ins.map((x) => x.variable).join(",")});`;
         let y = context.emit(code, opVar, ..._ins);
         y.scalar = scalar;
+        if (
+          scalar === undefined &&
+          context.target === Target.C &&
+          _ins.every(isBlockRate) &&
+          _ins.some((x) => x.uniform !== undefined)
+        ) {
+          y.uniform = `${_func}(${_ins.map((x) => x.uniform ?? x.scalar).join(", ")})`;
+        }
         return y;
       },
       undefined,
@@ -155,16 +164,16 @@ export const mod = simdOp("%", "mod", (a, b) => a % b);
 export const abs = simdFunc("Math.abs", "abs", Math.abs);
 export const floor = simdFunc("Math.floor", "floor", Math.floor);
 export const ceil = simdFunc("Math.ceil", "ceil", Math.ceil);
-export const sin = func("Math.sin", "sin", Math.sin);
+export const sin = simdFunc("Math.sin", "sin", Math.sin);
 export const tan = func("Math.tan", "tan", Math.tan);
-export const cos = func("Math.cos", "cos", Math.cos);
-export const tanh = func("Math.tanh", "tanh", Math.tanh);
-export const log = func("Math.log", "log", Math.log);
-export const log2 = func("Math.log2", "log2", Math.log2);
-export const log10 = func("Math.log10", "log10", Math.log10);
-export const pow = func("Math.pow", "pow", Math.pow);
+export const cos = simdFunc("Math.cos", "cos", Math.cos);
+export const tanh = simdFunc("Math.tanh", "tanh", Math.tanh);
+export const log = simdFunc("Math.log", "log", Math.log);
+export const log2 = simdFunc("Math.log2", "log2", Math.log2);
+export const log10 = simdFunc("Math.log10", "log10", Math.log10);
+export const pow = simdFunc("Math.pow", "pow", Math.pow);
 export const atan = func("Math.atan", "atan", Math.atan);
-export const exp = func("Math.exp", "exp", Math.exp);
+export const exp = simdFunc("Math.exp", "exp", Math.exp);
 export const sqrt = simdFunc("Math.sqrt", "sqrt", Math.sqrt);
 export const min = simdFunc("Math.min", "min", Math.min);
 export const max = simdFunc("Math.max", "max", Math.max);
@@ -197,7 +197,10 @@ export const simdMemo = (scalarGen: PartialUGen, simdGen?: SIMDUGen, ...args: Ar
   };
 
   const emit = (context: Context, result: Generated): Generated => {
-    //result.codeFragments[0].code += ` /* id: ${id} */ `;
+    if (context.profile && result.codeFragments[0].code !== "") {
+      // lets a profiled block tell which UGens (and so which patch nodes) it holds
+      result.codeFragments[0].code += `\n/* id: ${id} */`;
+    }
     result.codeFragments[0].id = id;
 
     if (memoized) {
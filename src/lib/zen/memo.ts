@@ -198,6 +198,7 @@ export const mergeMemoized = (
   (_memoized as Generated).context = newContext;
   (_memoized as Generated).histories = result.histories;
   (_memoized as Generated).outputHistories = result.outputHistories;
+  (_memoized as Generated).uniform = result.uniform;
   (_memoized as Generated).codeFragments[0].contexts = undefined;
   return _memoized;
 };
@@ -3,9 +3,40 @@ import { MemoryBlock } from "./block";
 
 type BlockList = MemoryBlock[];
 
+// slots (per invocation) reserved at a time for a loop/function's state
+const ARENA_CHUNK = 16;
+
+// the heap is split in two: per-sample state (histories, params, function arenas) is packed
+// into the front, and anything at least BUFFER_THRESHOLD long is treated as a sample buffer
+// and goes after STATE_REGION, so state stays in a few cache lines no matter how many
+// seconds of delay/data() the patch allocates. state only spills past the region if it's full
+const STATE_REGION = 4096;
+const BUFFER_THRESHOLD = 1024;
+
+/**
+ * A region of the heap owned by one loop/function context. Everything the body allocates
+ * is packed in here, field by field with every invocation of a field next to each other
+ * (A + size*invocation), instead of being interleaved with whatever else gets allocated
+ * while the body is evaluated (e.g. a multi-megabyte data() buffer).
+ */
+export class Arena {
+  idx: number;
+  size: number;
+  used: number;
+  // the unused end of the arena, while it sits in the free list
+  tail?: MemoryBlock;
+
+  constructor() {
+    this.idx = 0;
+    this.size = 0;
+    this.used = 0;
+  }
+}
+
 export class Memory {
   size: number;
   freeList: BlockList;
+  bufferList: BlockList;
   references: number;
   blocksInUse: MemoryBlock[];
   context: Context;
@@ -16,19 +47,22 @@ export class Memory {
     this.references = 0;
     this.blocksInUse = [];
 
-    // start with a free list of size of the entire heap
-    this.freeList = [new MemoryBlock(context, 0, size, 0)];
+    // start with a free list for the state region and one for the rest of the heap
+    this.freeList = [new MemoryBlock(context, 0, STATE_REGION, 0)];
+    this.bufferList = [new MemoryBlock(context, STATE_REGION, size - STATE_REGION, 0)];
   }
 
   alloc(size: number): MemoryBlock {
-    const idx = 0;
-    for (let i = 0; i < this.freeList.length; i++) {
-      let block: MemoryBlock = this.freeList[i];
-      if (size <= block.size) {
-        block = this.useBlock(block, size, i);
-        block.allocatedSize = size;
-        this.blocksInUse.push(block);
-        return block;
+    const lists = size >= BUFFER_THRESHOLD ? [this.bufferList] : [this.freeList, this.bufferList];
+    for (const list of lists) {
+      for (let i = 0; i < list.length; i++) {
+        let block: MemoryBlock = list[i];
+        if (size <= block.size) {
+          block = this.useBlock(block, size, i, list);
+          block.allocatedSize = size;
+          this.blocksInUse.push(block);
+          return block;
+        }
       }
     }
 
@@ -36,21 +70,71 @@ export class Memory {
     return this.alloc(size);
   }
 
+  allocInArena(arena: Arena, size: number, loopSize: number): MemoryBlock {
+    const chunk = ARENA_CHUNK * loopSize;
+    if (size > chunk) {
+      // buffers (e.g. a data() per invocation) would just push the rest of the state apart
+      return this.alloc(size);
+    }
+    if (arena.used + size > arena.size && arena.tail) {
+      // state allocated after the body was generated: take the released tail back if
+      // nothing else has started using it
+      const i = this.freeList.indexOf(arena.tail);
+      const adjacent = arena.tail.idx === arena.idx + arena.used;
+      if (i >= 0 && adjacent && arena.tail.size >= size) {
+        this.freeList.splice(i, 1);
+        arena.size += arena.tail.size;
+      }
+      arena.tail = undefined;
+    }
+    if (arena.used + size > arena.size) {
+      this.releaseArena(arena);
+      const region = this.alloc(chunk);
+      this.blocksInUse.pop();
+      arena.idx = region.idx as number;
+      arena.size = chunk;
+      arena.used = 0;
+    }
+    const block = new MemoryBlock(this.context, arena.idx + arena.used, size, size);
+    arena.used += size;
+    this.blocksInUse.push(block);
+    return block;
+  }
+
+  // hands the unused tail of an arena back, so later small allocations fill it in
+  releaseArena(arena: Arena) {
+    if (arena.size > arena.used) {
+      arena.tail = new MemoryBlock(
+        this.context,
+        arena.idx + arena.used,
+        arena.size - arena.used,
+        0,
+      );
+      this.freeList.unshift(arena.tail);
+      arena.size = arena.used;
+    }
+  }
+
   increaseHeapSize() {
     this.size *= 2;
-    const lastBlock = this.freeList[this.freeList.length - 1];
+    const lastBlock = this.bufferList[this.bufferList.length - 1];
     lastBlock.size = this.size - lastBlock.allocatedSize;
   }
 
-  useBlock(block: MemoryBlock, size: number, freeIdx: number): MemoryBlock {
+  useBlock(
+    block: MemoryBlock,
+    size: number,
+    freeIdx: number,
+    list: BlockList = this.freeList,
+  ): MemoryBlock {
     if (block.size === size) {
       // we have a perfect match so remove entirely from
       // free list
-      this.freeList.splice(freeIdx, 1);
+      list.splice(freeIdx, 1);
     } else {
       // we have an unperfect match, so create a new block with
       // the size subtracted out and the idx shifted over
-      this.freeList.splice(
+      list.splice(
         freeIdx,
         1,
         new MemoryBlock(this.context, (block.idx as number) + size, block.size - size, size),
@@ -0,0 +1,129 @@
+import type { Context } from "../context";
+
+// events the ring holds (power of 2); a full ring leaves events queued in the worklet
+export const EVENT_RING_SIZE = 1024;
+
+// ints per ZenEvent: slot, offset, value (as float), ramp
+export const EVENT_STRIDE = 4;
+
+/**
+ * Prints the kernel side of scheduled param changes.
+ *
+ * The worklet is the only producer and process() the only consumer of zen_event_ring, so
+ * it needs no locks: the worklet writes an event into the slot at `write`, then publishes
+ * it by advancing `write`; process() applies everything up to `write` at the start of
+ * each block and advances `read`. Each event sets memory[slot] at a sample offset in the
+ * coming block, optionally as a linear ramp over `ramp` samples.
+ *
+ * Params created with automated=true get a lane: a BLOCK_SIZE array holding the param's
+ * value for every sample of the block, rendered here from the events and the ramp in
+ * progress, and read by the generated code with zen_automation[lane][j]. Anything else
+ * an event targets is set once, at the start of the block.
+ */
+export const printAutomation = (context: Context): string => {
+  const slots = context.automationLanes;
+  const lanes = Math.max(1, slots.length);
+  return `
+#define ZEN_EVENT_RING ${EVENT_RING_SIZE}
+#define ZEN_LANES ${lanes}
+#define ZEN_LANE(lane, idx) memory[idx]
+
+struct ZenEvent {
+    int slot;
+    int offset;
+    float value;
+    int ramp;
+};
+
+struct ZenEventRing {
+    volatile unsigned int write;
+    volatile unsigned int read;
+    struct ZenEvent events[ZEN_EVENT_RING];
+};
+
+struct ZenEventRing zen_event_ring;
+
+EMSCRIPTEN_KEEPALIVE
+struct ZenEventRing *get_event_ring() {
+    return &zen_event_ring;
+}
+
+float zen_automation[ZEN_LANES][BLOCK_SIZE] __attribute__((aligned(SIMD_ALIGN)));
+int zen_lane_slot[ZEN_LANES] = {${slots.length ? slots.join(", ") : "-1"}};
+float zen_lane_step[ZEN_LANES];
+float zen_lane_target[ZEN_LANES];
+int zen_lane_left[ZEN_LANES];
+int zen_lane_rendered[ZEN_LANES];
+// a lane that isn't ramping and had no events already holds memory[slot] in every sample
+int zen_lane_constant[ZEN_LANES];
+float zen_lane_value[ZEN_LANES];
+
+static inline int zen_lane_of(int slot) {
+    for (int lane = 0; lane < ${slots.length}; lane++) {
+        if (zen_lane_slot[lane] == slot) {
+            return lane;
+        }
+    }
+    return -1;
+}
+
+// fills the lane up to (not including) sample "to", continuing any ramp
+static void zen_render_lane(int lane, int to) {
+    int slot = zen_lane_slot[lane];
+    float value = memory[slot];
+    for (int j = zen_lane_rendered[lane]; j < to; j++) {
+        if (zen_lane_left[lane] > 0) {
+            value += zen_lane_step[lane];
+            if (--zen_lane_left[lane] == 0) {
+                value = zen_lane_target[lane];
+            }
+        }
+        zen_automation[lane][j] = value;
+    }
+    memory[slot] = value;
+    if (to > zen_lane_rendered[lane]) {
+        zen_lane_rendered[lane] = to;
+    }
+}
+
+static void zen_render_automation() {
+    for (int lane = 0; lane < ${slots.length}; lane++) {
+        zen_lane_rendered[lane] = 0;
+    }
+
+    unsigned int read = zen_event_ring.read;
+    unsigned int write = __atomic_load_n(&zen_event_ring.write, __ATOMIC_ACQUIRE);
+    for (; read != write; read++) {
+        struct ZenEvent event = zen_event_ring.events[read & (ZEN_EVENT_RING - 1)];
+        int lane = zen_lane_of(event.slot);
+        if (lane < 0) {
+            memory[event.slot] = event.value;
+            continue;
+        }
+        int offset = event.offset < 0 ? 0 : event.offset >= BLOCK_SIZE ? BLOCK_SIZE - 1 : event.offset;
+        zen_render_lane(lane, offset);
+        if (event.ramp > 0) {
+            zen_lane_step[lane] = (event.value - memory[zen_lane_slot[lane]]) / event.ramp;
+            zen_lane_target[lane] = event.value;
+            zen_lane_left[lane] = event.ramp;
+        } else {
+            memory[zen_lane_slot[lane]] = event.value;
+            zen_lane_left[lane] = 0;
+        }
+        zen_lane_constant[lane] = 0;
+    }
+    __atomic_store_n(&zen_event_ring.read, read, __ATOMIC_RELEASE);
+
+    for (int lane = 0; lane < ${slots.length}; lane++) {
+        int slot = zen_lane_slot[lane];
+        if (zen_lane_constant[lane] && zen_lane_value[lane] == memory[slot]) {
+            continue;
+        }
+        int changed = zen_lane_rendered[lane] > 0 || zen_lane_left[lane] > 0;
+        zen_render_lane(lane, BLOCK_SIZE);
+        zen_lane_constant[lane] = !changed;
+        zen_lane_value[lane] = memory[slot];
+    }
+}
+`;
+};
@@ -0,0 +1,142 @@
+// messages the ring holds (power of 2)
+export const MESSAGE_RING_SIZE = 4096;
+
+// (type, subType) pairs tracked for coalescing (power of 2)
+export const MESSAGE_COALESCE = 256;
+
+// header: write, read, dropped, capacity, wanted (uint32 each)
+export const MESSAGE_HEADER_BYTES = 20;
+
+// the header field the consumer sets to have the pending messages published
+export const MESSAGE_WANTED = 4;
+
+// struct Message: int type, float subType, float body, float currentTime
+export const MESSAGE_BYTES = 16;
+
+export interface ZenMessage {
+  type: string;
+  subType: number;
+  body: number;
+  time: number;
+}
+
+/**
+ * Prints the kernel side of messages (meters, scopes, message()): a single-producer/
+ * single-consumer ring. process() is the only writer of `write`, the worklet (which copies
+ * the records out for the worker, see createWorkletCode.ts) the only writer of `read`.
+ *
+ * Messages are written past `write` and only published (`write` advanced) at the end of a
+ * process() call after the consumer has asked for them by setting `wanted`. Until then the
+ * consumer can't see them, so a message whose (type, subType) already has an unpublished
+ * message overwrites it in place: consumers only care about the latest value, and a meter
+ * emitting every block takes one slot between two drains. A published record is never
+ * written again until it has been read. When the ring is full new messages are counted in
+ * `dropped` instead of overwriting unread ones.
+ */
+export const printMessageRing = (): string => `
+#define MAX_MESSAGES ${MESSAGE_RING_SIZE}
+#define MESSAGE_COALESCE ${MESSAGE_COALESCE}
+
+struct Message {
+   int type;
+   float subType;
+   float body;
+   float currentTime;
+};
+
+struct MessageRing {
+   volatile unsigned int write;
+   volatile unsigned int read;
+   volatile unsigned int dropped;
+   unsigned int capacity;
+   volatile unsigned int wanted;
+   struct Message messages[MAX_MESSAGES];
+};
+
+struct MessageRing message_ring = { .capacity = MAX_MESSAGES };
+
+// where the next message goes: [write, message_next) is written but unpublished
+unsigned int message_next = 0;
+
+// where in the ring the latest message of a (type, subType) was written
+struct MessageSlot {
+   int type;
+   float subType;
+   unsigned int position;
+};
+
+struct MessageSlot message_slots[MESSAGE_COALESCE];
+
+void new_message(int type, float subType, float body, float currentTime) {
+   // only process() advances write, so it can't move under us
+   unsigned int write = message_ring.write;
+   struct MessageSlot *slot =
+       &message_slots[((unsigned int)type * 31u + (unsigned int)(int)subType) & (MESSAGE_COALESCE - 1)];
+   if (slot->type == type && slot->subType == subType && slot->position - write < message_next - write) {
+      struct Message *pending = &message_ring.messages[slot->position & (MAX_MESSAGES - 1)];
+      pending->body = body;
+      pending->currentTime = currentTime;
+      return;
+   }
+   unsigned int read = __atomic_load_n(&message_ring.read, __ATOMIC_ACQUIRE);
+   if (message_next - read >= MAX_MESSAGES) {
+      message_ring.dropped++;
+      return;
+   }
+   struct Message *message = &message_ring.messages[message_next & (MAX_MESSAGES - 1)];
+   message->type = type;
+   message->subType = subType;
+   message->body = body;
+   message->currentTime = currentTime;
+   slot->type = type;
+   slot->subType = subType;
+   slot->position = message_next++;
+}
+
+// the end of process(): hands over the pending messages if the consumer asked for them
+static inline void publish_messages(void) {
+   if (message_next != message_ring.write && __atomic_exchange_n(&message_ring.wanted, 0, __ATOMIC_ACQUIRE)) {
+      __atomic_store_n(&message_ring.write, message_next, __ATOMIC_RELEASE);
+   }
+}
+
+EMSCRIPTEN_KEEPALIVE
+struct MessageRing *get_message_ring() {
+   return &message_ring;
+}
+`;
+
+const decode = (
+  buffer: ArrayBufferLike,
+  byteOffset: number,
+  capacity: number,
+  from: number,
+  count: number,
+  keys: string[],
+  onMessage: (message: ZenMessage) => void,
+) => {
+  const ints = new Int32Array(buffer, byteOffset, capacity * 4);
+  const floats = new Float32Array(buffer, byteOffset, capacity * 4);
+  for (let i = 0; i < count; i++) {
+    const k = ((from + i) % capacity) * 4;
+    onMessage({
+      type: keys[ints[k] - 1],
+      subType: floats[k + 1],
+      body: floats[k + 2],
+      time: floats[k + 3],
+    });
+  }
+};
+
+/**
+ * Decodes a batch the worklet copied out of the ring: the raw struct Message records, back
+ * to back.
+ */
+export const decodeMessageBatch = (
+  batch: ArrayBuffer,
+  keys: string[],
+  onMessage: (message: ZenMessage) => void,
+) => {
+  const count = batch.byteLength / MESSAGE_BYTES;
+  decode(batch, 0, count, 0, count, keys, onMessage);
+};
@@ -0,0 +1,100 @@
+import type { Context } from "../context";
+import type { MemoryBlock } from "../block";
+import { LoopMemoryBlock } from "../block";
+import { F64_CELLS } from "../precision";
+
+/**
+ * Carrying state (histories, accumulators, delay lines, filter memory) from a running
+ * kernel into its recompiled replacement, so editing a patch doesn't reset every phasor
+ * and flush every delay line.
+ *
+ * Variable names and heap positions both depend on everything allocated before a block,
+ * so a block is matched by what allocated it instead (its owner, recorded at alloc): the
+ * patch node whose UGen allocated it, or failing that a history's debug name, along with
+ * its place among the blocks of that owner. Inserting, deleting or reordering nodes only
+ * changes where each node's state lives, which is what the migration copies.
+ *
+ * A block only takes state from a block with the same identity and shape (size, precision,
+ * per-invocation or not). Anything else, and any block with no owner (UGens built outside
+ * a patch, without a debug name), starts from its initial value.
+ *
+ * Params are left out (their values are sent again once the new kernel is ready), and so
+ * are data() buffers with contents, which come from the patch rather than from running it.
+ */
+
+export interface StateRange {
+  // position in the old kernel's memory
+  from: number;
+  // position in the new kernel's memory
+  to: number;
+  size: number;
+}
+
+const isState = (block: MemoryBlock) =>
+  block.name === undefined &&
+  block.allocatedSize > 0 &&
+  (block.initData === undefined ||
+    block.initData.length <= 1 ||
+    (block.precision === "f64" && block.initData.length === F64_CELLS));
+
+const positionOf = (block: MemoryBlock) =>
+  (block._idx === undefined ? block.idx : block._idx) as number;
+
+const shapeOf = (block: MemoryBlock) =>
+  [block instanceof LoopMemoryBlock ? "loop" : "", block.precision || "f32", block.allocatedSize]
+    .filter((x) => x !== "")
+    .join(" ");
+
+// each block with an owner by its identity: owner, place among the owner's blocks, shape
+const identities = (blocks: MemoryBlock[]): Map<string, MemoryBlock> => {
+  const counts = new Map<string, number>();
+  const identified = new Map<string, MemoryBlock>();
+  for (const block of blocks) {
+    if (block.owner === undefined) {
+      continue;
+    }
+    const k = counts.get(block.owner) || 0;
+    counts.set(block.owner, k + 1);
+    identified.set(`${block.owner} #${k} ${shapeOf(block)}`, block);
+  }
+  return identified;
+};
+
+// (some UGens register the same block more than once)
+const stateBlocks = (context: Context) => {
+  const positions = new Set<number>();
+  return context.memory.blocksInUse.filter((block) => {
+    const position = positionOf(block);
+    if (!isState(block) || typeof position !== "number" || positions.has(position)) {
+      return false;
+    }
+    positions.add(position);
+    return true;
+  });
+};
+
+/**
+ * The ranges of memory to copy from the kernel compiled for previous to the one compiled
+ * for next, with neighbouring ranges merged (state allocated together usually stays
+ * together, so most patches migrate in a handful of copies).
+ */
+export const planStateMigration = (previous: Context, next: Context): StateRange[] => {
+  const before = identities(stateBlocks(previous));
+  const ranges: StateRange[] = [];
+  identities(stateBlocks(next)).forEach((block, identity) => {
+    const match = before.get(identity);
+    if (!match) {
+      return;
+    }
+    const from = positionOf(match);
+    const to = positionOf(block);
+    const size = block.allocatedSize;
+    const last = ranges[ranges.length - 1];
+    if (last && last.from + last.size === from && last.to + last.size === to) {
+      last.size += size;
+    } else {
+      ranges.push({ from, to, size });
+    }
+  });
+  return ranges;
+};
@@ -0,0 +1,203 @@
+import { Target } from "../targets";
+
+// histogram buckets per section: two per octave of nanoseconds, from 1ns to 2^32ns
+export const PROFILE_BUCKETS = 64;
+
+// uint32s per section: count, min, max, total (low, high word), then the buckets
+export const PROFILE_STRIDE = 5 + PROFILE_BUCKETS;
+
+/**
+ * One timed region of process(): a block, one function call, or (appended by the
+ * worklet itself) the message flush.
+ */
+export interface ProfileSection {
+  label: string;
+  // the zen ids (see memo-simd.ts) of the UGens printed into it
+  ugens: number[];
+}
+
+export interface SectionTiming {
+  label: string;
+  // the patch nodes whose code the section runs
+  nodeIds: string[];
+  count: number;
+  // nanoseconds per run
+  min: number;
+  avg: number;
+  p99: number;
+  max: number;
+  // share of all the time measured
+  share: number;
+}
+
+/**
+ * Prints the kernel side of profiling builds (graphs compiled with profile set): each
+ * section of process() is bracketed by zen_clock() reads, and its duration folded into
+ * zen_profile[section], which the worklet copies out whenever it flushes messages.
+ *
+ * Natively the clock is CLOCK_MONOTONIC. In wasm it's imported from the worklet, which
+ * has performance.now() at best, coarsened to 5us or more by the browser, so short
+ * blocks mostly land in the first buckets: their averages over many runs are still
+ * meaningful, their minimums aren't.
+ */
+export const printProfiler = (sections: ProfileSection[], target: Target): string => `
+#include <stdint.h>
+#define ZEN_PROFILE_SECTIONS ${Math.max(1, sections.length)}
+#define ZEN_PROFILE_BUCKETS ${PROFILE_BUCKETS}
+#define ZEN_PROFILE_STRIDE ${PROFILE_STRIDE}
+${
+  target === Target.NativeC
+    ? `#include <time.h>
+static inline uint32_t zen_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}`
+    : `// nanoseconds, wrapping (provided by the worklet)
+extern uint32_t zen_clock(void);`
+}
+
+uint32_t zen_profile[ZEN_PROFILE_SECTIONS][ZEN_PROFILE_STRIDE];
+
+EMSCRIPTEN_KEEPALIVE
+uint32_t *get_profile(void) {
+    return &zen_profile[0][0];
+}
+
+EMSCRIPTEN_KEEPALIVE
+int get_profile_sections(void) {
+    return ZEN_PROFILE_SECTIONS;
+}
+
+static inline void zen_profile_record(int section, uint32_t start) {
+    uint32_t t = zen_clock() - start;
+    uint32_t *slot = zen_profile[section];
+    if (slot[0]++ == 0 || t < slot[1]) slot[1] = t;
+    if (t > slot[2]) slot[2] = t;
+    uint32_t low = slot[3] + t;
+    slot[4] += low < t;
+    slot[3] = low;
+    int octave = 31 - __builtin_clz(t | 1);
+    slot[5 + (octave == 0 ? 0 : 2 * octave + ((t >> (octave - 1)) & 1))]++;
+}
+`;
+
+/**
+ * Brackets code with the timing of a section.
+ */
+export const printProfiled = (section: number, code: string): string => `{
+uint32_t zen_profile_start = zen_clock();
+${code}
+zen_profile_record(${section}, zen_profile_start);
+}`;
+
+// the lower bound (ns) of a bucket: 2^octave, or 1.5 * 2^octave for the upper half
+const bucketStart = (bucket: number) => {
+  if (bucket < 2) {
+    return bucket;
+  }
+  const octave = bucket >> 1;
+  return (bucket & 1 ? 1.5 : 1) * 2 ** octave;
+};
+
+const owners: { first: number; end: number; nodeId: string }[] = [];
+// ranges kept for UGens of graphs that may still be profiled
+const MAX_OWNERS = 100000;
+
+/**
+ * Records that the UGens with zen ids in [first, end) were created for the patch node
+ * nodeId, so profiled sections can be reported against the nodes they came from, and
+ * state can follow its node from one compile to the next (see memory/migrate.ts).
+ */
+export const attributeUGens = (first: number, end: number, nodeId: string) => {
+  if (end <= first) {
+    return;
+  }
+  owners.push({ first, end, nodeId });
+  if (owners.length > MAX_OWNERS) {
+    owners.splice(0, owners.length - MAX_OWNERS);
+  }
+};
+
+export const ownerOf = (ugen: number): string | undefined => {
+  // ids only grow, so owners is sorted by first
+  let low = 0;
+  let high = owners.length - 1;
+  while (low <= high) {
+    const mid = (low + high) >> 1;
+    if (owners[mid].end <= ugen) {
+      low = mid + 1;
+    } else if (owners[mid].first > ugen) {
+      high = mid - 1;
+    } else {
+      return owners[mid].nodeId;
+    }
+  }
+  return undefined;
+};
+
+/**
+ * Min/avg/p99/max of each section, from the counters the worklet reports (one
+ * PROFILE_STRIDE row per section, in the order of sections).
+ */
+export const summarizeProfile = (
+  data: Uint32Array,
+  sections: ProfileSection[],
+): SectionTiming[] => {
+  const timings: SectionTiming[] = [];
+  let all = 0;
+  for (let i = 0; i < sections.length && (i + 1) * PROFILE_STRIDE <= data.length; i++) {
+    const row = data.subarray(i * PROFILE_STRIDE, (i + 1) * PROFILE_STRIDE);
+    const count = row[0];
+    const total = row[3] + row[4] * 2 ** 32;
+    all += total;
+    let p99 = 0;
+    for (let bucket = 0, seen = 0; bucket < PROFILE_BUCKETS; bucket++) {
+      seen += row[5 + bucket];
+      if (seen >= count * 0.99) {
+        p99 = bucketStart(bucket + 1);
+        break;
+      }
+    }
+    timings.push({
+      label: sections[i].label,
+      nodeIds: Array.from(
+        new Set(sections[i].ugens.map(ownerOf).filter((x): x is string => x !== undefined)),
+      ),
+      count,
+      min: count ? row[1] : 0,
+      avg: count ? total / count : 0,
+      p99: Math.min(p99, row[2]),
+      max: row[2],
+      share: total,
+    });
+  }
+  for (const timing of timings) {
+    timing.share = all ? timing.share / all : 0;
+  }
+  return timings;
+};
+
+const reports = new Map<string, { timings: SectionTiming[]; time: number }>();
+// a kernel that hasn't reported for this long (ms) has been disposed
+const STALE = 5000;
+
+export const reportProfile = (kernel: string, data: Uint32Array, sections: ProfileSection[]) => {
+  reports.set(kernel, { timings: summarizeProfile(data, sections), time: Date.now() });
+};
+
+/**
+ * The sections of every running profiled kernel, most expensive (by total time) first.
+ */
+export const getProfiles = (): (SectionTiming & { kernel: string })[] => {
+  const now = Date.now();
+  const timings: (SectionTiming & { kernel: string })[] = [];
+  for (const [kernel, report] of Array.from(reports)) {
+    if (now - report.time > STALE) {
+      reports.delete(kernel);
+      continue;
+    }
+    timings.push(...report.timings.map((x) => ({ ...x, kernel })));
+  }
+  return timings.sort((a, b) => b.avg * b.count - a.avg * a.count);
+};
@@ -1,29 +1,122 @@
 import type { LoopContext, Context, Arg, Generated } from "./index";
 import { simdMemo } from "./memo-simd";
 import { uuid } from "./uuid";
-import { memo } from "./memo";
+import { memo, getParentContexts } from "./memo";
+import type { MemoryBlock } from "./block";
 import { Target } from "./targets";
 
-export const message = (name: string, subType: Arg, value: Arg) => {
+/**
+ * How often a message() reports its value:
+ * - block: once per block, with the value of the block's last sample
+ * - samples: every N samples (at block granularity: anything under a block is per-block)
+ * - change: once per block, only if the value moved more than threshold since it was last sent
+ */
+export type MessageRate =
+  | { kind: "block" }
+  | { kind: "samples"; samples: number }
+  | { kind: "change"; threshold: number };
+
+/**
+ * Parses the message node's rate attribute: "block", "samples N" or "change T".
+ */
+export const parseMessageRate = (rate?: string): MessageRate | undefined => {
+  const [kind, amount] = (rate || "").trim().split(/\s+/);
+  const x = parseFloat(amount);
+  if (kind === "samples" && x > 0) {
+    return { kind, samples: x };
+  }
+  if (kind === "change") {
+    return { kind, threshold: x > 0 ? x : 0 };
+  }
+  return kind === "block" ? { kind } : undefined;
+};
+
+// lines printBlock moves out of the sample loop (see hoistPerBlock)
+export const BEFORE_BLOCK = "@beforeBlock ";
+export const AFTER_BLOCK = "@afterBlock ";
+
+// the state slots a message needs: samples since it was last sent, and the last value sent
+const COUNTER = 0;
+const LAST = 1;
+const SENT = 2;
+
+/**
+ * The check (on one line) that sends a message whose latest value is `value`, run every
+ * `elapsed` samples. Intervals that don't divide into `elapsed` keep the remainder in the
+ * counter, so the average rate is still one message per interval.
+ */
+const printRateCheck = (
+  context: Context,
+  state: MemoryBlock | undefined,
+  rate: MessageRate,
+  value: string,
+  elapsed: number,
+  send: string,
+): string => {
+  const slot = (i: number) => `memory[${state!.idx} + ${i}]`;
+  const abs = context.target === Target.C ? "fabs" : "Math.abs";
+  const checks: string[] = [];
+  const updates: string[] = [];
+  const interval = rate.kind === "samples" ? rate.samples : 0;
+  if (state && interval > elapsed) {
+    checks.push(`(${slot(COUNTER)} += ${elapsed}) >= ${interval}`);
+    updates.push(`${slot(COUNTER)} -= ${interval};`);
+  }
+  if (rate.kind === "change") {
+    checks.push(`(!${slot(SENT)} || ${abs}(${value} - ${slot(LAST)}) > ${rate.threshold})`);
+    updates.push(`${slot(LAST)} = ${value}; ${slot(SENT)} = 1;`);
+  }
+  return checks.length
+    ? `if (${checks.join(" && ")}) { ${updates.join(" ")} ${send} }`
+    : `{ ${send} }`;
+};
+
+/**
+ * Sends value to the main thread under name/subType, at the given rate (per-block by
+ * default).
+ *
+ * Inside a sample loop the message only records its latest value: the rate check and the
+ * send are hoisted after the loop by printBlock, so they run once per block. Where there
+ * is no sample loop to hoist out of (scalar functions, the body of a loop()), the check
+ * runs per sample against the message's own sample counter.
+ */
+export const message = (name: string, subType: Arg, value: Arg, rate?: MessageRate) => {
   const id = uuid();
   return simdMemo(
     (context: Context, _value: Generated, _subType: Generated): Generated => {
-      const [vari] = context.useCachedVariables(id, "message");
-      // in a loop this will only catch one of the iterations (the last)
-      // instead we need to have some sort of threshold
-      // or store the messages somewhere
+      const [vari, latch] = context.useCachedVariables(id, "message", "messageLatch");
+      const perSample =
+        context.forceScalar ||
+        [context, ...getParentContexts(context)].some((c) => (c as LoopContext).loopSize);
+      const declared = rate !== undefined;
+      // undeclared, a per-sample message reports at the rate a hoisted one would
+      const _rate: MessageRate =
+        rate || (perSample ? { kind: "samples", samples: context.blockSize } : { kind: "block" });
+      const needsState = perSample || _rate.kind !== "block";
+      const state = needsState ? context.alloc(3, id) : undefined;
+
+      const latchValue = perSample ? _value.variable! : `${latch}_value`;
+      const latchSubType = perSample ? _subType.variable! : `${latch}_subType`;
+      let send =
+        context.target === Target.C
+          ? `new_message(@beginMessage${name}@endMessage, ${latchSubType}, ${latchValue}, 0.0);`
+          : `this.messagePort.postMessage({type: @beginMessage${name}@endMessage, subType: ${latchSubType}, body: ${latchValue}});`;
+      if (context.target === Target.Javascript && !declared) {
+        // the JS worklet throttles undeclared messages with its messageRate attribute
+        send = `if (this.messageCounter % this.messageRate === 0) ${send}`;
+      }
+
       let code = "";
-      if (context.target === Target.C) {
+      if (perSample) {
         code += `
-        if ((message_checker++) % 97 == 0) {
-new_message(@beginMessage${name}@endMessage, ${_subType.variable}, ${_value.variable}, 0.0);
-         }
+${printRateCheck(context, state, _rate, latchValue, 1, send)}
 `;
       } else {
         code += `
-if (this.messageCounter % this.messageRate === 0) {
-this.messagePort.postMessage({type: @beginMessage${name}@endMessage, subType: ${_subType.variable}, body: ${_value.variable}});
-}
+${BEFORE_BLOCK}${context.varKeyword} ${latch}_value = 0, ${latch}_subType = 0;
+${latch}_value = ${_value.variable};
+${latch}_subType = ${_subType.variable};
+${AFTER_BLOCK}${printRateCheck(context, state, _rate, latchValue, context.blockSize, send)}
 `;
       }
       code += `
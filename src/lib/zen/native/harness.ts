@@ -0,0 +1,282 @@
+import type { ZenGraph } from "../zen";
+import type { Context } from "../context";
+import { PROFILE_BUCKETS, PROFILE_STRIDE } from "../memory/profile";
+
+// same cut-off initMemory uses when posting init-memory to the worklet
+const MAX_INIT_DATA = 100000;
+
+const printFloat = (x: number): string => {
+  if (!Number.isFinite(x)) {
+    return "0.0f";
+  }
+  const s = Math.fround(x).toPrecision(9);
+  return s.includes(".") || s.includes("e") ? `${s}f` : `${s}.0f`;
+};
+
+/**
+ * Prints the C equivalent of initMemory(): every block with initData (params, histories
+ * with an initial value, small data() buffers) is copied into memory[] before rendering.
+ */
+export const printNativeMemoryInit = (context: Context): string => {
+  let arrays = "";
+  let body = "";
+  let i = 0;
+  for (const block of new Set(context.memory.blocksInUse)) {
+    if (!block.initData || block.initData.length >= MAX_INIT_DATA) {
+      continue;
+    }
+    const idx = (block._idx === undefined ? block.idx : block._idx) as number;
+    if (block.precision === "f64") {
+      // the halves of an f64 aren't meaningful floats (and may be NaN patterns): copy bits
+      const bits = Array.from(new Uint32Array(block.initData.slice().buffer)).map(
+        (x) => `0x${x.toString(16)}u`,
+      );
+      arrays += `static union { unsigned int bits[${bits.length}]; float values[${bits.length}]; } zen_init_${i} = {{${bits.join(", ")}}};
+`;
+      body += `    initializeMemory(${idx}, zen_init_${i}.values, ${bits.length});
+`;
+      i++;
+      continue;
+    }
+    const values = Array.from(block.initData).map(printFloat);
+    arrays += `static float zen_init_${i}[${values.length}] = {${values.join(", ")}};
+`;
+    body += `    initializeMemory(${idx}, zen_init_${i}, ${values.length});
+`;
+    i++;
+  }
+  return `
+${arrays}
+static void loadInitialMemory(void) {
+${body}}
+`;
+};
+
+/**
+ * Command-line harness linked against a kernel printed with Target.NativeC.
+ * Renders N seconds offline (feeding a 220hz sine into every input) and reports
+ * throughput, so the DSP hot loop can be profiled with perf or compared across
+ * compiler flags outside of the browser.
+ *
+ * Built with -DZEN_DISPATCH the kernel isn't linked in: instead the widest of
+ * zen-kernel-{avx512,avx2,sse}.so (next to the executable) that the CPU supports is
+ * dlopen'd at startup, so one binary can carry kernels printed for several vector widths.
+ *
+ * A kernel printed from a graph compiled with profile set also gets a per-section table
+ * (see memory/profile.ts) printed after the run.
+ *
+ * The output is written as planar raw floats (block after block), or, for a path ending
+ * in .wav, as an interleaved float WAV: a bounce of the patch.
+ *
+ * usage: ./zen-bench [seconds=10] [output.f32|output.wav]
+ */
+export const printNativeHarness = (graph: ZenGraph): string => {
+  const numberOfInputs = Math.max(1, graph.numberOfInputs);
+  const numberOfOutputs = Math.max(1, graph.numberOfOutputs);
+  const sections = graph.context.profileSections;
+  return `
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BLOCK_SIZE ${graph.context.blockSize}
+#define SAMPLE_RATE 44100
+#define NUM_INPUTS ${numberOfInputs}
+#define NUM_OUTPUTS ${numberOfOutputs}
+
+#ifdef ZEN_DISPATCH
+#include <dlfcn.h>
+
+typedef void (*process_fn)(float *inputs, float *outputs, float currentTime);
+typedef void (*init_sine_table_fn)(void);
+typedef void (*initialize_memory_fn)(int idx, float *data, int length);
+typedef int (*simd_width_fn)(void);
+typedef unsigned int *(*get_profile_fn)(void);
+
+static process_fn process;
+static init_sine_table_fn initSineTable;
+static initialize_memory_fn initializeMemory;
+static simd_width_fn zen_simd_width;
+static get_profile_fn get_profile;
+
+static const char *pickKernel(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return "avx512";
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return "avx2";
+    }
+#endif
+    return "sse";
+}
+
+static void loadKernel(const char *self) {
+    char path[4096];
+    const char *slash = strrchr(self, '/');
+    int dir = slash ? (int)(slash - self) : 1;
+    snprintf(path, sizeof(path), "%.*s/zen-kernel-%s.so", dir, slash ? self : ".", pickKernel());
+    void *kernel = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!kernel) {
+        fprintf(stderr, "could not load %s: %s\\n", path, dlerror());
+        exit(1);
+    }
+    process = (process_fn)dlsym(kernel, "process");
+    initSineTable = (init_sine_table_fn)dlsym(kernel, "initSineTable");
+    initializeMemory = (initialize_memory_fn)dlsym(kernel, "initializeMemory");
+    zen_simd_width = (simd_width_fn)dlsym(kernel, "zen_simd_width");
+    get_profile = (get_profile_fn)dlsym(kernel, "get_profile");
+    printf("kernel: %s\\n", path);
+}
+#else
+void process(float *inputs, float *outputs, float currentTime);
+void initSineTable(void);
+void initializeMemory(int idx, float *data, int length);
+int zen_simd_width(void);
+${sections ? "unsigned int *get_profile(void);" : ""}
+
+static void loadKernel(const char *self) {
+    (void)self;
+}
+#endif
+
+${printNativeMemoryInit(graph.context)}
+${sections ? printProfileReport(sections.map((x) => x.label)) : ""}
+
+static float inputs[BLOCK_SIZE * NUM_INPUTS] __attribute__((aligned(64)));
+static float outputs[BLOCK_SIZE * NUM_OUTPUTS] __attribute__((aligned(64)));
+
+/* the RIFF size field is 32 bits and counts the 36 header bytes after it too */
+#define WAV_MAX_DATA (0xFFFFFFFFu - 36)
+
+static void writeWavHeader(FILE *file, long frames) {
+    unsigned int data = (unsigned int)((uint64_t)frames * NUM_OUTPUTS * sizeof(float));
+    unsigned int riff = 36 + data;
+    unsigned int fmtSize = 16;
+    unsigned short format = 3; /* IEEE float */
+    unsigned short channels = NUM_OUTPUTS;
+    unsigned int rate = SAMPLE_RATE;
+    unsigned int byteRate = SAMPLE_RATE * NUM_OUTPUTS * sizeof(float);
+    unsigned short align = NUM_OUTPUTS * sizeof(float);
+    unsigned short bits = 32;
+    fwrite("RIFF", 1, 4, file);
+    fwrite(&riff, 4, 1, file);
+    fwrite("WAVEfmt ", 1, 8, file);
+    fwrite(&fmtSize, 4, 1, file);
+    fwrite(&format, 2, 1, file);
+    fwrite(&channels, 2, 1, file);
+    fwrite(&rate, 4, 1, file);
+    fwrite(&byteRate, 4, 1, file);
+    fwrite(&align, 2, 1, file);
+    fwrite(&bits, 2, 1, file);
+    fwrite("data", 1, 4, file);
+    fwrite(&data, 4, 1, file);
+}
+
+static void writeInterleaved(FILE *file) {
+    static float frame[BLOCK_SIZE * NUM_OUTPUTS];
+    for (int j = 0; j < BLOCK_SIZE; j++) {
+        for (int i = 0; i < NUM_OUTPUTS; i++) {
+            frame[j * NUM_OUTPUTS + i] = outputs[i * BLOCK_SIZE + j];
+        }
+    }
+    fwrite(frame, sizeof(float), BLOCK_SIZE * NUM_OUTPUTS, file);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 10.0;
+    FILE *raw = argc > 2 ? fopen(argv[2], "wb") : NULL;
+    size_t pathLength = argc > 2 ? strlen(argv[2]) : 0;
+    int wav = raw && pathLength > 4 && strcmp(argv[2] + pathLength - 4, ".wav") == 0;
+    long blocks = (long)(seconds * SAMPLE_RATE / BLOCK_SIZE);
+    if (blocks < 1) {
+        blocks = 1;
+    }
+    if (wav && (uint64_t)blocks * BLOCK_SIZE * NUM_OUTPUTS * sizeof(float) > WAV_MAX_DATA) {
+        fprintf(stderr, "%.2fs of %d channels won't fit a WAV (4GB)\\n", seconds, NUM_OUTPUTS);
+        fclose(raw);
+        return 1;
+    }
+    if (wav) {
+        writeWavHeader(raw, blocks * BLOCK_SIZE);
+    }
+
+    loadKernel(argv[0]);
+    printf("simd width: %d\\n", zen_simd_width());
+    initSineTable();
+    loadInitialMemory();
+
+    double checksum = 0.0;
+    double elapsed = 0.0;
+    double worst = 0.0;
+    for (long b = 0; b < blocks; b++) {
+        for (int j = 0; j < BLOCK_SIZE; j++) {
+            float x = sinf(2.0f * (float)M_PI * 220.0f * (float)(b * BLOCK_SIZE + j) / SAMPLE_RATE);
+            for (int i = 0; i < NUM_INPUTS; i++) {
+                inputs[i * BLOCK_SIZE + j] = x;
+            }
+        }
+        double start = now();
+        process(inputs, outputs, (float)(b * BLOCK_SIZE) / SAMPLE_RATE);
+        double took = now() - start;
+        elapsed += took;
+        if (took > worst) {
+            worst = took;
+        }
+        for (int i = 0; i < BLOCK_SIZE * NUM_OUTPUTS; i++) {
+            checksum += outputs[i];
+        }
+        if (wav) {
+            writeInterleaved(raw);
+        } else if (raw) {
+            fwrite(outputs, sizeof(float), BLOCK_SIZE * NUM_OUTPUTS, raw);
+        }
+    }
+    if (raw) {
+        fclose(raw);
+    }
+
+    double samples = (double)blocks * BLOCK_SIZE;
+    printf("rendered %.2fs (%ld blocks) in %.4fs\\n", samples / SAMPLE_RATE, blocks, elapsed);
+    printf("samples/sec: %.0f (%.1fx realtime)\\n", samples / elapsed, samples / SAMPLE_RATE / elapsed);
+    printf("ns/block: %.1f avg, %.1f worst (budget %.1f)\\n", elapsed * 1e9 / blocks, worst * 1e9,
+           1e9 * BLOCK_SIZE / SAMPLE_RATE);
+    printf("checksum: %.6f\\n", checksum);
+    ${sections ? "printProfile();" : ""}
+    return 0;
+}
+`;
+};
+
+const printProfileReport = (labels: string[]) => `
+static const char *profile_labels[${Math.max(1, labels.length)}] = {${labels.map((x) => JSON.stringify(x)).join(", ")}};
+
+static void printProfile(void) {
+    unsigned int *profile = get_profile();
+    printf("%-24s %10s %10s %10s %10s\\n", "section", "runs", "avg ns", "p99 ns", "max ns");
+    for (int i = 0; i < ${labels.length}; i++) {
+        unsigned int *row = profile + i * ${PROFILE_STRIDE};
+        unsigned long long total = row[3] + ((unsigned long long)row[4] << 32);
+        // upper bound of the bucket holding the 99th percentile
+        unsigned int seen = 0;
+        int bucket = 0;
+        while (bucket < ${PROFILE_BUCKETS} - 1 && (seen += row[5 + bucket]) < row[0] * 0.99) {
+            bucket++;
+        }
+        bucket++;
+        unsigned long long p99 = bucket < 2 ? (unsigned long long)bucket : (bucket & 1 ? 3ull : 2ull) << ((bucket >> 1) - 1);
+        printf("%-24s %10u %10.0f %10llu %10u\\n", profile_labels[i], row[0], row[0] ? (float)total / row[0] : 0.0f,
+               p99 < row[2] ? p99 : row[2], row[2]);
+    }
+}
+`;
@@ -0,0 +1,54 @@
+import { mkdir, readFile, readdir, rename, rm, stat, utimes, writeFile } from "fs/promises";
+import { join } from "path";
+import type { ModuleStore, StoredModule } from "../compileCache";
+
+/**
+ * The ModuleStore for the native/Node side: one <hash>.wasm file per module in dir, with
+ * the file's mtime as its last use (bumped on every hit), so a cache directory can also be
+ * inspected or cleared by hand.
+ *
+ *   const cache = new ModuleCache(new DirectoryStore(".zen-cache"));
+ */
+export class DirectoryStore implements ModuleStore {
+  constructor(private dir: string) {}
+
+  private path(key: string) {
+    return join(this.dir, `${key}.wasm`);
+  }
+
+  async get(key: string) {
+    try {
+      const bytes = await readFile(this.path(key));
+      return bytes.buffer.slice(bytes.byteOffset, bytes.byteOffset + bytes.byteLength);
+    } catch (e) {
+      return undefined;
+    }
+  }
+
+  async put(key: string, bytes: ArrayBuffer) {
+    await mkdir(this.dir, { recursive: true });
+    // written under a temporary name first, so a reader never sees half a module
+    const temporary = `${this.path(key)}.${process.pid}.tmp`;
+    await writeFile(temporary, new Uint8Array(bytes));
+    await rename(temporary, this.path(key));
+  }
+
+  async touch(key: string) {
+    const now = new Date();
+    await utimes(this.path(key), now, now);
+  }
+
+  async delete(key: string) {
+    await rm(this.path(key), { force: true });
+  }
+
+  async entries(): Promise<StoredModule[]> {
+    const files = await readdir(this.dir).catch(() => [] as string[]);
+    const entries: StoredModule[] = [];
+    for (const file of files.filter((x) => x.endsWith(".wasm"))) {
+      const info = await stat(join(this.dir, file));
+      entries.push({ key: file.slice(0, -5), size: info.size, lastUsed: info.mtimeMs });
+    }
+    return entries;
+  }
+}
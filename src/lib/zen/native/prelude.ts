@@ -0,0 +1,143 @@
+/**
+ * Portable stand-in for <wasm_simd128.h> + <emscripten.h>, so the kernel printed by
+ * generateWASM compiles unchanged with gcc/clang on a native host.
+ *
+ * The generated code only ever speaks the wasm_* vocabulary, so instead of forking the
+ * block printer we implement that vocabulary with GCC/Clang vector extensions, which
+ * lower to SSE/AVX on x86 and NEON on arm.
+ *
+ * Natively v128_t is SIMD_WIDTH lanes wide rather than 4: the block printer steps SIMD
+ * loops by SIMD_WIDTH, so the same kernel builds as SSE/NEON (4), AVX2 (8) or AVX-512 (16)
+ * depending on the compile flags, or -DZEN_SIMD_WIDTH=N to force a width.
+ */
+export const nativeSIMDPrelude = `
+#include <stdint.h>
+#include <string.h>
+#define EMSCRIPTEN_KEEPALIVE
+
+#ifndef ZEN_SIMD_WIDTH
+#if defined(__AVX512F__)
+#define ZEN_SIMD_WIDTH 16
+#elif defined(__AVX__)
+#define ZEN_SIMD_WIDTH 8
+#else
+#define ZEN_SIMD_WIDTH 4
+#endif
+#endif
+#define SIMD_WIDTH ZEN_SIMD_WIDTH
+#define SIMD_ALIGN (SIMD_WIDTH * 4)
+
+typedef float v128_t __attribute__((vector_size(SIMD_ALIGN)));
+typedef int32_t zen_mask_t __attribute__((vector_size(SIMD_ALIGN)));
+
+// calls to one function whose invocations share no state are printed as a batch; built with
+// -fopenmp the batch is spread over a thread pool, and function scratch arrays are per-thread.
+// The team outlives the parallel region (and spins between regions with
+// OMP_WAIT_POLICY=active), but each region still costs a wake-up and a join on the audio
+// thread, so a batch only goes parallel with at least ZEN_PARALLEL_MIN_TASKS calls and
+// ZEN_PARALLEL_MIN_SAMPLES samples of work between them: anything less runs in order
+#if defined(_OPENMP)
+#ifndef ZEN_PARALLEL_MIN_TASKS
+#define ZEN_PARALLEL_MIN_TASKS 4
+#endif
+#ifndef ZEN_PARALLEL_MIN_SAMPLES
+#define ZEN_PARALLEL_MIN_SAMPLES 4096
+#endif
+#define ZEN_PRAGMA(x) _Pragma(#x)
+#define ZEN_PARALLEL_FOR(tasks) \\
+    ZEN_PRAGMA(omp parallel for schedule(static) \\
+               if((tasks) >= ZEN_PARALLEL_MIN_TASKS && (tasks) * BLOCK_SIZE >= ZEN_PARALLEL_MIN_SAMPLES))
+#define ZEN_THREAD_LOCAL _Thread_local
+#else
+#define ZEN_PARALLEL_FOR(tasks)
+#define ZEN_THREAD_LOCAL
+#endif
+
+// lanes of base[idx] for the table lookups in vectorLookup.ts, which falls back to one load
+// per lane where there is no gather (wasm)
+#define ZEN_HAS_GATHER
+#if defined(__AVX512F__) && SIMD_WIDTH == 16
+#include <immintrin.h>
+static inline v128_t zen_f32x4_gather(const float *base, v128_t idx) {
+    return (v128_t)_mm512_i32gather_ps(_mm512_cvttps_epi32((__m512)idx), base, 4);
+}
+#elif defined(__AVX2__) && SIMD_WIDTH == 8
+#include <immintrin.h>
+static inline v128_t zen_f32x4_gather(const float *base, v128_t idx) {
+    return (v128_t)_mm256_i32gather_ps(base, _mm256_cvttps_epi32((__m256)idx), 4);
+}
+#else
+static inline v128_t zen_f32x4_gather(const float *base, v128_t idx) {
+    v128_t r = idx;
+    for (int i = 0; i < SIMD_WIDTH; i++) r[i] = base[(int)idx[i]];
+    return r;
+}
+#endif
+
+// lets the harness report which kernel it ended up running
+int zen_simd_width(void) { return SIMD_WIDTH; }
+
+static inline v128_t wasm_f32x4_splat(float x) { return (v128_t){0} + x; }
+static inline v128_t wasm_v128_load(const void *p) { v128_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline void wasm_v128_store(void *p, v128_t v) { memcpy(p, &v, sizeof(v)); }
+
+static inline v128_t wasm_f32x4_add(v128_t a, v128_t b) { return a + b; }
+static inline v128_t wasm_f32x4_sub(v128_t a, v128_t b) { return a - b; }
+static inline v128_t wasm_f32x4_mul(v128_t a, v128_t b) { return a * b; }
+static inline v128_t wasm_f32x4_div(v128_t a, v128_t b) { return a / b; }
+
+// comparisons yield all-ones/all-zeros lanes, exactly like wasm
+static inline v128_t wasm_f32x4_lt(v128_t a, v128_t b) { return (v128_t)(a < b); }
+static inline v128_t wasm_f32x4_gt(v128_t a, v128_t b) { return (v128_t)(a > b); }
+static inline v128_t wasm_f32x4_le(v128_t a, v128_t b) { return (v128_t)(a <= b); }
+static inline v128_t wasm_f32x4_ge(v128_t a, v128_t b) { return (v128_t)(a >= b); }
+static inline v128_t wasm_f32x4_eq(v128_t a, v128_t b) { return (v128_t)(a == b); }
+static inline v128_t wasm_f32x4_ne(v128_t a, v128_t b) { return (v128_t)(a != b); }
+
+static inline v128_t wasm_v128_and(v128_t a, v128_t b) { return (v128_t)((zen_mask_t)a & (zen_mask_t)b); }
+static inline v128_t wasm_v128_or(v128_t a, v128_t b) { return (v128_t)((zen_mask_t)a | (zen_mask_t)b); }
+static inline v128_t wasm_v128_xor(v128_t a, v128_t b) { return (v128_t)((zen_mask_t)a ^ (zen_mask_t)b); }
+static inline v128_t wasm_v128_not(v128_t a) { return (v128_t)(~(zen_mask_t)a); }
+static inline v128_t wasm_v128_andnot(v128_t a, v128_t b) { return (v128_t)((zen_mask_t)a & ~(zen_mask_t)b); }
+static inline v128_t wasm_v128_bitselect(v128_t a, v128_t b, v128_t mask) {
+    return (v128_t)(((zen_mask_t)a & (zen_mask_t)mask) | ((zen_mask_t)b & ~(zen_mask_t)mask));
+}
+
+static inline v128_t wasm_f32x4_neg(v128_t a) { return -a; }
+
+// integer lanes, for the exponent tricks in vectorMath.ts
+static inline v128_t wasm_i32x4_splat(int32_t x) { return (v128_t)((zen_mask_t){0} + x); }
+static inline v128_t wasm_i32x4_add(v128_t a, v128_t b) { return (v128_t)((zen_mask_t)a + (zen_mask_t)b); }
+static inline v128_t wasm_i32x4_sub(v128_t a, v128_t b) { return (v128_t)((zen_mask_t)a - (zen_mask_t)b); }
+static inline v128_t wasm_i32x4_shl(v128_t a, int n) { return (v128_t)((zen_mask_t)a << n); }
+static inline v128_t wasm_i32x4_shr(v128_t a, int n) { return (v128_t)((zen_mask_t)a >> n); }
+static inline v128_t wasm_i32x4_trunc_sat_f32x4(v128_t a) { return (v128_t)__builtin_convertvector(a, zen_mask_t); }
+static inline v128_t wasm_f32x4_convert_i32x4(v128_t a) { return __builtin_convertvector((zen_mask_t)a, v128_t); }
+
+static inline v128_t wasm_f32x4_min(v128_t a, v128_t b) { return wasm_v128_bitselect(a, b, wasm_f32x4_lt(a, b)); }
+static inline v128_t wasm_f32x4_max(v128_t a, v128_t b) { return wasm_v128_bitselect(a, b, wasm_f32x4_gt(a, b)); }
+
+// the compiler turns these into roundps/sqrtps (or the NEON equivalents) at -O2
+#define ZEN_LANEWISE(name, fn) \\
+    static inline v128_t name(v128_t a) { \\
+        v128_t r = a; /* every lane is overwritten, gcc just can't tell */ \\
+        for (int i = 0; i < SIMD_WIDTH; i++) r[i] = fn(a[i]); \\
+        return r; \\
+    }
+ZEN_LANEWISE(wasm_f32x4_abs, __builtin_fabsf)
+ZEN_LANEWISE(wasm_f32x4_floor, __builtin_floorf)
+ZEN_LANEWISE(wasm_f32x4_ceil, __builtin_ceilf)
+ZEN_LANEWISE(wasm_f32x4_trunc, __builtin_truncf)
+ZEN_LANEWISE(wasm_f32x4_nearest, __builtin_rintf)
+ZEN_LANEWISE(wasm_f32x4_sqrt, __builtin_sqrtf)
+
+#define wasm_f32x4_extract_lane(v, i) ((v)[(i)])
+// only the fixed 4x4 matrix helpers (simd.ts) shuffle, so this stays 4 lanes
+#if defined(__clang__)
+#define wasm_i32x4_shuffle(a, b, c0, c1, c2, c3) \\
+    ((v128_t)__builtin_shufflevector((zen_mask_t)(a), (zen_mask_t)(b), c0, c1, c2, c3))
+#else
+#define wasm_i32x4_shuffle(a, b, c0, c1, c2, c3) \\
+    ((v128_t)__builtin_shuffle((zen_mask_t)(a), (zen_mask_t)(b), (zen_mask_t){c0, c1, c2, c3}))
+#endif
+`;
@@ -0,0 +1,125 @@
+import type { ZenGraph } from "./zen";
+import type { ContextMessage } from "./context";
+import { Target } from "./targets";
+import { createWorkletCode } from "./createWorkletCode";
+import { compileServer } from "./worklet";
+import { moduleCache } from "./compileCache";
+import { EVENT_RING_SIZE, EVENT_STRIDE } from "./memory/automation";
+import { maxWavFrames, WavWriter } from "@/utils/wav";
+
+/**
+ * A message the worklet would have received during the render ("schedule-set", to set or
+ * ramp a param/history, or "init-memory", to load a data() buffer), with body.time in
+ * samples from the start of the render.
+ */
+export type OfflineEvent = ContextMessage;
+
+export interface OfflineOptions {
+  seconds: number;
+  sampleRate?: number;
+  events?: OfflineEvent[];
+  // the kernel's inputs, channel-major (the graph's blockSize samples per input), filled per block
+  fillInputs?: (inputs: Float32Array, frame: number) => void;
+}
+
+/**
+ * Renders a graph (Target.C) as fast as the kernel runs, without an AudioContext: the same
+ * module the worklet would load (through the module cache) is driven block after block,
+ * with events applied where the worklet would apply them, and the output streamed into a
+ * float WAV.
+ *
+ * Param events go through the kernel's event ring, so they land on their exact sample
+ * (ramps included). Data loads are copied in before the block they fall in, since the
+ * kernel can only change a whole buffer between blocks. A block with more param events than
+ * the ring holds, or a render past the 4GB a WAV can describe, throws rather than losing data.
+ *
+ * Meant for a web worker, or Node: the render doesn't yield until it's done.
+ */
+export const renderOffline = async (graph: ZenGraph, options: OfflineOptions): Promise<Blob> => {
+  if (graph.context.target !== Target.C) {
+    throw new Error("offline rendering needs a graph compiled for the C target");
+  }
+  // any block size works here, the bigger the less per-block overhead (see blockSize.ts)
+  const { blockSize } = graph.context;
+  const { wasm } = createWorkletCode("Offline", graph);
+  const bytes = await moduleCache.get(wasm, compileServer);
+  const { instance } = await WebAssembly.instantiate(bytes, {
+    env: {
+      memory: new WebAssembly.Memory({ initial: 256, maximum: 256 }),
+      zen_clock: () => 0,
+    },
+    GOT: { mem: {} },
+  });
+  const exports = instance.exports as any;
+  const heap = () => exports.memory.buffer as ArrayBuffer;
+
+  const numberOfInputs = graph.numberOfInputs;
+  const numberOfOutputs = graph.numberOfOutputs;
+  const inputPtr = exports.my_malloc(blockSize * 4 * numberOfInputs);
+  const outputPtr = exports.my_malloc(blockSize * 4 * numberOfOutputs);
+  const ringPtr = exports.get_event_ring();
+  exports.initSineTable();
+
+  const load = (idx: number, data: ArrayLike<number>) => {
+    const ptr = exports.my_malloc(data.length * 4);
+    new Float32Array(heap(), ptr, data.length).set(data);
+    exports.initializeMemory(idx, ptr, data.length);
+    exports.my_free(ptr);
+  };
+  for (const block of graph.context.memory.blocksInUse) {
+    if (block.initData !== undefined) {
+      load((block._idx === undefined ? block.idx : block._idx) as number, block.initData);
+    }
+  }
+
+  const sampleRate = options.sampleRate || graph.context.sampleRate;
+  const total = Math.round(options.seconds * sampleRate);
+  const blocks = Math.ceil(total / blockSize);
+  if (total > maxWavFrames(numberOfOutputs)) {
+    throw new Error(`${options.seconds}s of ${numberOfOutputs} channels won't fit a WAV (4GB)`);
+  }
+  const events = [...(options.events || [])].sort((a, b) => a.body.time - b.body.time);
+  const writer = new WavWriter(numberOfOutputs, sampleRate);
+
+  let next = 0;
+  for (let b = 0; b < blocks; b++) {
+    const start = b * blockSize;
+    // the ring is emptied by every process(), so it only has to hold one block's events
+    const indices = new Uint32Array(heap(), ringPtr, 2);
+    const ints = new Int32Array(heap(), ringPtr + 8, EVENT_RING_SIZE * EVENT_STRIDE);
+    const floats = new Float32Array(heap(), ringPtr + 8, EVENT_RING_SIZE * EVENT_STRIDE);
+    while (next < events.length && events[next].body.time < start + blockSize) {
+      const { type, body } = events[next++];
+      if (type === "init-memory") {
+        load(body.idx, body.data);
+      } else {
+        if (indices[0] - indices[1] >= EVENT_RING_SIZE) {
+          // process() can't be split, so the rest would be dropped without a trace
+          throw new Error(
+            `more than ${EVENT_RING_SIZE} param events in the block at sample ${start}: ` +
+              "render with a smaller block size, or fewer events",
+          );
+        }
+        const i = (indices[0] & (EVENT_RING_SIZE - 1)) * EVENT_STRIDE;
+        ints[i] = body.idx;
+        ints[i + 1] = Math.max(0, Math.floor(body.time - start));
+        floats[i + 2] = body.value;
+        ints[i + 3] = Math.round(body.ramp || 0);
+        indices[0]++;
+      }
+    }
+
+    const inputs = new Float32Array(heap(), inputPtr, blockSize * numberOfInputs);
+    if (options.fillInputs) {
+      options.fillInputs(inputs, start);
+    }
+    exports.process(inputPtr, outputPtr, start / sampleRate);
+    const frames = Math.min(blockSize, total - start);
+    const out = new Float32Array(heap(), outputPtr, blockSize * numberOfOutputs);
+    writer.write(out, frames, blockSize);
+  }
+
+  exports.my_free(inputPtr);
+  exports.my_free(outputPtr);
+  return writer.finish();
+};
@@ -10,7 +10,8 @@ export interface ParamInfo {
 }
 
 export type ParamGen = UGen & {
-  set?: (val: number, time?: number, invocation?: number) => void;
+  // ramp (in samples): glide linearly from the current value, reaching val ramp samples after time
+  set?: (val: number, time?: number, invocation?: number, ramp?: number) => void;
   getInitData?: () => number;
   getParamInfo?: () => ParamInfo;
 };
@@ -21,15 +22,16 @@ export const param = (
   min?: number,
   max?: number,
   mc = false,
+  automated = false,
 ): ParamGen => {
-  let ssd: History = history(val, { inline: false, name: name, min, max, mc });
+  let ssd: History = history(val, { inline: false, name: name, min, max, mc, automated });
 
   let p: ParamGen = ssd();
-  p.set = (val: number, time?: number, invocation?: number) => {
+  p.set = (val: number, time?: number, invocation?: number, ramp?: number) => {
     if (isNaN(val)) {
       val = 0;
     }
-    ssd.value!(val, time, invocation);
+    ssd.value!(val, time, invocation, ramp);
   };
 
   p.getInitData = () => {
@@ -0,0 +1,53 @@
+import { Target } from "./targets";
+
+/**
+ * The numeric precision of a value (not to be confused with MathPrecision, which picks the
+ * vector math approximations). Kernels compute in f32: it's what a SIMD lane holds, and
+ * half the memory traffic of f64. f64 is opted into per UGen (accum/phasor, history, t60
+ * and decay, delay), for state whose error compounds: a phase advanced by tiny increments
+ * for hours, a decay coefficient within a few ulps of 1, a read position far into the heap.
+ *
+ * An f64 cell is two adjacent floats of memory[], so it's allocated, initialized and carried
+ * across recompiles like any other block; generated code reads and writes it through
+ * zen_load_f64/zen_store_f64. Arithmetic on an f64 value stays f64 (and scalar) within its
+ * block: the value is rounded to f32 where it crosses into another block or into SIMD code.
+ *
+ * Only the C target distinguishes the two: in Javascript every number is already an f64.
+ */
+export type Precision = "f32" | "f64";
+
+// floats of memory[] per f64 cell
+export const F64_CELLS = 2;
+
+// the C type of f64 values: the kernel's "double"s are all rewritten to float (see wasm.ts)
+export const F64_TYPE = "zen_f64";
+
+export const isF64 = (precision: Precision | undefined, target: Target): boolean =>
+  precision === "f64" && target === Target.C;
+
+export const printLoadF64 = (idx: number | string): string => `zen_load_f64(memory + ${idx})`;
+
+export const printStoreF64 = (idx: number | string, value: string): string =>
+  `zen_store_f64(memory + ${idx}, ${value});`;
+
+// the two floats holding an f64 cell's bits, as memory[] expects them (initData, init-memory)
+export const encodeF64 = (value: number): Float32Array =>
+  new Float32Array(new Float64Array([value]).buffer);
+
+export const decodeF64 = (cells: Float32Array): number =>
+  new Float64Array(cells.buffer.slice(cells.byteOffset, cells.byteOffset + 8))[0];
+
+// (the typedef is spelled without the keyword, which would be rewritten along with the rest)
+export const printPrecisionHelpers = (): string => `
+typedef __typeof__(0.0) zen_f64;
+
+static inline zen_f64 zen_load_f64(const float *cell) {
+    zen_f64 value;
+    __builtin_memcpy(&value, cell, sizeof(value));
+    return value;
+}
+
+static inline void zen_store_f64(float *cell, zen_f64 value) {
+    __builtin_memcpy(cell, &value, sizeof(value));
+}
+`;
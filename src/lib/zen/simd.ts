@@ -163,6 +163,15 @@ export const SIMD_FUNCTIONS: SIMDOperationMap = {
   max: "wasm_f32x4_max",
   round: "wasm_f32x4_nearest",
   trunc: "wasm_f32x4_trunc",
+  // vectorMath.ts
+  exp: "zen_f32x4_exp",
+  log: "zen_f32x4_log",
+  log2: "zen_f32x4_log2",
+  log10: "zen_f32x4_log10",
+  pow: "zen_f32x4_pow",
+  sin: "zen_f32x4_sin",
+  cos: "zen_f32x4_cos",
+  tanh: "zen_f32x4_tanh",
 };
 
 // an encapsulated SIMD Block of operations that can execute via SIMD
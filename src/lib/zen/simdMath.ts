@@ -7,6 +7,7 @@ import { cKeywords, isComparisonOperator } from "./math";
 import { Target } from "./targets";
 import { SIMD_OPERATIONS, SIMD_FUNCTIONS } from "./simd";
 import { uuid } from "./uuid";
+import { F64_TYPE, isF64 } from "./precision";
 
 const generateScalar = (context: Context, scalar: number, opVar: string) => {
   const code = `${context.varKeyword} ${opVar} = ${scalar};`;
@@ -22,6 +23,63 @@ const generateScalar = (context: Context, scalar: number, opVar: string) => {
   };
 };
 
+/**
+ * constants and uniforms don't vary within a block: SIMD code splats them once (the splat
+ * is hoisted out of the loop by printFunction) rather than depending on a scalar block
+ */
+export const isBlockRate = (x: Generated): boolean =>
+  x.scalar !== undefined || x.uniform !== undefined;
+
+const blockRateExpression = (x: Generated): string =>
+  x.scalar !== undefined ? `${x.scalar}` : (x.uniform as string);
+
+// a uniform only results when at least one input is uniform: all-constant inputs fold
+const uniformInputs = (context: Context, ins: Generated[]): string[] | undefined =>
+  context.target === Target.C &&
+  ins.every(isBlockRate) &&
+  ins.some((x) => x.uniform !== undefined)
+    ? ins.map(blockRateExpression)
+    : undefined;
+
+export const splatBlockRate = (
+  context: SIMDContext,
+  id: number,
+  input: Generated,
+  suffix = "",
+) => {
+  const [v] = context.useCachedVariables(
+    id,
+    (input.scalar !== undefined ? "constantVector" : "uniformVector") + suffix,
+  );
+  return {
+    variable: v,
+    code: `v128_t ${v}= wasm_f32x4_splat(${blockRateExpression(input)});
+`,
+  };
+};
+
+// the splat replaces the dependency on the scalar fragment, so it no longer needs a block
+export const withoutBlockRateDependencies = (args: Generated[]): Generated[] =>
+  args.map((x) => (isBlockRate(x) ? { ...x, codeFragments: [] } : x));
+
+const UNIFORM_OPERATORS = new Set([
+  "+",
+  "-",
+  "*",
+  "/",
+  "%",
+  "<",
+  "<=",
+  ">",
+  ">=",
+  "==",
+  "!=",
+  "&&",
+  "||",
+]);
+
+const WIDE_OPERATORS = new Set(["+", "-", "*", "/", "%"]);
+
 export const simdOp = (
   operator: string,
   name: string,
@@ -43,11 +101,17 @@ export const simdOp = (
           return generateScalar(context, total, opVar);
         }
 
+        // arithmetic on an f64 value stays f64 (comparisons and logic are 1/0 either way)
+        const wide =
+          WIDE_OPERATORS.has(operator) &&
+          evaluatedArgs.some((x) => isF64(x.precision, context.target));
+        const keyword = wide ? F64_TYPE : context.varKeyword;
+
         // otherwise we need to generate code to evaluate the op
-        let code = `${context.varKeyword} ${opVar} = ${evaluatedArgs.map((x) => x.variable).join(` ${operator} `)};`;
+        let code = `${keyword} ${opVar} = ${evaluatedArgs.map((x) => x.variable).join(` ${operator} `)};`;
         if (operator === "%") {
           if (context.target === Target.C) {
-            code = `${context.varKeyword} ${opVar} = fmod(${evaluatedArgs[0].variable}, ${evaluatedArgs[1].variable});`;
+            code = `${keyword} ${opVar} = fmod(${evaluatedArgs[0].variable}, ${evaluatedArgs[1].variable});`;
           }
         }
         if (operator === "^") {
@@ -57,19 +121,33 @@ export const simdOp = (
         }
         if (operator === "/") {
           // we need to be save
-          code = `${context.varKeyword} ${opVar} = ${evaluatedArgs[1].variable} == 0.0 ? 0.0 : ${evaluatedArgs.map((x) => x.variable).join(" " + operator + " ")};`;
+          code = `${keyword} ${opVar} = ${evaluatedArgs[1].variable} == 0.0 ? 0.0 : ${evaluatedArgs.map((x) => x.variable).join(" " + operator + " ")};`;
         }
 
-        return context.emit(code, opVar, ...evaluatedArgs);
+        const generated = context.emit(code, opVar, ...evaluatedArgs);
+        if (wide) {
+          generated.precision = "f64";
+        }
+        const uniforms = uniformInputs(context, evaluatedArgs);
+        if (uniforms && UNIFORM_OPERATORS.has(operator)) {
+          generated.uniform =
+            operator === "/"
+              ? `(${uniforms[1]} == 0.0 ? 0.0 : ${uniforms.join(" / ")})`
+              : operator === "%"
+                ? `fmod(${uniforms[0]}, ${uniforms[1]})`
+                : `(${uniforms.join(` ${operator} `)})`;
+        }
+        return generated;
       },
 
       // the SIMD function for math ops:
       (context: SIMDContext, ...evaluatedArgs: Generated[]): SIMDOutput => {
-        // if every element is a scalar or the operation is not supported, then we need to fall back on
-        // scalar
+        // if every element is a scalar (or uniform) or the operation is not supported, then we need
+        // to fall back on scalar
         if (
-          evaluatedArgs.every((x) => x.scalar !== undefined) ||
-          !SIMD_OPERATIONS[operator]
+          evaluatedArgs.every(isBlockRate) ||
+          !SIMD_OPERATIONS[operator] ||
+          evaluatedArgs.some((x) => isF64(x.precision, context.target))
         ) {
           return {
             type: "SIMD_NOT_SUPPORTED",
@@ -84,15 +162,11 @@ export const simdOp = (
         let i = 0;
         let code = "";
         for (const input of evaluatedArgs) {
-          if (input.scalar !== undefined) {
+          if (isBlockRate(input)) {
             // we need to create a constant SIMD vector (via splatting)
-            const [v] = context.useCachedVariables(
-              id + i * 78932,
-              "constantVector",
-            );
-            code += `v128_t ${v}= wasm_f32x4_splat(${input.scalar});
-`;
-            inVariables[i] = v;
+            const splat = splatBlockRate(context, id + i * 78932, input);
+            code += splat.code;
+            inVariables[i] = splat.variable;
           } else if (input.codeFragments[0].context.isSIMD) {
             if (input.codeFragments[0].context !== context) {
               // the dependency exists in a previous block so we simply need to note that
@@ -107,20 +181,16 @@ export const simdOp = (
           i++;
         }
 
-        if (isComparisonOperator(operator)) {
-          // comparisons in SIMD need a few extra steps to convert them to usable values (1/0)
-          // TODO - move to helper function
-          const [bitmask, trueVec, falseVec] = context.useCachedVariables(
-            id,
-            "bitmask",
-            "trueVec",
-            "falseVec",
-          );
+        const comparison = isComparisonOperator(operator);
+        const [bitmask, trueVec] = comparison
+          ? context.useCachedVariables(id, "bitmask", "trueVec")
+          : [];
+        if (comparison) {
+          // the mask is all bits set where true, so masking the bits of 1.0f gives the 1/0
           code += `
 v128_t ${bitmask} = ${SIMD_OPERATIONS[operator]}(${inVariables[0]}, ${inVariables[1]});
 v128_t ${trueVec} = wasm_f32x4_splat(1.0f);
-v128_t ${falseVec} = wasm_f32x4_splat(0.0f);
-v128_t ${opVar} = wasm_v128_bitselect(${trueVec}, ${falseVec}, ${bitmask});
+v128_t ${opVar} = wasm_v128_and(${bitmask}, ${trueVec});
 `;
         } else {
           // straight SIMD
@@ -133,8 +203,11 @@ v128_t ${opVar} = wasm_v128_bitselect(${trueVec}, ${falseVec}, ${bitmask});
         const generated: Generated = context.emitSIMD(
           code,
           opVar,
-          ...evaluatedArgs,
+          ...withoutBlockRateDependencies(evaluatedArgs),
         );
+        if (comparison) {
+          generated.mask = bitmask;
+        }
         return {
           generated,
           type: "SUCCESS",
@@ -167,15 +240,20 @@ export const simdFunc = (
             : `${context.varKeyword} ${opVar} = ${_func}(${_ins.map((x) => x.variable).join(",")});`;
         let y = context.emit(code, opVar, ..._ins);
         y.scalar = scalar;
+        const uniforms = scalar === undefined ? uniformInputs(context, _ins) : undefined;
+        if (uniforms) {
+          y.uniform = `${_func}(${uniforms.join(", ")})`;
+        }
         return y;
       },
 
       // the SIMD function for math ops:
       (context: SIMDContext, ...evaluatedArgs: Generated[]): SIMDOutput => {
-        // if every element is a scalar or the operation is not supported, then we need to fall back on
-        // scalar
+        // if every element is a scalar (or uniform) or the operation is not supported, then we need
+        // to fall back on scalar
         if (
           (jsFunc && evaluatedArgs.every((x) => x.scalar !== undefined)) ||
+          uniformInputs(context, evaluatedArgs) ||
           !SIMD_FUNCTIONS[name]
         ) {
           return {
@@ -191,12 +269,11 @@ export const simdFunc = (
         let i = 0;
         let code = "";
         for (let input of evaluatedArgs) {
-          if (input.scalar !== undefined) {
+          if (isBlockRate(input)) {
             // we need to create a constant SIMD vector (via splatting)
-            let [v] = context.useCachedVariables(id, "constantVector");
-            code += `v128_t ${v}= wasm_f32x4_splat(${input.scalar});
-`;
-            inVariables[i] = v;
+            let splat = splatBlockRate(context, id, input);
+            code += splat.code;
+            inVariables[i] = splat.variable;
           } else if (input.codeFragments[0].context.isSIMD) {
             if (input.codeFragments[0].context !== context) {
               // the dependency exists in a previous block so we simply need to note that
@@ -219,7 +296,7 @@ export const simdFunc = (
         let generated: Generated = context.emitSIMD(
           code,
           opVar,
-          ...evaluatedArgs,
+          ...withoutBlockRateDependencies(evaluatedArgs),
         );
         return {
           generated,
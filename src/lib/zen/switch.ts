@@ -3,13 +3,21 @@ import { add, mult, wrap } from './math';
 import { Context, SIMDContext } from './context';
 import { simdMemo } from './memo';
 import { uuid } from './uuid';
+import { isBlockRate, splatBlockRate, withoutBlockRateDependencies } from './simdMath';
+import { Target } from './targets';
 
 export const zswitch = (cond: Arg, thenExpr: Arg, elseExpr: Arg): UGen => {
     let id = uuid();
     return simdMemo((context: Context, _cond: Generated, _then: Generated, _else: Generated): Generated => {
         let [varName] = context.useCachedVariables(id, "switch");
         let out = `${context.varKeyword} ${varName} = ${_cond.variable} ? ${_then.variable} : ${_else.variable};`;
-        return context.emit(out, varName, _cond, _then, _else);
+        let generated = context.emit(out, varName, _cond, _then, _else);
+        let ins = [_cond, _then, _else];
+        if (context.target === Target.C && ins.every(isBlockRate) && ins.some(x => x.uniform !== undefined)) {
+            let [c, a, b] = ins.map(x => x.uniform ?? `${x.scalar}`);
+            generated.uniform = `(${c} ? ${a} : ${b})`;
+        }
+        return generated;
     }, (context: SIMDContext, _cond: Generated, _then: Generated, _else: Generated) => {
         let [maskedA, invCondition, maskedB, result] = context.useCachedVariables(id, "maskedA", "invCondition", "maskedB", "result");
 
@@ -19,13 +27,15 @@ export const zswitch = (cond: Arg, thenExpr: Arg, elseExpr: Arg): UGen => {
         // otherwise, we're in SIMD land
         let i = 0;
         let code = "";
+        if (evaluatedArgs.every(isBlockRate)) {
+            return { type: "SIMD_NOT_SUPPORTED" };
+        }
         for (let input of evaluatedArgs) {
-            if (input.scalar !== undefined) {
+            if (isBlockRate(input)) {
                 // we need to create a constant SIMD vector (via splatting)
-                let [v] = context.useCachedVariables(id, "constantVector_" + i);
-                code += `v128_t ${v}= wasm_f32x4_splat(${input.scalar});
-`;
-                inVariables[i] = v;
+                let splat = splatBlockRate(context, id, input, "_" + i);
+                code += splat.code;
+                inVariables[i] = splat.variable;
             } else if (input.codeFragments[0].context.isSIMD) {
                 if (input.codeFragments[0].context !== context) {
                     // the dependency exists in a previous block so we simply need to note that
@@ -41,12 +51,19 @@ export const zswitch = (cond: Arg, thenExpr: Arg, elseExpr: Arg): UGen => {
             i++;
         }
 
-        code += `
+        // a condition computed by a comparison in this same block already has its mask
+        if (_cond.mask && !isBlockRate(_cond) && _cond.codeFragments[0].context === context) {
+            code += `
+v128_t ${result} = wasm_v128_bitselect(${inVariables[1]}, ${inVariables[2]}, ${_cond.mask});
+`;
+        } else {
+            code += `
 v128_t ${result} = float_blend(${inVariables[0]}, ${inVariables[1]}, ${inVariables[2]});
 `;
+        }
 
 
-        let generated: Generated = context.emitSIMD(code, result, ...evaluatedArgs);
+        let generated: Generated = context.emitSIMD(code, result, ...withoutBlockRateDependencies(evaluatedArgs));
         return {
             generated,
             type: "SUCCESS"
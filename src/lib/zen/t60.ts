@@ -1,35 +1,55 @@
 import { UGen, Generated, genArg, Arg } from './zen';
 import { mult, mix } from './math';
 import { history, History } from './history'
-import { Context } from './context';
-import { simdMemo } from './memo';
+import { Context, SIMDContext } from './context';
+import { simdMemo, SIMDOutput } from './memo';
+import { isBlockRate } from './simdMath';
 import { cKeywords } from './math';
 import { Target } from './targets';
 import { uuid } from './uuid';
+import { type Precision, F64_TYPE, isF64 } from './precision';
 
-export const t60 = (input: Arg): UGen => {
+// f64: the coefficient of a long decay is within a few f32 ulps of 1
+export const t60 = (input: Arg, precision?: Precision): UGen => {
     let id = uuid();
     return simdMemo((context: Context,  _input: Generated): Generated => {
         let [variable] = context.useCachedVariables(id, "t60Val");
         let exp = context.target === Target.C ? cKeywords["Math.exp"] : "Math.exp";
+        let wide = isF64(precision, context.target);
         let code = `
-${context.varKeyword} ${variable} = ${exp}(-6.907755278921 / ${_input.variable});
+${wide ? F64_TYPE : context.varKeyword} ${variable} = ${exp}(-6.907755278921 / ${_input.variable});
 `;
-        return context.emit(
+        let generated = context.emit(
             code,
             variable,
             _input);
-    }, undefined, input);
+        if (wide) {
+            generated.precision = "f64";
+        }
+        return generated;
+    }, (context: SIMDContext, _input: Generated): SIMDOutput => {
+        // envelopes with a per-sample decay time stay in lanes (see vectorMath.ts)
+        if (isBlockRate(_input) || isF64(precision, context.target)) {
+            return { type: "SIMD_NOT_SUPPORTED" };
+        }
+        let [variable] = context.useCachedVariables(id, "t60Val");
+        let code = `v128_t ${variable} = zen_f32x4_exp(wasm_f32x4_div(wasm_f32x4_splat(-6.907755278921f), ${_input.variable}));
+`;
+        return {
+            type: "SUCCESS",
+            generated: context.emitSIMD(code, variable, _input),
+        };
+    }, input);
 };
 
 export type TrigGen = UGen & {
     trigger?: () => void
 };
 
-export const decay = (decayTime: Arg = 44100): TrigGen => {
-    let ssd: History = history();
+export const decay = (decayTime: Arg = 44100, precision?: Precision): TrigGen => {
+    let ssd: History = history(undefined, precision && { precision });
 
-    let trigDecay: TrigGen = ssd(mult(ssd(), t60(decayTime)));
+    let trigDecay: TrigGen = ssd(mult(ssd(), t60(decayTime, precision)));
     trigDecay.trigger = () => {
         ssd.value!(1);
     };
@@ -37,10 +57,10 @@ export const decay = (decayTime: Arg = 44100): TrigGen => {
     return trigDecay;
 };
 
-export const decayTrig = (input: Arg, decayTime: Arg = 44100): TrigGen => {
-    let ssd: History = history();
+export const decayTrig = (input: Arg, decayTime: Arg = 44100, precision?: Precision): TrigGen => {
+    let ssd: History = history(undefined, precision && { precision });
 
-    let trigDecay: TrigGen = ssd(mix(input, ssd(), t60(decayTime)));
+    let trigDecay: TrigGen = ssd(mix(input, ssd(), t60(decayTime, precision)));
 
     return trigDecay;
 };
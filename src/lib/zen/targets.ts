@@ -1,4 +1,7 @@
 export enum Target {
     Javascript,
-    C
+    C,
+    // same C kernel as Target.C, printed against a portable SIMD prelude instead of
+    // emscripten (see native/prelude.ts). graphs are still built with Target.C
+    NativeC
 }
@@ -1,3 +1,6 @@
 let id = 0;
 
-export const uuid = () => id++;
\ No newline at end of file
+export const uuid = () => id++;
+
+// the id the next uuid() will return
+export const peekUUID = () => id;
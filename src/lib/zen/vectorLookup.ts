@@ -0,0 +1,49 @@
+/**
+ * Prints the table lookup kernels used by the SIMD paths of cycle() and peek(): a gather
+ * (base[idx] for every lane), branchless index wrapping, and the two interpolators.
+ *
+ * Natively the prelude provides zen_f32x4_gather (a real gather instruction on AVX2 and
+ * AVX-512) and defines ZEN_HAS_GATHER; wasm has no gather, so there it's 4 scalar loads.
+ */
+export const printVectorLookup = (): string => `
+#ifndef ZEN_HAS_GATHER
+// idx holds whole numbers (as floats)
+static inline v128_t zen_f32x4_gather(const float *base, v128_t idx) {
+    return wasm_f32x4_make(
+        base[(int)wasm_f32x4_extract_lane(idx, 0)],
+        base[(int)wasm_f32x4_extract_lane(idx, 1)],
+        base[(int)wasm_f32x4_extract_lane(idx, 2)],
+        base[(int)wasm_f32x4_extract_lane(idx, 3)]);
+}
+#endif
+
+// brings an index that is at most size out of [0, size) back in
+static inline v128_t zen_f32x4_wrap_index(v128_t i, v128_t size) {
+    i = wasm_v128_bitselect(wasm_f32x4_add(i, size), i, wasm_f32x4_lt(i, wasm_f32x4_splat(0.0f)));
+    return wasm_v128_bitselect(wasm_f32x4_sub(i, size), i, wasm_f32x4_ge(i, size));
+}
+
+static inline v128_t zen_f32x4_lerp(v128_t a, v128_t b, v128_t frac) {
+    return wasm_f32x4_add(wasm_f32x4_mul(wasm_f32x4_sub(wasm_f32x4_splat(1.0f), frac), a), wasm_f32x4_mul(frac, b));
+}
+
+// 4-point, 3rd order Hermite between y1 and y2
+static inline v128_t zen_f32x4_hermite(v128_t y0, v128_t y1, v128_t y2, v128_t y3, v128_t frac) {
+    v128_t c1 = wasm_f32x4_mul(wasm_f32x4_splat(0.5f), wasm_f32x4_sub(y2, y0));
+    v128_t c2 = wasm_f32x4_sub(
+        wasm_f32x4_add(wasm_f32x4_sub(y0, wasm_f32x4_mul(wasm_f32x4_splat(2.5f), y1)), wasm_f32x4_mul(wasm_f32x4_splat(2.0f), y2)),
+        wasm_f32x4_mul(wasm_f32x4_splat(0.5f), y3));
+    v128_t c3 = wasm_f32x4_add(
+        wasm_f32x4_mul(wasm_f32x4_splat(0.5f), wasm_f32x4_sub(y3, y0)),
+        wasm_f32x4_mul(wasm_f32x4_splat(1.5f), wasm_f32x4_sub(y1, y2)));
+    v128_t y = wasm_f32x4_add(wasm_f32x4_mul(c3, frac), c2);
+    y = wasm_f32x4_add(wasm_f32x4_mul(y, frac), c1);
+    return wasm_f32x4_add(wasm_f32x4_mul(y, frac), y1);
+}
+`;
+
+/**
+ * The scalar version of zen_f32x4_hermite, inline so the JS target can use it too.
+ */
+export const printHermite = (y0: string, y1: string, y2: string, y3: string, frac: string) =>
+  `(((0.5 * (${y3} - ${y0}) + 1.5 * (${y1} - ${y2})) * ${frac} + (${y0} - 2.5 * ${y1} + 2 * ${y2} - 0.5 * ${y3})) * ${frac} + 0.5 * (${y2} - ${y0})) * ${frac} + ${y1}`;
@@ -0,0 +1,156 @@
+/**
+ * How accurate the vector transcendentals are:
+ * - precise: within a few float ulps of libm (what the scalar path computes)
+ * - fast: shorter polynomials, error up to about 6e-5 (exp, pow, tanh), 4e-6 (sin,
+ *   cos) and 1e-6 (log): plenty for envelopes, windows and waveshaping
+ */
+export type MathPrecision = "precise" | "fast";
+
+/**
+ * Prints vector versions of exp, log, pow, sin, cos and tanh, so blocks using them can stay
+ * in v128_t lanes instead of falling back to a scalar libm call per sample (see
+ * SIMD_FUNCTIONS). They're written in the wasm_* vocabulary only, so the same code builds
+ * for wasm and, through the native prelude, for SSE/AVX/NEON at any SIMD_WIDTH.
+ *
+ * The fast tier is picked with ZEN_FAST_MATH, which generateWASM defines for graphs built
+ * with mathPrecision "fast" (native builds can also pass -DZEN_FAST_MATH).
+ */
+export const printVectorMath = (precision: MathPrecision): string => `
+${precision === "fast" ? "#define ZEN_FAST_MATH" : ""}
+
+static inline v128_t zen_f32x4_poly(v128_t x, v128_t acc, float c) {
+    return wasm_f32x4_add(wasm_f32x4_mul(acc, x), wasm_f32x4_splat(c));
+}
+
+// e^x = 2^n * e^r with |r| <= ln2/2: 2^n is built directly in the exponent bits
+static inline v128_t zen_f32x4_exp(v128_t x) {
+    v128_t underflow = wasm_f32x4_ge(x, wasm_f32x4_splat(-87.33654f));
+    x = wasm_f32x4_min(wasm_f32x4_max(x, wasm_f32x4_splat(-87.33654f)), wasm_f32x4_splat(88.72283f));
+    v128_t n = wasm_f32x4_nearest(wasm_f32x4_mul(x, wasm_f32x4_splat(1.44269504f)));
+    // ln2 in two parts, so n * ln2 is subtracted without losing r's low bits
+    v128_t r = wasm_f32x4_sub(x, wasm_f32x4_mul(n, wasm_f32x4_splat(0.693359375f)));
+    r = wasm_f32x4_sub(r, wasm_f32x4_mul(n, wasm_f32x4_splat(-2.12194440e-4f)));
+#ifdef ZEN_FAST_MATH
+    v128_t p = wasm_f32x4_splat(4.16666667e-2f);
+    p = zen_f32x4_poly(r, p, 1.66666667e-1f);
+    p = zen_f32x4_poly(r, p, 0.5f);
+#else
+    v128_t p = wasm_f32x4_splat(1.9875691500e-4f);
+    p = zen_f32x4_poly(r, p, 1.3981999507e-3f);
+    p = zen_f32x4_poly(r, p, 8.3334519073e-3f);
+    p = zen_f32x4_poly(r, p, 4.1665795894e-2f);
+    p = zen_f32x4_poly(r, p, 1.6666665459e-1f);
+    p = zen_f32x4_poly(r, p, 5.0000001201e-1f);
+#endif
+    v128_t y = wasm_f32x4_add(wasm_f32x4_add(wasm_f32x4_mul(p, wasm_f32x4_mul(r, r)), r), wasm_f32x4_splat(1.0f));
+    v128_t scale = wasm_i32x4_shl(wasm_i32x4_add(wasm_i32x4_trunc_sat_f32x4(n), wasm_i32x4_splat(127)), 23);
+    return wasm_v128_and(wasm_f32x4_mul(y, scale), underflow);
+}
+
+// log(x) = e * ln2 + log(m), with the mantissa m in [sqrt(1/2), sqrt(2))
+static inline v128_t zen_f32x4_log(v128_t x) {
+    v128_t e = wasm_i32x4_sub(wasm_i32x4_shr(x, 23), wasm_i32x4_splat(127));
+    v128_t m = wasm_v128_or(wasm_v128_and(x, wasm_i32x4_splat(0x007fffff)), wasm_i32x4_splat(0x3f800000));
+    v128_t big = wasm_f32x4_gt(m, wasm_f32x4_splat(1.41421356f));
+    m = wasm_v128_bitselect(wasm_f32x4_mul(m, wasm_f32x4_splat(0.5f)), m, big);
+    v128_t exponent = wasm_f32x4_add(wasm_f32x4_convert_i32x4(e), wasm_v128_and(big, wasm_f32x4_splat(1.0f)));
+#ifdef ZEN_FAST_MATH
+    // 2 atanh((m - 1) / (m + 1))
+    v128_t t = wasm_f32x4_div(wasm_f32x4_sub(m, wasm_f32x4_splat(1.0f)), wasm_f32x4_add(m, wasm_f32x4_splat(1.0f)));
+    v128_t t2 = wasm_f32x4_mul(t, t);
+    v128_t p = wasm_f32x4_splat(0.2f);
+    p = zen_f32x4_poly(t2, p, 3.33333333e-1f);
+    p = zen_f32x4_poly(t2, p, 1.0f);
+    v128_t y = wasm_f32x4_mul(wasm_f32x4_mul(t, p), wasm_f32x4_splat(2.0f));
+    y = wasm_f32x4_add(y, wasm_f32x4_mul(exponent, wasm_f32x4_splat(0.693147181f)));
+#else
+    v128_t f = wasm_f32x4_sub(m, wasm_f32x4_splat(1.0f));
+    v128_t z = wasm_f32x4_mul(f, f);
+    v128_t p = wasm_f32x4_splat(7.0376836292e-2f);
+    p = zen_f32x4_poly(f, p, -1.1514610310e-1f);
+    p = zen_f32x4_poly(f, p, 1.1676998740e-1f);
+    p = zen_f32x4_poly(f, p, -1.2420140846e-1f);
+    p = zen_f32x4_poly(f, p, 1.4249322787e-1f);
+    p = zen_f32x4_poly(f, p, -1.6668057665e-1f);
+    p = zen_f32x4_poly(f, p, 2.0000714765e-1f);
+    p = zen_f32x4_poly(f, p, -2.4999993993e-1f);
+    p = zen_f32x4_poly(f, p, 3.3333331174e-1f);
+    v128_t y = wasm_f32x4_mul(wasm_f32x4_mul(p, f), z);
+    y = wasm_f32x4_add(y, wasm_f32x4_mul(exponent, wasm_f32x4_splat(-2.12194440e-4f)));
+    y = wasm_f32x4_sub(y, wasm_f32x4_mul(z, wasm_f32x4_splat(0.5f)));
+    y = wasm_f32x4_add(wasm_f32x4_add(f, y), wasm_f32x4_mul(exponent, wasm_f32x4_splat(0.693359375f)));
+#endif
+    // like libm: -inf at 0, nan below
+    y = wasm_v128_bitselect(wasm_f32x4_splat(-INFINITY), y, wasm_f32x4_eq(x, wasm_f32x4_splat(0.0f)));
+    return wasm_v128_bitselect(wasm_f32x4_splat(NAN), y, wasm_f32x4_lt(x, wasm_f32x4_splat(0.0f)));
+}
+
+static inline v128_t zen_f32x4_log2(v128_t x) {
+    return wasm_f32x4_mul(zen_f32x4_log(x), wasm_f32x4_splat(1.44269504f));
+}
+
+static inline v128_t zen_f32x4_log10(v128_t x) {
+    return wasm_f32x4_mul(zen_f32x4_log(x), wasm_f32x4_splat(0.434294482f));
+}
+
+// exp(b * log|a|), with libm's answers for negative bases (integer exponents only) and b = 0
+static inline v128_t zen_f32x4_pow(v128_t a, v128_t b) {
+    v128_t y = zen_f32x4_exp(wasm_f32x4_mul(b, zen_f32x4_log(wasm_f32x4_abs(a))));
+    v128_t negative = wasm_f32x4_lt(a, wasm_f32x4_splat(0.0f));
+    v128_t half = wasm_f32x4_mul(b, wasm_f32x4_splat(0.5f));
+    v128_t odd = wasm_f32x4_ne(half, wasm_f32x4_trunc(half));
+    v128_t integer = wasm_f32x4_eq(b, wasm_f32x4_trunc(b));
+    y = wasm_v128_bitselect(wasm_f32x4_neg(y), y, wasm_v128_and(negative, wasm_v128_and(integer, odd)));
+    y = wasm_v128_bitselect(wasm_f32x4_splat(NAN), y, wasm_v128_and(negative, wasm_v128_not(integer)));
+    return wasm_v128_bitselect(wasm_f32x4_splat(1.0f), y, wasm_f32x4_eq(b, wasm_f32x4_splat(0.0f)));
+}
+
+// sin(2 pi t): t is folded into [-1/4, 1/4] of a turn, where an odd polynomial is enough
+static inline v128_t zen_f32x4_sin_turns(v128_t t) {
+    t = wasm_f32x4_sub(t, wasm_f32x4_nearest(t));
+    t = wasm_v128_bitselect(wasm_f32x4_sub(wasm_f32x4_splat(0.5f), t), t, wasm_f32x4_gt(t, wasm_f32x4_splat(0.25f)));
+    t = wasm_v128_bitselect(wasm_f32x4_sub(wasm_f32x4_splat(-0.5f), t), t, wasm_f32x4_lt(t, wasm_f32x4_splat(-0.25f)));
+    v128_t z = wasm_f32x4_mul(t, wasm_f32x4_splat(6.28318531f));
+    v128_t z2 = wasm_f32x4_mul(z, z);
+#ifdef ZEN_FAST_MATH
+    v128_t p = wasm_f32x4_splat(2.75573192e-6f);
+#else
+    v128_t p = wasm_f32x4_splat(-2.50521084e-8f);
+    p = zen_f32x4_poly(z2, p, 2.75573192e-6f);
+#endif
+    p = zen_f32x4_poly(z2, p, -1.98412698e-4f);
+    p = zen_f32x4_poly(z2, p, 8.33333333e-3f);
+    p = zen_f32x4_poly(z2, p, -1.66666667e-1f);
+    p = zen_f32x4_poly(z2, p, 1.0f);
+    return wasm_f32x4_mul(z, p);
+}
+
+// x in turns, less whole turns: 2 pi is subtracted in two parts, like ln2 in exp
+static inline v128_t zen_f32x4_to_turns(v128_t x) {
+    v128_t n = wasm_f32x4_nearest(wasm_f32x4_mul(x, wasm_f32x4_splat(0.159154943f)));
+    x = wasm_f32x4_sub(x, wasm_f32x4_mul(n, wasm_f32x4_splat(6.28125f)));
+    x = wasm_f32x4_sub(x, wasm_f32x4_mul(n, wasm_f32x4_splat(1.93530718e-3f)));
+    return wasm_f32x4_mul(x, wasm_f32x4_splat(0.159154943f));
+}
+
+static inline v128_t zen_f32x4_sin(v128_t x) {
+    return zen_f32x4_sin_turns(zen_f32x4_to_turns(x));
+}
+
+static inline v128_t zen_f32x4_cos(v128_t x) {
+    return zen_f32x4_sin_turns(wasm_f32x4_add(zen_f32x4_to_turns(x), wasm_f32x4_splat(0.25f)));
+}
+
+// (e^2x - 1) / (e^2x + 1), with the series near 0 where the subtraction cancels
+static inline v128_t zen_f32x4_tanh(v128_t x) {
+    v128_t clamped = wasm_f32x4_min(wasm_f32x4_max(x, wasm_f32x4_splat(-9.0f)), wasm_f32x4_splat(9.0f));
+    v128_t e = zen_f32x4_exp(wasm_f32x4_mul(clamped, wasm_f32x4_splat(2.0f)));
+    v128_t y = wasm_f32x4_div(wasm_f32x4_sub(e, wasm_f32x4_splat(1.0f)), wasm_f32x4_add(e, wasm_f32x4_splat(1.0f)));
+    v128_t x2 = wasm_f32x4_mul(x, x);
+    v128_t p = wasm_f32x4_splat(1.33333333e-1f);
+    p = zen_f32x4_poly(x2, p, -3.33333333e-1f);
+    p = zen_f32x4_poly(x2, p, 1.0f);
+    v128_t small = wasm_f32x4_lt(wasm_f32x4_abs(x), wasm_f32x4_splat(0.0625f));
+    return wasm_v128_bitselect(wasm_f32x4_mul(x, p), y, small);
+}
+`;
@@ -19,76 +19,95 @@ import {
 } from "./worklet";
 import { determineBlocks } from "./blocks/analyze";
 import { printBlocks, printUserFunction } from "./blocks/printBlock";
+import { summarizeFunction, unknownFunction, type FunctionSummaries } from "./blocks/fuse";
 import { printConstantInitializer } from "./blocks/printConstants";
 import { Target } from "./targets";
 import { determineMemorySize } from "./memory/initialize";
-
-export const generateWASM = (graph: ZenGraph) => {
-  const memorySize = determineMemorySize(graph.context);
-
-  const hasSIMD = true;
-  const blocks = determineBlocks(...graph.codeFragments);
-  const blocksCode = printBlocks(blocks, Target.C);
-
-  let code = `
+import { nativeSIMDPrelude } from "./native/prelude";
+import { printAutomation } from "./memory/automation";
+import { printMessageRing } from "./memory/messages";
+import { printProfiler, type ProfileSection } from "./memory/profile";
+import { printVectorMath } from "./vectorMath";
+import { printVectorLookup } from "./vectorLookup";
+import { printPrecisionHelpers } from "./precision";
+import { printDenormalHelpers } from "./denormals";
+
+const printHeaders = (target: Target, hasSIMD: boolean): string => {
+  if (target === Target.NativeC) {
+    return `
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+${nativeSIMDPrelude}`;
+  }
+  return `
 ${hasSIMD ? "#include <wasm_simd128.h>" : ""}
 #include <stdlib.h>
 #include <stdio.h>
 #include <emscripten.h>
 #include <math.h>
-#define BLOCK_SIZE 128 // The size of one block of samples
-#define MEM_SIZE ${memorySize} // Define this based on your needs
-#define SINE_TABLE_SIZE 1024
-#define MAX_MESSAGES 10000
-
-double memory[MEM_SIZE] __attribute__((aligned(16))); // Your memory buffer
-double  sineTable[SINE_TABLE_SIZE]; // Your memory buffer
+#define SIMD_WIDTH 4 // lanes in a v128_t
+#define SIMD_ALIGN 16
+#define ZEN_PARALLEL_FOR(tasks)
+#define ZEN_THREAD_LOCAL`;
+};
 
-int elapsed = 0;
+/**
+ * Prints the C kernel for a graph. With Target.NativeC the same kernel is printed
+ * against the portable SIMD prelude, so it can be built with a host compiler and
+ * linked against the harness in native/harness.ts.
+ */
+export const generateWASM = (graph: ZenGraph, target: Target = Target.C) => {
+  const memorySize = determineMemorySize(graph.context);
 
-struct Message {
-   int type;
-   double subType;
-   double body;
-   double currentTime;
-};
+  const hasSIMD = true;
+  // each function is summarized once printed, so calls to it can be scheduled and batched
+  const functions: FunctionSummaries = new Map(
+    graph.functions.map((x) => [x.name, unknownFunction(x.name)]),
+  );
+  const functionsCode = graph.functions
+    .map((x) => {
+      const printed = printUserFunction(x, Target.C, functions);
+      functions.set(
+        x.name,
+        summarizeFunction(
+          x.name,
+          printed,
+          graph.functions.map((f) => f.name),
+        ),
+      );
+      return printed;
+    })
+    .join("\n");
 
-int message_checker = 0;
-int message_counter = 0;
-struct Message messages[MAX_MESSAGES];
-
-void new_message(int type, float subType, float body, float currentTime) {
-   messages[message_counter].type = type;
-   messages[message_counter].subType = subType;
-   messages[message_counter].body = body;
-   messages[message_counter].currentTime = currentTime;
-   message_counter = (message_counter + 1);
-   if (message_counter >= MAX_MESSAGES) {
-     message_counter = 0;
-   }
-}
+  const blocks = determineBlocks(...graph.codeFragments);
+  // the worklet (and native harness) label the timings they read back with these
+  const sections: ProfileSection[] | undefined = graph.context.profile ? [] : undefined;
+  const blocksCode = printBlocks(blocks, Target.C, functions, sections);
+  graph.context.profileSections = sections;
 
-EMSCRIPTEN_KEEPALIVE
-int get_message_counter() {
-  return message_counter;
-}
+  let code = `
+${printHeaders(target, hasSIMD)}
+#define BLOCK_SIZE ${graph.context.blockSize} // The size of one block of samples (see blockSize.ts)
+#define MEM_SIZE ${Math.max(memorySize, 1)} // Define this based on your needs (C has no empty arrays)
+#define SINE_TABLE_SIZE 1024
+${printVectorMath(graph.context.mathPrecision)}
+${printVectorLookup()}
+${printDenormalHelpers(target)}
 
-// Get a pointer to the messages array
-struct Message* EMSCRIPTEN_KEEPALIVE flush_messages() {
-   return messages;
-}
+// f32 throughout: state that opted into f64 takes two floats (see precision.ts)
+float memory[MEM_SIZE] __attribute__((aligned(SIMD_ALIGN))); // Your memory buffer
+float  sineTable[SINE_TABLE_SIZE]; // Your memory buffer
+${printPrecisionHelpers()}
 
-// Get a pointer to the messages array
-double * EMSCRIPTEN_KEEPALIVE get_memory() {
+int elapsed = 0;
+${printMessageRing()}
+// Get a pointer to the memory array
+float * EMSCRIPTEN_KEEPALIVE get_memory() {
     return memory;
 }
 
-EMSCRIPTEN_KEEPALIVE
-void empty_messages() {
-    message_counter = 0;
-}
-
-double random_double() {
+float random_double() {
     return rand() / (float)RAND_MAX;
 }
 
@@ -116,7 +135,7 @@ void initSineTable() {
 }
 
 EMSCRIPTEN_KEEPALIVE
-void setMemorySlot(int idx, double val) {
+void setMemorySlot(int idx, float val) {
     memory[idx] = val;
 }
 
@@ -128,6 +147,8 @@ void initializeMemory(int idx, float* data, int length) {
     }
 }
 
+${printAutomation(graph.context)}
+
 v128_t wasm_f32x4_mod(v128_t a, v128_t b) {
     // a: dividend vector, b: divisor vector
     v128_t div_result = wasm_f32x4_div(a, b);
@@ -138,29 +159,23 @@ v128_t wasm_f32x4_mod(v128_t a, v128_t b) {
 }
 
 
-v128_t float_blend(v128_t condition, v128_t vecA, v128_t vecB) {
-    // Generate a mask where true (condition > 0) lanes are all bits set
-    v128_t mask = wasm_f32x4_gt(condition, wasm_f32x4_splat(0.0));
-
-    // This part assumes vecA if condition > 0, else vecB.
-    // Since WebAssembly currently lacks a direct f32x4 blend operation based on a mask,
-    // a workaround that simulates this operation is necessary.
-
-    // Apply mask: true selects from vecA, false selects from vecB.
-    // Unfortunately, we can't apply wasm_v128_and/not/or directly to floating points
-    // in a manner that achieves conditional selection based on floating-point values.
-    // The correct approach in WebAssembly SIMD would typically involve integer masks
-    // generated from comparisons, then using these masks to select between vectors.
-
-    // Placeholder for a correct SIMD blending approach:
-    // - Use comparison operations to generate masks.
-    // - Use generated masks to blend between vectors.
+// vecA in the lanes where condition > 0, vecB elsewhere
+static inline v128_t float_blend(v128_t condition, v128_t vecA, v128_t vecB) {
+    return wasm_v128_bitselect(vecA, vecB, wasm_f32x4_gt(condition, wasm_f32x4_splat(0.0f)));
+}
 
-    // Return a placeholder result; this needs proper implementation.
-    return wasm_v128_or(wasm_v128_and(mask, vecA), wasm_v128_and(wasm_v128_not(mask), vecB));
+// whether a block of samples (a gated function's activity, or a wake argument) has any
+// nonzero sample
+static inline int zen_any_nonzero(const float *x) {
+    for (int j = 0; j < BLOCK_SIZE; j++) {
+        if (x[j] != 0) return 1;
+    }
+    return 0;
 }
 
-${graph.functions.map((x) => printUserFunction(x, Target.C)).join("\n")}
+${sections ? printProfiler(sections, target) : ""}
+
+${functionsCode}
 
 ${blocksCode}
 `;
@@ -170,13 +185,15 @@ ${blocksCode}
   return code;
 };
 
+export const generateNativeC = (graph: ZenGraph) => generateWASM(graph, Target.NativeC);
+
 const genSIMDArrays = (simdBlocks: SIMDBlock[]): string => {
   let code = "";
   for (let block of simdBlocks) {
     let variable = block.variable;
     // need to declare all the arrays we need outside the body of the process function
     code += `
-float block_${variable}[128];
+float block_${variable}[BLOCK_SIZE];
 `;
   }
   return code;
@@ -186,7 +203,7 @@ const genBlockArrays = (variables: string[]): string => {
   let code = "";
   let arrays = [];
   for (let variable of variables) {
-    arrays.push(`float block_${variable}[128];`);
+    arrays.push(`float block_${variable}[BLOCK_SIZE];`);
   }
   return Array.from(new Set(arrays)).join("\n");
 };
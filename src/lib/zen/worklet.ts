@@ -6,8 +6,12 @@ import type { ZenGraph } from "./zen";
 import { replaceAll } from "./replaceAll";
 import type { Function, Argument } from "./functions";
 import { fetchWithRetry } from "./fetchWithRetry";
+import { moduleCache } from "./compileCache";
+import type { Compiler } from "./compileCache";
 import { generateJSProcess } from "./javascript";
 import { determineMemorySize, initMemory } from "./memory/initialize";
+import { reportProfile } from "./memory/profile";
+import { DEFAULT_BLOCK_SIZE, isRealtimeBlockSize } from "./blockSize";
 
 export interface ZenWorklet {
   code: string;
@@ -18,12 +22,39 @@ export interface ZenWorklet {
 
 export type LazyZenWorklet = ZenWorklet | (() => AudioWorkletNode);
 
+export const compileOnServer = (source: string): Promise<ArrayBuffer> =>
+  //fetch("https://zequencer.io/compile", {
+  fetch("http://localhost:7171/compile", {
+    method: "POST",
+    headers: { "Content-Type": "text/plain" },
+    body: source,
+  }).then((response) => {
+    if (!response.ok) {
+      throw new Error(`compile failed with status ${response.status}`);
+    }
+    return response.arrayBuffer();
+  });
+
+// bump whenever the compile server's toolchain or flags change, so modules cached from the
+// old build are compiled again
+export const COMPILE_SERVER_VERSION = "zen-compile-server/1";
+
+export const compileServer: Compiler = {
+  version: COMPILE_SERVER_VERSION,
+  compile: compileOnServer,
+};
+
 export const createWorklet = (
   ctxt: AudioContext,
   graph: ZenGraph,
   name = "Zen",
   onlyCompile = false,
 ): Promise<ZenWorklet> => {
+  if (!isRealtimeBlockSize(graph.context.blockSize)) {
+    throw new Error(
+      `a kernel with ${graph.context.blockSize} sample blocks can't run in the worklet (128 frames per call): render it offline`,
+    );
+  }
   return new Promise((resolve: (x: ZenWorklet) => void) => {
     const { code, wasm } = createWorkletCode(name, graph);
     const workletCode = code;
@@ -49,6 +80,10 @@ export const createWorklet = (
           body,
         });
 
+        if (type === "profile") {
+          reportKernelProfile(name, graph, body);
+        }
+
         if (graph.context.target === Target.C) {
           if (type === "wasm-ready") {
             initMemory(graph.context, workletNode);
@@ -59,16 +94,20 @@ export const createWorklet = (
 
       // Send initial data (Param & Data operators) to the worklet
       if (graph.context.target === Target.C) {
-        //fetch("https://zequencer.io/compile", {
-        fetch("http://localhost:7171/compile", {
-          method: "POST",
-          headers: { "Content-Type": "text/plain" },
-          body: wasm,
-        }).then(async (response) => {
-          const wasmBuffer = await response.arrayBuffer();
-          const wasmModule = await WebAssembly.compile(wasmBuffer);
-          workletNode.port.postMessage({ type: "load-wasm", body: wasmBuffer });
-        });
+        // a patch whose generated C was compiled before (even in an earlier session) is
+        // loaded from the cache instead of the compile server
+        moduleCache
+          .get(wasm, compileServer)
+          .then((wasmBuffer) => {
+            workletNode.port.postMessage({ type: "load-wasm", body: wasmBuffer });
+          })
+          .catch((e) => {
+            // reported like a module the worklet fails to instantiate, to whoever listens
+            console.log("error compiling", e);
+            workletNode.port.dispatchEvent(
+              new MessageEvent("message", { data: { type: "error-compiling", body: String(e) } }),
+            );
+          });
       } else {
         initMemory(graph.context, workletNode);
         workletNode.port.postMessage({ type: "ready" });
@@ -104,6 +143,15 @@ export const createWorklet = (
   });
 };
 
+/**
+ * Hands the timings a profiling build posts ("profile") to the performance monitor, with
+ * the message flush the worklet times itself as the last section.
+ */
+export const reportKernelProfile = (name: string, graph: ZenGraph, data: Uint32Array) => {
+  const sections = graph.context.profileSections || [];
+  reportProfile(name, data, [...sections, { label: "message flush", ugens: [] }]);
+};
+
 export interface ParsedCode {
   code: string;
   messageIdx: number;
@@ -164,48 +212,50 @@ export const genProcess = (graph: ZenGraph): CodeOutput => {
 
   if (graph.context.target === Target.C) {
     const wasmFile = generateWASM(graph);
+    // the kernel runs QUANTUM / BLOCK_SIZE times per render quantum (see blockSize.ts)
     const code = `
 process(inputs, outputs, parameters) {
     if (this.disposed || !this.ready) {
       return true;
     }
-    const BLOCK_SIZE = 128;
+    const QUANTUM = ${DEFAULT_BLOCK_SIZE};
+    const BLOCK_SIZE = ${graph.context.blockSize};
     let inputChannel = inputs[0];
     let outputChannel = outputs[0];
 
+    // messages are asked for a quantum ahead of the flush that copies them out
     if (this.messageCounter % 128 === 0) {
-      this.flushWASMMessages();
+      this.flushMessagesProfiled();
+    } else if (this.messageCounter % 128 === 127) {
+      this.requestMessages();
     }
     this.messageCounter++;
 
-    if (this.events.length > 0) {
-      this.scheduleEvents(128);
-    }
-
-    for (let i = 0; i < 1; i ++) {
+    for (let i = 0; i < QUANTUM / BLOCK_SIZE; i ++) {
       if (!this.wasmModule) {
          return true;
       }
+      if (this.events.length > 0) {
+        this.scheduleEvents(BLOCK_SIZE);
+      }
+      const offset = i * BLOCK_SIZE;
       for (let j = 0; j < ${graph.numberOfInputs}; j++) {
         const inputChannel = inputs[0][j];
         // Copy input samples to input buffer
         if (inputChannel) {
-          this.input.set(inputChannel, j * 128);
+          this.input.set(inputChannel.subarray(offset, offset + BLOCK_SIZE), j * BLOCK_SIZE);
         }
       }
 
       // Process samples
-      this.wasmModule.exports.process(this.inputPtr, this.outputPtr, currentTime);
+      this.wasmModule.exports.process(this.inputPtr, this.outputPtr, currentTime + offset / sampleRate);
 
       // Copy output buffer to output channel
       for (let j=0; j < ${graph.numberOfOutputs}; j++) {
-
-         //let arr = this.output.slice(j*128, (j+1)*128);
-         //outputs[0][j].set(arr, 0);
-         outputs[0][j].set(this.output.subarray(j * 128, (j + 1) * 128), 0);
-
+         outputs[0][j].set(this.output.subarray(j * BLOCK_SIZE, (j + 1) * BLOCK_SIZE), offset);
       }
     }
+    this.applyFade(outputs[0]);
     return true;
 }
 `;
@@ -295,7 +345,7 @@ export const genInputs = (graph: ZenGraph): string => {
   let out = "";
   for (let i = 0; i < graph.numberOfInputs; i++) {
     if (graph.context.target === Target.C) {
-      out += `${graph.context.varKeyword} in${i} = inputs[j + ${128 * i}];
+      out += `${graph.context.varKeyword} in${i} = inputs[j + ${graph.context.blockSize * i}];
 `;
     } else {
       out += `${graph.context.varKeyword} in${i} = inputs[0][${i}]  ? inputs[0][${i}][j] : 0;
@@ -310,7 +360,7 @@ export const genOutputs = (graph: ZenGraph): string => {
   for (let i = 0; i < graph.numberOfOutputs; i++) {
     if (graph.context.target === Target.C) {
       out += `
-        outputs[j + ${128 * i}] = output${i};
+        outputs[j + ${graph.context.blockSize * i}] = output${i};
 `;
     } else {
       out += `
@@ -7,6 +7,9 @@ import { Target } from "./targets";
 import { CodeBlock } from "./simd";
 import { History } from "./history";
 import { determineBlocks } from "./blocks/analyze";
+import type { MathPrecision } from "./vectorMath";
+import type { Precision } from "./precision";
+import { DEFAULT_BLOCK_SIZE, checkBlockSize } from "./blockSize";
 
 /**
  * Zen is a minimal implementation of a few simple gen~ (max/msp)
@@ -36,6 +39,14 @@ export interface Generated {
   functionArguments: Argument[];
   codeBlocks?: CodeBlock[];
   scalar?: number;
+  // C expression for a value that only changes between blocks (a param, or arithmetic on
+  // params/constants). SIMD code splats it once per block instead of loading it per sample
+  uniform?: string;
+  // SIMD comparisons: the lane mask (all bits set where true) behind the 1/0 variable, which
+  // a select in the same block uses as is
+  mask?: string;
+  // "f64" for a value computed in f64 (see precision.ts); f32 otherwise
+  precision?: Precision;
   clearMemoization?: () => void;
   usingForceScalarFunction?: boolean;
   incomingContext?: Context;
@@ -92,7 +103,7 @@ let ${variable} = ${variable}_index && ${variable}_index[${inputNumber}] ? ${var
       }
       const indexer =
         context.target === Target.C
-          ? `[128*${inputNumber} + j]`
+          ? `[${context.blockSize}*${inputNumber} + j]`
           : `[0][${inputNumber}][j]`;
       const code = `
 ${context.varKeyword} ${variable} = inputs${indexer};`;
@@ -128,9 +139,17 @@ export const zenWithTarget = (
   target: Target,
   input: UGen,
   forceScalar = false,
+  mathPrecision: MathPrecision = "precise",
+  profile = false,
+  blockSize = DEFAULT_BLOCK_SIZE,
 ): ZenGraph => {
+  checkBlockSize(blockSize);
   const context: Context = new Context(target);
   context.forceScalar = forceScalar;
+  context.mathPrecision = mathPrecision;
+  context.profile = profile;
+  // javascript kernels run once per render quantum
+  context.blockSize = target === Target.C ? blockSize : DEFAULT_BLOCK_SIZE;
   const generated: Generated = input(context);
   return {
     ...generated,
@@ -65,3 +65,85 @@ export const bufferToWavBlob = (buffers: Float32Array[], sampleRate: number): Bl
   const wavBuffer = wav.toBuffer();
   return new Blob([wavBuffer], { type: "audio/wav" });
 };
+
+// RIFF/WAVE header for 32-bit float samples, interleaved
+const WAV_HEADER_BYTES = 44;
+
+// the RIFF size field is 32 bits and counts everything after it, so a file stays under 4GB
+export const maxWavFrames = (channels: number): number =>
+  Math.floor((2 ** 32 - 1 - (WAV_HEADER_BYTES - 8)) / (channels * 4));
+
+export const wavHeader = (channels: number, sampleRate: number, frames: number): ArrayBuffer => {
+  if (frames > maxWavFrames(channels)) {
+    throw new Error(`${frames} frames of ${channels} channels don't fit a WAV file (4GB)`);
+  }
+  const header = new DataView(new ArrayBuffer(WAV_HEADER_BYTES));
+  const dataBytes = frames * channels * 4;
+  const text = (offset: number, value: string) => {
+    for (let i = 0; i < value.length; i++) {
+      header.setUint8(offset + i, value.charCodeAt(i));
+    }
+  };
+  text(0, "RIFF");
+  header.setUint32(4, WAV_HEADER_BYTES - 8 + dataBytes, true);
+  text(8, "WAVE");
+  text(12, "fmt ");
+  header.setUint32(16, 16, true);
+  // format 3: IEEE float
+  header.setUint16(20, 3, true);
+  header.setUint16(22, channels, true);
+  header.setUint32(24, sampleRate, true);
+  header.setUint32(28, sampleRate * channels * 4, true);
+  header.setUint16(32, channels * 4, true);
+  header.setUint16(34, 32, true);
+  text(36, "data");
+  header.setUint32(40, dataBytes, true);
+  return header.buffer;
+};
+
+/**
+ * Builds a float WAV a block at a time, for renders too long to hold as one buffer per
+ * channel (see renderOffline): samples are interleaved into fixed-size parts as they're
+ * written, and the parts are only joined, behind the header, by the Blob.
+ */
+export class WavWriter {
+  frames = 0;
+  private parts: ArrayBuffer[] = [];
+  private part: Float32Array;
+  private used = 0;
+
+  constructor(
+    public channels: number,
+    public sampleRate: number,
+    private partFrames = 65536,
+  ) {
+    this.part = new Float32Array(partFrames * channels);
+  }
+
+  // channel-major samples: channel c's frames start at c * stride
+  write(planar: Float32Array, frames: number, stride = frames) {
+    if (this.frames + frames > maxWavFrames(this.channels)) {
+      throw new Error(`a WAV file holds at most ${maxWavFrames(this.channels)} frames`);
+    }
+    for (let i = 0; i < frames; i++) {
+      if (this.used === this.partFrames) {
+        this.parts.push(this.part.buffer as ArrayBuffer);
+        this.part = new Float32Array(this.partFrames * this.channels);
+        this.used = 0;
+      }
+      const offset = this.used * this.channels;
+      for (let channel = 0; channel < this.channels; channel++) {
+        this.part[offset + channel] = planar[channel * stride + i];
+      }
+      this.used++;
+    }
+    this.frames += frames;
+  }
+
+  finish(): Blob {
+    const last = this.part.slice(0, this.used * this.channels).buffer;
+    return new Blob([wavHeader(this.channels, this.sampleRate, this.frames), ...this.parts, last], {
+      type: "audio/wav",
+    });
+  }
+}
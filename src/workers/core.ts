@@ -14,6 +14,8 @@ import {
   RingBufferMessage,
 } from "@/lib/workers/RingBuffer";
 import { SharedMemoryManager, MemoryOffsets } from "@/lib/workers/SharedMemoryManager";
+import type { ZenMessage } from "@/lib/zen/memory/messages";
+import { decodeMessageBatch } from "@/lib/zen/memory/messages";
 
 export interface NodeInstructions {
   nodeId: string;
@@ -399,7 +401,20 @@ const processRingBufferData = () => {
 };
 
 const handleSharedMessagePort = (nodeId: string, port: MessagePort) => {
+  // wasm nodes send their message names once, then messages as indices into them
+  let keys: string[] = [];
+  const publishMessage = (message: ZenMessage) => publish(message.type, [message.subType, message.body]);
+
   port.onmessage = (e: MessageEvent) => {
+    switch (e.data.type) {
+      case "message-keys":
+        keys = e.data.body;
+        return;
+      case "message-batch":
+        decodeMessageBatch(e.data.body, keys, publishMessage);
+        return;
+    }
+
     const type = e.data.type;
     const subType = e.data.subType;
     const value = e.data.body;
@@ -0,0 +1,33 @@
+import { Context, SIMDContext } from "../src/lib/zen/index";
+import type { CodeBlock } from "../src/lib/zen/blocks/analyze";
+import type { CodeFragment } from "../src/lib/zen/emitter";
+import { Target } from "../src/lib/zen/targets";
+
+export interface Shape {
+  simd?: boolean;
+  caller?: boolean;
+  inbound?: string[];
+  outbound?: string[];
+  outputs?: number[];
+}
+
+// a C block of already printed code, as the block passes see it after determineBlocks
+export const block = (code: string, shape: Shape = {}): CodeBlock => {
+  let context = new Context(Target.C);
+  if (shape.simd) {
+    context = new SIMDContext(context);
+  }
+  context.isFunctionCaller = shape.caller || false;
+  return {
+    code,
+    codes: [code],
+    context,
+    codeFragment: { code } as CodeFragment,
+    outboundDependencies: new Set(shape.outbound),
+    inboundDependencies: new Set(shape.inbound),
+    fullInboundDependencies: new Set(shape.inbound),
+    histories: [],
+    variablesEmitted: new Set(),
+    outputs: shape.outputs || [],
+  };
+};
@@ -0,0 +1,152 @@
+import { describe, expect, it } from "bun:test";
+import { entriesToEvict, ModuleCache, normalizeSource } from "../src/lib/zen/compileCache";
+import type { Compiler, ModuleStore, StoredModule } from "../src/lib/zen/compileCache";
+
+describe("normalizeSource", () => {
+  it("renumbers generated variables in order of appearance", () => {
+    expect(normalizeSource("float addVal77 = phasor3 + 1.0;\nfloat x9 = addVal77;")).toBe(
+      "float $0 = $1 + 1.0;\nfloat $2 = $0;",
+    );
+  });
+
+  it("gives a rebuilt graph the same source", () => {
+    const a = "v128_t mulVal12 = wasm_f32x4_mul(block_phasor3, constantVector4);";
+    const b = "v128_t mulVal240 = wasm_f32x4_mul(block_phasor181, constantVector99);";
+    expect(normalizeSource(a)).toBe(normalizeSource(b));
+  });
+
+  it("tells apart code that uses its variables differently", () => {
+    const declared = "float b2 = 1.0;\nfloat c3 = 2.0;\n";
+    expect(normalizeSource(`${declared}float a1 = b2 - c3;`)).not.toBe(
+      normalizeSource(`${declared}float a1 = c3 - b2;`),
+    );
+  });
+
+  it("collapses whitespace and drops blank lines", () => {
+    expect(normalizeSource("  float  a = 1.0;\n\n\t\tfloat b =\t2.0;  \n")).toBe(
+      "float a = 1.0;\nfloat b = 2.0;",
+    );
+  });
+
+  it("leaves reserved names ending in a digit", () => {
+    expect(normalizeSource("float y1 = log2(x2) + atan2(x2, 1.0) + log10(exp2(x2));")).toBe(
+      "float $0 = log2($1) + atan2($1, 1.0) + log10(exp2($1));",
+    );
+    expect(normalizeSource("__m128 v3 = a; __m256 w; __m512 z;")).toBe(
+      "__m128 $0 = a; __m256 w; __m512 z;",
+    );
+  });
+});
+
+describe("entriesToEvict", () => {
+  const entry = (key: string, size: number, lastUsed: number): StoredModule => ({
+    key,
+    size,
+    lastUsed,
+  });
+  const keys = (entries: StoredModule[]) => entries.map((x) => x.key).sort();
+
+  it("keeps everything that fits", () => {
+    const entries = [entry("a", 10, 90), entry("b", 10, 95)];
+    expect(entriesToEvict(entries, { maxBytes: 20, maxAge: 50 }, 100)).toEqual([]);
+  });
+
+  it("drops entries unused for longer than maxAge", () => {
+    const entries = [entry("a", 10, 10), entry("b", 10, 95), entry("c", 10, 49)];
+    expect(keys(entriesToEvict(entries, { maxBytes: 1000, maxAge: 50 }, 100))).toEqual([
+      "a",
+      "c",
+    ]);
+  });
+
+  it("drops the least recently used until the rest fits maxBytes", () => {
+    const entries = [entry("a", 10, 70), entry("b", 10, 90), entry("c", 10, 80), entry("d", 5, 60)];
+    expect(keys(entriesToEvict(entries, { maxBytes: 25, maxAge: 1000 }, 100))).toEqual([
+      "a",
+      "d",
+    ]);
+  });
+
+  it("counts only what's left after aging out", () => {
+    const entries = [entry("old", 100, 0), entry("a", 10, 90), entry("b", 10, 80)];
+    expect(keys(entriesToEvict(entries, { maxBytes: 20, maxAge: 50 }, 100))).toEqual(["old"]);
+  });
+
+  it("drops an entry bigger than maxBytes on its own", () => {
+    const entries = [entry("a", 30, 90)];
+    expect(keys(entriesToEvict(entries, { maxBytes: 20, maxAge: 50 }, 100))).toEqual(["a"]);
+  });
+});
+
+describe("ModuleCache", () => {
+  const compiler = (version: string) => {
+    const compiled: string[] = [];
+    const c: Compiler = {
+      version,
+      compile: async (source) => {
+        compiled.push(source);
+        return new Uint8Array([compiled.length]).buffer;
+      },
+    };
+    return { compiler: c, compiled };
+  };
+
+  class MapStore implements ModuleStore {
+    modules = new Map<string, ArrayBuffer>();
+    async get(key: string) {
+      return this.modules.get(key);
+    }
+    async put(key: string, bytes: ArrayBuffer) {
+      this.modules.set(key, bytes);
+    }
+    async touch() {}
+    async delete(key: string) {
+      this.modules.delete(key);
+    }
+    async entries() {
+      return Array.from(this.modules.entries()).map(([key, bytes]) => ({
+        key,
+        size: bytes.byteLength,
+        lastUsed: Date.now(),
+      }));
+    }
+  }
+
+  it("compiles a rebuilt graph once", async () => {
+    const cache = new ModuleCache();
+    const { compiler: c, compiled } = compiler("1");
+    await cache.get("float addVal1 = x2;", c);
+    await cache.get("float addVal7 = x9;", c);
+    expect(compiled.length).toBe(1);
+  });
+
+  it("compiles the same source again for another compiler version", async () => {
+    const cache = new ModuleCache();
+    const v1 = compiler("clang 17 -O3");
+    const v2 = compiler("clang 18 -O3");
+    await cache.get("float a1 = 1.0;", v1.compiler);
+    await cache.get("float a1 = 1.0;", v2.compiler);
+    await cache.get("float a1 = 1.0;", v1.compiler);
+    expect(v1.compiled.length).toBe(1);
+    expect(v2.compiled.length).toBe(1);
+  });
+
+  it("loads a module an earlier session stored, for the same version only", async () => {
+    const store = new MapStore();
+    const v1 = compiler("1");
+    await new ModuleCache(store).get("float a1 = 1.0;", v1.compiler);
+    await new ModuleCache(store).get("float a1 = 1.0;", v1.compiler);
+    expect(v1.compiled.length).toBe(1);
+
+    const v2 = compiler("2");
+    await new ModuleCache(store).get("float a1 = 1.0;", v2.compiler);
+    expect(v2.compiled.length).toBe(1);
+  });
+
+  it("shares a compile in flight", async () => {
+    const cache = new ModuleCache();
+    const { compiler: c, compiled } = compiler("1");
+    await Promise.all([cache.get("float a1 = 1.0;", c), cache.get("float a2 = 1.0;", c)]);
+    expect(compiled.length).toBe(1);
+  });
+});
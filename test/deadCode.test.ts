@@ -0,0 +1,140 @@
+import { describe, expect, it } from "bun:test";
+// (first: it loads the zen index, which the block passes need initialized)
+import { block } from "./blocks";
+import type { CodeBlock } from "../src/lib/zen/blocks/analyze";
+import { eliminateDeadCode, forwardOutputs } from "../src/lib/zen/blocks/analyze";
+import { printFunction } from "../src/lib/zen/blocks/printBlock";
+import { Target } from "../src/lib/zen/targets";
+
+const lines = (b: CodeBlock) => b.code.split("\n").filter((x) => x.trim() !== "");
+
+describe("eliminateDeadCode", () => {
+  it("drops a chain of declarations nothing reads", () => {
+    const [b] = eliminateDeadCode([
+      block(
+        "float a = 1.5;\nfloat b = a * 2.0;\nfloat c = sqrt(b) + a;\nfloat output0 = 3.0;",
+        { outputs: [0] },
+      ),
+    ]);
+    expect(lines(b)).toEqual(["float output0 = 3.0;"]);
+  });
+
+  it("keeps everything an output reads", () => {
+    const code = "float a = 1.5;\nfloat b = a * 2.0;\nfloat output0 = b;";
+    const [b] = eliminateDeadCode([block(code, { outputs: [0] })]);
+    expect(b.code).toBe(code);
+  });
+
+  it("keeps outbound variables another block reads, and drops the rest", () => {
+    const blocks = eliminateDeadCode([
+      block("v128_t x = wasm_f32x4_splat(1.0);\nv128_t y = wasm_f32x4_mul(x, x);", {
+        simd: true,
+        outbound: ["x", "y"],
+      }),
+      block("float output0 = x * 2.0;", { inbound: ["x"], outputs: [0] }),
+    ]);
+    expect(blocks.length).toBe(2);
+    expect(Array.from(blocks[0].outboundDependencies)).toEqual(["x"]);
+    expect(lines(blocks[0])).toEqual(["v128_t x = wasm_f32x4_splat(1.0);"]);
+    expect(Array.from(blocks[1].inboundDependencies)).toEqual(["x"]);
+  });
+
+  it("drops a block whose only outbound variable is never read", () => {
+    const blocks = eliminateDeadCode([
+      block("v128_t x = wasm_f32x4_splat(1.0);", { simd: true, outbound: ["x"] }),
+      block("float output0 = 2.0;", { inbound: ["x"], outputs: [0] }),
+    ]);
+    expect(blocks.length).toBe(1);
+    expect(blocks[0].inboundDependencies.size).toBe(0);
+  });
+
+  it("keeps variables a function call reads through its block_ array", () => {
+    const blocks = eliminateDeadCode([
+      block("v128_t x = wasm_f32x4_splat(1.0);", { simd: true, outbound: ["x"] }),
+      block("voice(0, block_x);", { caller: true, inbound: ["x"] }),
+    ]);
+    expect(blocks.length).toBe(2);
+    expect(Array.from(blocks[0].outboundDependencies)).toEqual(["x"]);
+    expect(lines(blocks[0])).toEqual(["v128_t x = wasm_f32x4_splat(1.0);"]);
+  });
+
+  it("leaves function output (+) dependencies alone", () => {
+    const call = "voice_out + 0 * 128";
+    const blocks = eliminateDeadCode([
+      block("float output0 = 1.0;", { outbound: [call], outputs: [0] }),
+      block("float output1 = 2.0;", { inbound: [call], outputs: [1] }),
+    ]);
+    expect(Array.from(blocks[0].outboundDependencies)).toEqual([call]);
+    expect(Array.from(blocks[1].inboundDependencies)).toEqual([call]);
+  });
+
+  it("keeps impure declarations and the values they read", () => {
+    const code = [
+      "float a = 0.25;",
+      "float n = random();",
+      "float m = (memory[3] = a);",
+      "int i = counter++;",
+      "float s = sqrt(a);",
+      "memory[4] = a;",
+    ].join("\n");
+    const [b] = eliminateDeadCode([block(code)]);
+    expect(lines(b)).toEqual([
+      "float a = 0.25;",
+      "float n = random();",
+      "float m = (memory[3] = a);",
+      "int i = counter++;",
+      "memory[4] = a;",
+    ]);
+  });
+});
+
+describe("forwardOutputs", () => {
+  it("folds a block that only copies SIMD results into the producing block", () => {
+    const producer = block("v128_t x = wasm_f32x4_splat(1.0);", { simd: true, outbound: ["x"] });
+    const blocks = forwardOutputs([
+      producer,
+      block("float output0 = x;", { inbound: ["x"], outputs: [0] }),
+    ]);
+    expect(blocks.length).toBe(1);
+    expect(blocks[0].code).toBe(`${producer.code}\nv128_t output0 = x;`);
+    expect(blocks[0].outputs).toEqual([0]);
+  });
+
+  it("leaves an output that does more than copy", () => {
+    const blocks = [
+      block("v128_t x = wasm_f32x4_splat(1.0);", { simd: true, outbound: ["x"] }),
+      block("float output0 = x * 2.0;", { inbound: ["x"], outputs: [0] }),
+    ];
+    const forwarded = forwardOutputs(blocks);
+    expect(forwarded.length).toBe(2);
+    forwarded.forEach((b, i) => expect(b).toBe(blocks[i]));
+  });
+
+  it("leaves an output copied from a scalar block", () => {
+    const blocks = [
+      block("float x = 1.0;", { outbound: ["x"] }),
+      block("float output0 = x;", { inbound: ["x"], outputs: [0] }),
+    ];
+    const forwarded = forwardOutputs(blocks);
+    expect(forwarded.length).toBe(2);
+    forwarded.forEach((b, i) => expect(b).toBe(blocks[i]));
+  });
+});
+
+describe("function outputs", () => {
+  it("stride every block's outputs by the function's output count", () => {
+    const code = printFunction(
+      "void voice(int invocation)",
+      "voice_out",
+      [
+        block("v128_t output0 = wasm_f32x4_splat(1.0);", { simd: true, outputs: [0] }),
+        block("float output1 = 2.0;", { outputs: [1] }),
+      ],
+      4,
+      false,
+      Target.C,
+    );
+    expect(code).toContain("wasm_v128_store(voice_out + 0 + 2 * invocation * 128 + j, output0);");
+    expect(code).toContain("voice_out [128 + 2 * invocation * 128 + j] = output1;");
+  });
+});
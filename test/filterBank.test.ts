@@ -0,0 +1,182 @@
+import { describe, expect, it } from "bun:test";
+import {
+  add,
+  biquadBank,
+  biquadKernel,
+  input,
+  onepoleKernel,
+  output,
+  printStep,
+  svfKernel,
+  zdfKernel,
+  zenWithTarget,
+} from "../src/lib/zen/index";
+import type { BankKernel } from "../src/lib/zen/index";
+import type { Context } from "../src/lib/zen/context";
+import { generateJSProcess } from "../src/lib/zen/javascript";
+import { generateWASM } from "../src/lib/zen/wasm";
+import { Target } from "../src/lib/zen/targets";
+
+// banks pad their lanes to the widest SIMD_WIDTH
+const LANES = 16;
+
+describe("filter bank state layout", () => {
+  const bank = (target: Target) => {
+    const voices = biquadBank([input(0), input(1), input(2)], [500, 1000, 2000], 1, 1, 0);
+    const graph = zenWithTarget(target, output(add(add(voices[0], voices[1]), voices[2]), 0));
+    return target === Target.C ? generateWASM(graph) : generateJSProcess(graph).process;
+  };
+
+  it("keeps state k of voice v at S + k*lanes + v in C", () => {
+    const code = bank(Target.C);
+    const S = code.match(/wasm_v128_load\(memory \+ (\d+) \+ 0 \+ v\)/)![1];
+    for (let k = 0; k < 4; k++) {
+      expect(code).toContain(`wasm_v128_store(memory + ${S} + ${k * LANES} + v,`);
+    }
+  });
+
+  it("keeps the same layout in JS, unrolled per voice", () => {
+    const code = bank(Target.Javascript);
+    const S = code.match(/memory\[(\d+) \+ 0\] = /)![1];
+    for (let k = 0; k < 4; k++) {
+      for (let v = 0; v < 3; v++) {
+        expect(code).toContain(`memory[${S} + ${k * LANES + v}] = `);
+      }
+    }
+  });
+
+  it("only copies the voices into the lane scratch each sample", () => {
+    const code = bank(Target.C);
+    expect(code).toMatch(/static ZEN_THREAD_LOCAL float bankIn\d*\[16\] __attribute__/);
+    expect(code).not.toMatch(/bankIn\d*\[16\][^;]*= \{0\}/);
+    expect(code).toMatch(/bankIn\d*\[2\] = /);
+    expect(code).not.toMatch(/bankIn\d*\[3\] = /);
+  });
+});
+
+describe("filter bank kernels", () => {
+  // the v128_t ops a vector step prints, over 4 lane arrays
+  const WIDTH = 4;
+  const lanewise =
+    (f: (...xs: number[]) => number) =>
+    (...vs: number[][]) =>
+      vs[0].map((_, i) => f(...vs.map((v) => v[i])));
+  const vectorOps = (heap: number[]) => ({
+    wasm_f32x4_splat: (x: number) => new Array(WIDTH).fill(x),
+    wasm_f32x4_add: lanewise((a, b) => a + b),
+    wasm_f32x4_sub: lanewise((a, b) => a - b),
+    wasm_f32x4_mul: lanewise((a, b) => a * b),
+    wasm_f32x4_div: lanewise((a, b) => a / b),
+    wasm_f32x4_min: lanewise(Math.min),
+    wasm_f32x4_max: lanewise(Math.max),
+    wasm_f32x4_abs: lanewise(Math.abs),
+    zen_f32x4_sin: lanewise(Math.sin),
+    zen_f32x4_cos: lanewise(Math.cos),
+    ZEN_SNAP_LANES: (x: number[]) => x,
+    wasm_v128_load: (p: number) => heap.slice(p, p + WIDTH),
+    wasm_v128_store: (p: number, x: number[]) => heap.splice(p, WIDTH, ...x),
+  });
+
+  const context = { sampleRate: 44100 } as Context;
+  const voices = 6;
+  // heap layout for the vector run: inputs, then each param's lanes, then the state
+  const IN = 0;
+  const PARAMS = LANES;
+
+  // runs the kernel over a few samples both ways, returning [vector, scalar] outputs and states
+  const run = (kernel: BankKernel, params: ((v: number) => number)[], shared: number[] = []) => {
+    const S = PARAMS + params.length * LANES;
+    const samples = 32;
+    const signal = (n: number, v: number) => Math.sin(0.37 * n * (v + 1)) * (v % 2 ? 0.5 : 1);
+
+    // vector: memory is the heap's base address, SIMD_WIDTH voices per step
+    const heap = new Array(S + kernel.states * LANES).fill(0);
+    const ops = vectorOps(heap);
+    const vectorParams = params.map((param, k) =>
+      shared.includes(k) ? `${param(0)}` : `wasm_v128_load(${PARAMS + k * LANES} + v)`,
+    );
+    const vector = printStep(
+      kernel,
+      true,
+      "lanes",
+      (k) => `memory + ${S} + ${k * LANES} + v`,
+      `wasm_v128_load(${IN} + v)`,
+      vectorParams,
+      context,
+    );
+    const vectorStep = new Function(
+      ...Object.keys(ops),
+      "memory",
+      "v",
+      `${vector.code.replace(/v128_t /g, "let ")}return ${vector.output};`,
+    );
+    params.forEach((param, k) => {
+      for (let v = 0; v < voices; v++) heap[PARAMS + k * LANES + v] = param(v);
+    });
+
+    // scalar: one voice per step, straight into memory[]
+    const memory = new Array(S + kernel.states * LANES).fill(0);
+    const scalarSteps = Array.from({ length: voices }, (_, v) => {
+      const scalar = printStep(
+        kernel,
+        false,
+        `lanes_${v}`,
+        (k) => `memory[${S} + ${k * LANES + v}]`,
+        "x",
+        params.map((param) => `${param(v)}`),
+        context,
+      );
+      return new Function("memory", "x", `${scalar.code}return ${scalar.output};`);
+    });
+
+    const vectorOut: number[] = [];
+    const scalarOut: number[] = [];
+    for (let n = 0; n < samples; n++) {
+      for (let v = 0; v < voices; v++) heap[IN + v] = signal(n, v);
+      for (let v = 0; v < voices; v += WIDTH) {
+        vectorOut.push(...vectorStep(...Object.values(ops), 0, v).slice(0, voices - v));
+      }
+      for (let v = 0; v < voices; v++) scalarOut.push(scalarSteps[v](memory, signal(n, v)));
+    }
+    const stateOf = (m: number[]) =>
+      Array.from({ length: kernel.states }, (_, k) =>
+        m.slice(S + k * LANES, S + k * LANES + voices),
+      ).flat();
+    return [
+      [...vectorOut, ...stateOf(heap)],
+      [...scalarOut, ...stateOf(memory)],
+    ];
+  };
+
+  const expectParity = ([vector, scalar]: number[][]) => {
+    expect(vector.length).toBe(scalar.length);
+    expect(scalar.some((x) => x !== 0)).toBe(true);
+    vector.forEach((x, i) => {
+      expect(Math.abs(x - scalar[i])).toBeLessThan(1e-9);
+    });
+  };
+
+  it("steps onepole the same per lane as per voice", () => {
+    expectParity(run(onepoleKernel, [(v) => 0.1 + 0.15 * v]));
+  });
+
+  it("steps biquad the same per lane as per voice, for each mode", () => {
+    for (let mode = 0; mode <= 5; mode++) {
+      expectParity(
+        run(
+          biquadKernel,
+          [(v) => 300 + 700 * v, (v) => 0.5 + 0.3 * v, (v) => 1 - 0.1 * v, () => mode],
+          [3],
+        ),
+      );
+    }
+  });
+
+  it("steps svf the same per lane as per voice", () => {
+    expectParity(run(svfKernel, [(v) => 0.05 + 0.1 * v, (v) => 0.7 + 0.4 * v, (v) => v / 5]));
+  });
+
+  it("steps zdf the same per lane as per voice", () => {
+    expectParity(run(zdfKernel, [(v) => 200 + 900 * v, (v) => 0.5 * v]));
+  });
+});
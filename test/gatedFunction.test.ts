@@ -0,0 +1,128 @@
+import { describe, expect, it } from "bun:test";
+import { execFileSync } from "node:child_process";
+import { mkdtempSync, writeFileSync } from "node:fs";
+import { tmpdir } from "node:os";
+import { join } from "node:path";
+import {
+  abs,
+  accum,
+  add,
+  argument,
+  call,
+  defun,
+  div,
+  gatedDefun,
+  latch,
+  lt,
+  max,
+  mult,
+  nth,
+  output,
+  phasor,
+  sub,
+  wrap,
+  zenWithTarget,
+} from "../src/lib/zen/index";
+import type { UGen } from "../src/lib/zen/index";
+import { generateWASM } from "../src/lib/zen/wasm";
+import { Target } from "../src/lib/zen/targets";
+
+// the gate is only printed for C, so these build the native kernel with the system compiler
+const hasCompiler = (() => {
+  try {
+    execFileSync("cc", ["--version"], { stdio: "ignore" });
+    return true;
+  } catch {
+    return false;
+  }
+})();
+
+const INVOCATIONS = 4;
+
+// grains retriggered by a phasor: a window that's 0 again once acc passes 441
+const grains = (gated: boolean): UGen => {
+  const trig = argument(0, "trig");
+  const acc = accum(latch(argument(1, "rate"), trig), trig, { min: 0, max: 100000000 });
+  const win = max(0, sub(1, abs(sub(mult(div(acc, 441), 2), 1))));
+  const body = mult(win, 0.5);
+  const grain = gated
+    ? gatedDefun("grain", INVOCATIONS, { activity: win, wake: [0] }, body)
+    : defun("grain", INVOCATIONS, body);
+  const ph = phasor(50);
+  const voices = Array.from({ length: INVOCATIONS }, (_, i) => {
+    const fire = lt(wrap(add(ph, i / INVOCATIONS), 0, 1), 0.01);
+    return nth(call(grain, i, fire, 1 + i), 0);
+  });
+  return output(voices.reduce((a, b) => add(a, b)), 0);
+};
+
+// compiles the kernel with a main() that can reach its statics, and returns what it prints
+const run = (gated: boolean, main: string): string[] => {
+  const dir = mkdtempSync(join(tmpdir(), "zen-gate-"));
+  const kernel = generateWASM(zenWithTarget(Target.C, grains(gated)), Target.NativeC);
+  writeFileSync(join(dir, "kernel.c"), kernel);
+  writeFileSync(join(dir, "main.c"), `#include <stdio.h>\n#include "kernel.c"\n${main}`);
+  execFileSync("cc", ["-O2", "-w", "-o", join(dir, "main"), join(dir, "main.c"), "-lm"]);
+  return execFileSync(join(dir, "main")).toString().trim().split("\n");
+};
+
+describe("gated functions", () => {
+  it.skipIf(!hasCompiler)("render exactly what the ungated function renders", () => {
+    const render = `
+static float inputs[BLOCK_SIZE], outputs[BLOCK_SIZE];
+int main(void) {
+    initSineTable();
+    for (int b = 0; b < 200; b++) {
+        process(inputs, outputs, 0);
+        for (int j = 0; j < BLOCK_SIZE; j++) printf("%a\\n", outputs[j]);
+    }
+    return 0;
+}`;
+    const gated = run(true, render);
+    const ungated = run(false, render);
+    expect(gated.length).toBe(ungated.length);
+    expect(gated.some((x) => x !== "0x0p+0")).toBe(true);
+    gated.forEach((x, i) => expect(x).toBe(ungated[i]));
+  });
+
+  it.skipIf(!hasCompiler)("zero an idle invocation's slice, and wake it on its wake input", () => {
+    const lines = run(
+      true,
+      `
+static float zeros[BLOCK_SIZE], rate[BLOCK_SIZE], trig[BLOCK_SIZE], late[BLOCK_SIZE];
+static const int slice = 2 * BLOCK_SIZE;
+static int idle(int invocation) { return (grain_idle[0] >> invocation) & 1; }
+static int filled(int invocation, float value, int size) {
+    for (int j = 0; j < size; j++) {
+        if (grain_out[slice * invocation + j] != value) return 0;
+    }
+    return 1;
+}
+int main(void) {
+    initSineTable();
+    for (int j = 0; j < BLOCK_SIZE; j++) rate[j] = 1;
+    trig[0] = 1;
+    late[BLOCK_SIZE - 1] = 1;
+    grain(2, zeros, rate);
+    printf("%d\\n", idle(2));
+    for (int j = 0; j < 2 * slice; j++) grain_out[slice + j] = 7;
+    grain(2, zeros, rate);
+    printf("%d %d %d\\n", idle(2), filled(2, 0, slice), filled(1, 7, slice));
+    grain(2, trig, rate);
+    printf("%d %d\\n", idle(2), !filled(2, 0, BLOCK_SIZE));
+    grain(3, zeros, rate);
+    grain(3, late, rate);
+    printf("%d\\n", idle(3));
+    return 0;
+}`,
+    );
+    // a block with its activity all 0 marks the invocation idle
+    expect(lines[0]).toBe("1");
+    // an idle block returns straight away with only its own slice zeroed
+    expect(lines[1]).toBe("1 1 1");
+    // a trigger wakes it, and a block that ends active leaves it awake
+    expect(lines[2]).toBe("0 1");
+    // a trigger on the last sample keeps it awake for the block its activity rises in
+    expect(lines[3]).toBe("0");
+  });
+});
@@ -0,0 +1,66 @@
+import { describe, expect, it } from "bun:test";
+import {
+  call,
+  cycle,
+  defun,
+  message,
+  nth,
+  output,
+  parseMessageRate,
+  zenWithTarget,
+} from "../src/lib/zen/index";
+import { generateWASM } from "../src/lib/zen/wasm";
+import { Target } from "../src/lib/zen/targets";
+
+describe("parseMessageRate", () => {
+  it("parses each kind", () => {
+    expect(parseMessageRate("block")).toEqual({ kind: "block" });
+    expect(parseMessageRate("samples 1000")).toEqual({ kind: "samples", samples: 1000 });
+    expect(parseMessageRate("change 0.1")).toEqual({ kind: "change", threshold: 0.1 });
+  });
+
+  it("tolerates surrounding and repeated whitespace", () => {
+    expect(parseMessageRate("  samples   256 ")).toEqual({ kind: "samples", samples: 256 });
+    expect(parseMessageRate("\tchange\t0.5")).toEqual({ kind: "change", threshold: 0.5 });
+  });
+
+  it("needs a positive interval for samples", () => {
+    expect(parseMessageRate("samples")).toBeUndefined();
+    expect(parseMessageRate("samples 0")).toBeUndefined();
+    expect(parseMessageRate("samples -64")).toBeUndefined();
+    expect(parseMessageRate("samples often")).toBeUndefined();
+  });
+
+  it("defaults a missing or invalid change threshold to 0", () => {
+    expect(parseMessageRate("change")).toEqual({ kind: "change", threshold: 0 });
+    expect(parseMessageRate("change -1")).toEqual({ kind: "change", threshold: 0 });
+  });
+
+  it("leaves anything else undeclared", () => {
+    expect(parseMessageRate()).toBeUndefined();
+    expect(parseMessageRate("")).toBeUndefined();
+    expect(parseMessageRate("sometimes")).toBeUndefined();
+    expect(parseMessageRate("Block")).toBeUndefined();
+  });
+});
+
+describe("message rates", () => {
+  // a message in a scalar function body checks its rate every sample, against its counter
+  const printed = (blockSize: number) => {
+    const f = defun("meter", 1, message("level", 0, cycle(3)));
+    const graph = zenWithTarget(
+      Target.C,
+      output(nth(call(f, 0), 0), 0),
+      true,
+      "precise",
+      false,
+      blockSize,
+    );
+    return generateWASM(graph);
+  };
+
+  it("reports an undeclared per-sample message once per block's worth of samples", () => {
+    expect(printed(128)).toMatch(/\+= 1\) >= 128\)/);
+    expect(printed(32)).toMatch(/\+= 1\) >= 32\)/);
+  });
+});
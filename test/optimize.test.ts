@@ -0,0 +1,150 @@
+import { describe, expect, it } from "bun:test";
+// (first: it loads the zen index, which the block passes need initialized)
+import { block } from "./blocks";
+import { optimizeBlock } from "../src/lib/zen/blocks/optimize";
+
+// the printed lines of one block, reading x and y from other blocks
+const optimize = (code: string[], simd = false): string[] =>
+  optimizeBlock(block(code.join("\n"), { simd, inbound: ["x", "y"] })).code.split("\n");
+
+describe("optimizeBlock constant folding", () => {
+  it("folds float literals by precedence", () => {
+    expect(optimize(["float a = 1.5 * 2.0;"])).toEqual(["float a = 3;"]);
+    expect(optimize(["float a = (1.0 + 2.0) * -3.0;"])).toEqual(["float a = -9;"]);
+    expect(optimize(["float a = 1.0 - 2.0 - 3.0;"])).toEqual(["float a = -4;"]);
+    expect(optimize(["float a = 1e3 / 8.0;"])).toEqual(["float a = 125;"]);
+  });
+
+  it("folds int literals as int arithmetic", () => {
+    expect(optimize(["int n = 3 * 4 + 1;"])).toEqual(["int n = 13;"]);
+    expect(optimize(["int n = 2 - 3 * (4 - 1);"])).toEqual(["int n = -7;"]);
+  });
+
+  it("leaves integer division, which C truncates", () => {
+    expect(optimize(["int n = 7 / 2;"])).toEqual(["int n = 7 / 2;"]);
+    expect(optimize(["float a = 1 / 2;"])).toEqual(["float a = 1 / 2;"]);
+    expect(optimize(["float a = (1 / 2) * 1.0;"])).toEqual(["float a = (1 / 2) * 1.0;"]);
+  });
+
+  it("folds a division once either side is a float", () => {
+    expect(optimize(["float a = 1.0 / 2;"])).toEqual(["float a = 0.5;"]);
+  });
+
+  it("leaves int arithmetic that could overflow, and fractions assigned to ints", () => {
+    expect(optimize(["int n = 65536 * 65536;"])).toEqual(["int n = 65536 * 65536;"]);
+    expect(optimize(["int n = 3 * 0.5;"])).toEqual(["int n = 3 * 0.5;"]);
+  });
+
+  it("leaves anything that isn't a well formed expression of literals", () => {
+    expect(optimize(["float a = (1.0 + 2.0;"])).toEqual(["float a = (1.0 + 2.0;"]);
+    expect(optimize(["float a = 1.0 2.0;"])).toEqual(["float a = 1.0 2.0;"]);
+    expect(optimize(["float a = 1.0 / 0.0;"])).toEqual(["float a = 1.0 / 0.0;"]);
+  });
+
+  it("substitutes literal variables into a single operation", () => {
+    expect(optimize(["float a = 2.0;", "float b = a * 3.0;"])).toEqual([
+      "float a = 2;",
+      "float b = 6;",
+    ]);
+  });
+
+  it("prints a -0 result as a float", () => {
+    expect(optimize(["float a = 0.0 * -1.0;"])).toEqual(["float a = -0.0;"]);
+    expect(optimize(["int n = 0 * -1;"])).toEqual(["int n = 0;"]);
+  });
+});
+
+describe("optimizeBlock identities", () => {
+  it("keeps x + 0, which is +0 for x = -0", () => {
+    expect(optimize(["float a = x + 0.0;"])).toEqual(["float a = x + 0.0;"]);
+    expect(optimize(["float a = 0.0 + x;"])).toEqual(["float a = 0.0 + x;"]);
+    const vector = optimize(
+      ["v128_t z = wasm_f32x4_splat(0.0);", "v128_t a = wasm_f32x4_add(x, z);"],
+      true,
+    );
+    expect(vector).toContain("v128_t a = wasm_f32x4_add(x, constant_z);");
+  });
+
+  it("replaces x - 0, x + -0, x * 1 and x / 1 by x", () => {
+    expect(optimize(["float a = x - 0.0;", "float b = a * y;"])).toEqual([
+      "float a = x;",
+      "float b = x * y;",
+    ]);
+    expect(optimize(["float a = x + -0.0;"])).toEqual(["float a = x;"]);
+    expect(optimize(["float a = x * 1.0;"])).toEqual(["float a = x;"]);
+    expect(optimize(["float a = 1.0 * x;"])).toEqual(["float a = x;"]);
+    expect(optimize(["float a = x / 1.0;"])).toEqual(["float a = x;"]);
+    const vector = optimize(
+      ["v128_t z = wasm_f32x4_splat(0.0);", "v128_t a = wasm_f32x4_sub(x, z);"],
+      true,
+    );
+    expect(vector).toContain("v128_t a = x;");
+  });
+});
+
+describe("optimizeBlock common subexpressions", () => {
+  it("reuses a value computed in an enclosing scope, but not one from a closed scope", () => {
+    expect(
+      optimize([
+        "float a = x * y;",
+        "if (x > 0.0) {",
+        "float b = x * y;",
+        "float c = x + y;",
+        "}",
+        "float d = x + y;",
+      ]),
+    ).toEqual([
+      "float a = x * y;",
+      "if (x > 0.0) {",
+      "float b = a;",
+      "float c = x + y;",
+      "}",
+      "float d = x + y;",
+    ]);
+  });
+
+  it("leaves loads and reassigned variables alone", () => {
+    const code = [
+      "float a = memory[3] * x;",
+      "float b = memory[3] * x;",
+      "float c = y * 2.0;",
+      "y = 1.0;",
+      "float d = y * 2.0;",
+    ];
+    expect(optimize(code)).toEqual(code);
+  });
+});
+
+describe("optimizeBlock hoisting", () => {
+  it("hoists SIMD values of uniforms and constants out of the sample loop", () => {
+    expect(
+      optimize(
+        [
+          "v128_t g = wasm_f32x4_mul(uniform_gain, constant_half);",
+          "v128_t h = wasm_f32x4_mul(constant_half, constant_half);",
+          "v128_t a = wasm_f32x4_mul(x, g);",
+        ],
+        true,
+      ),
+    ).toEqual([
+      "v128_t uniform_g = wasm_f32x4_mul(uniform_gain, constant_half);",
+      "v128_t g = uniform_g;",
+      "v128_t constant_h = wasm_f32x4_mul(constant_half, constant_half);",
+      "v128_t h = constant_h;",
+      "v128_t a = wasm_f32x4_mul(x, uniform_g);",
+    ]);
+  });
+
+  it("leaves values that read the sample, sit in a scope, or are scalar", () => {
+    const code = [
+      "v128_t a = wasm_f32x4_mul(x, uniform_gain);",
+      "if (flag) {",
+      "v128_t b = wasm_f32x4_mul(uniform_gain, constant_half);",
+      "}",
+    ];
+    expect(optimize(code, true)).toEqual(code);
+    expect(optimize(["float g = uniform_gain * constant_half;"])).toEqual([
+      "float g = uniform_gain * constant_half;",
+    ]);
+  });
+});
@@ -0,0 +1,291 @@
+import { describe, expect, it } from "bun:test";
+import {
+  Context,
+  add,
+  argument,
+  data,
+  defun,
+  gt,
+  history,
+  latchcall,
+  input,
+  mult,
+  output,
+  peek,
+  phasor,
+  zenWithTarget,
+} from "../src/lib/zen/index";
+import { promoteState } from "../src/lib/zen/blocks/promote";
+import { POKE } from "../src/lib/zen/data";
+import { LATCH_CALL } from "../src/lib/zen/functions";
+import { generateWASM } from "../src/lib/zen/wasm";
+import { Target } from "../src/lib/zen/targets";
+
+// a context with buffers of these sizes allocated, and where each starts
+const buffers = (...sizes: number[]): [Context, number[]] => {
+  const context = new Context(Target.C);
+  return [context, sizes.map((size) => context.alloc(size).idx as number)];
+};
+
+const promote = (body: string[], context = new Context(Target.C)) =>
+  promoteState(body.join("\n"), context);
+
+const lines = (code: string) => code.split("\n");
+
+describe("promoteState", () => {
+  it("keeps constant cells in locals, storing back only what the loop writes", () => {
+    const promoted = promote([
+      "float h = memory[9];",
+      "memory[9] = h + x;",
+      "float g = memory[4] * memory[ 9 ];",
+    ])!;
+    expect(lines(promoted.load)).toEqual([
+      "float zen_state0 = memory[9];",
+      "float zen_state1 = memory[4];",
+    ]);
+    expect(lines(promoted.body)).toEqual([
+      "float h = zen_state0;",
+      "zen_state0 = h + x;",
+      "float g = zen_state1 * zen_state0;",
+    ]);
+    expect(promoted.store).toBe("memory[9] = zen_state0;");
+  });
+
+  it("keeps a user function's per-invocation cells apart from plain ones", () => {
+    const promoted = promote(["memory[9 + 2*invocation] = memory[9] + x;"])!;
+    expect(lines(promoted.load)).toEqual([
+      "float zen_state0 = memory[9 + 2*invocation];",
+      "float zen_state1 = memory[9];",
+    ]);
+    expect(promoted.body).toBe("zen_state0 = zen_state1 + x;");
+    expect(promoted.store).toBe("memory[9 + 2*invocation] = zen_state0;");
+  });
+
+  it("returns nothing when there's no constant cell", () => {
+    expect(promote(["float a = x * 2.0;"])).toBeUndefined();
+  });
+
+  it("counts ++, -- and compound assignments as writes, and comparisons as reads", () => {
+    const promoted = promote([
+      "memory[3]++;",
+      "--memory[4];",
+      "memory[5] += x;",
+      "memory[6] *= x;",
+      "if (memory[7] == x) y = 1.0;",
+      "if (memory[8] <= x) y = memory[10] >= x;",
+    ])!;
+    expect(lines(promoted.store)).toEqual([
+      "memory[3] = zen_state0;",
+      "memory[4] = zen_state1;",
+      "memory[5] = zen_state2;",
+      "memory[6] = zen_state3;",
+    ]);
+    expect(lines(promoted.body)).toEqual([
+      "zen_state0++;",
+      "--zen_state1;",
+      "zen_state2 += x;",
+      "zen_state3 *= x;",
+      "if (zen_state4 == x) y = 1.0;",
+      "if (zen_state5 <= x) y = zen_state6 >= x;",
+    ]);
+  });
+
+  it("doesn't promote a loop that pokes", () => {
+    expect(
+      promote([
+        "memory[3] = x;",
+        POKE,
+        "int pokeIdx_2_1 = 12 + 1 * 0 + floor(y);",
+        "memory[pokeIdx_2_1] = x;",
+        "// end poke",
+      ]),
+    ).toBeUndefined();
+  });
+
+  it("doesn't promote a loop that calls a user function", () => {
+    expect(
+      promote([
+        "memory[3] = x;",
+        LATCH_CALL,
+        "if (cond > 0) {",
+        "    grain (0, x);",
+        "memory[4] = grain_out[0];",
+        "}",
+      ]),
+    ).toBeUndefined();
+  });
+});
+
+describe("promoteState computed indices", () => {
+  it("promotes nothing next to an index it can't trace to a base", () => {
+    // unsafeMemoryFetch, and indices from values computed elsewhere
+    expect(promote(["float fetchVal = memory[i];", "memory[3] = fetchVal;"])).toBeUndefined();
+    expect(
+      promote(["int i = floor(x * 8.0);", "float a = memory[i];", "memory[3] = a;"]),
+    ).toBeUndefined();
+  });
+
+  it("follows a delay's read position back to its buffer", () => {
+    const [context, [h, counter, buffer]] = buffers(1, 1, 16);
+    const promoted = promote(
+      [
+        `float accum = memory[${counter}];`,
+        `memory[${counter}] = accum + 1.0;`,
+        `int index = ${buffer} + (accum);`,
+        "memory[index] = x;",
+        "float delayIndex = index - 10.0;",
+        "int flooredName = floor(delayIndex);",
+        "int nextIdx = flooredName + 1;",
+        "float y = memory[flooredName] + memory[nextIdx];",
+        `memory[${buffer + 4}] = memory[${h}];`,
+        `memory[${h}] = y;`,
+      ],
+      context,
+    )!;
+    expect(lines(promoted.store)).toEqual([
+      `memory[${counter}] = zen_state0;`,
+      `memory[${h}] = zen_state1;`,
+    ]);
+    expect(lines(promoted.body)[8]).toBe(`memory[${buffer + 4}] = zen_state1;`);
+  });
+
+  it("leaves a cell a peek on the same buffer reads", () => {
+    const [context, [h, buffer]] = buffers(1, 8);
+    // a linear peek, reaching its buffer through a variable
+    const promoted = promote(
+      [
+        `memory[${buffer + 2}] = memory[${h}];`,
+        `int peekIdx_2 = ${buffer} + floor(p);`,
+        `int peekIdx_3 = ${buffer} + nextIdx;`,
+        "float peekVal = (1 - frac)*memory[peekIdx_2] + (frac)*memory[peekIdx_3];",
+        `memory[${h}] = peekVal;`,
+      ],
+      context,
+    )!;
+    expect(promoted.load).toBe(`float zen_state0 = memory[${h}];`);
+    expect(lines(promoted.body)[0]).toBe(`memory[${buffer + 2}] = zen_state0;`);
+    expect(promoted.store).toBe(`memory[${h}] = zen_state0;`);
+  });
+
+  it("leaves cells a hermite peek or a delay reads with a constant base", () => {
+    const [context, [h, buffer]] = buffers(1, 8);
+    const promoted = promote(
+      [
+        `memory[${buffer + 7}] = memory[${h}];`,
+        `float y = memory[${buffer} + channelStart + hermiteIdx_1];`,
+        `memory[${h}] = y;`,
+      ],
+      context,
+    )!;
+    expect(lines(promoted.body)[0]).toBe(`memory[${buffer + 7}] = zen_state0;`);
+  });
+
+  it("covers only the block at a known base, and everything past an unknown one", () => {
+    const [context, [buffer, after]] = buffers(4, 1);
+    const known = promote(
+      [
+        `float a = memory[${buffer} + i];`,
+        `memory[${buffer + 3}] = a;`,
+        `memory[${after}] = a;`,
+      ],
+      context,
+    )!;
+    expect(known.store).toBe(`memory[${after}] = zen_state0;`);
+
+    const unknown = promote(["float a = memory[50 + i];", "memory[49] = a;", "memory[51] = a;"])!;
+    expect(unknown.store).toBe("memory[49] = zen_state0;");
+  });
+
+  it("leaves the lanes a filter bank reaches through memory + N + v", () => {
+    const [context, [state, h]] = buffers(64, 1);
+    const promoted = promote(
+      [
+        `float s = zen_onepole(memory + ${state} + 16 + v, x);`,
+        `memory[${state + 16}] = memory[${h}];`,
+        `memory[${h}] = s;`,
+      ],
+      context,
+    )!;
+    expect(promoted.load).toBe(`float zen_state0 = memory[${h}];`);
+    expect(lines(promoted.body)[1]).toBe(`memory[${state + 16}] = zen_state0;`);
+  });
+
+  it("leaves a param's cell when the loop reads it through its lane", () => {
+    const promoted = promote([
+      "float p = ZEN_LANE(0, 30);",
+      "memory[30] = memory[31] + p;",
+      "memory[31] = p;",
+    ])!;
+    expect(promoted.store).toBe("memory[31] = zen_state0;");
+    expect(lines(promoted.body)[1]).toBe("memory[30] = zen_state0 + p;");
+  });
+});
+
+describe("promoteState f64 cells", () => {
+  it("keeps an f64 cell in a zen_f64 local", () => {
+    const promoted = promote([
+      "zen_f64 a = zen_load_f64(memory + 20) + x;",
+      "zen_store_f64(memory + 20, a);",
+      "float b = memory[4];",
+    ])!;
+    expect(lines(promoted.load)).toEqual([
+      "float zen_state1 = memory[4];",
+      "zen_f64 zen_state0 = zen_load_f64(memory + 20);",
+    ]);
+    expect(lines(promoted.body)).toEqual([
+      "zen_f64 a = zen_state0 + x;",
+      "zen_state0 = a;",
+      "float b = zen_state1;",
+    ]);
+    expect(promoted.store).toBe("zen_store_f64(memory + 20, zen_state0);");
+  });
+
+  it("doesn't store an f64 cell the loop only reads", () => {
+    const promoted = promote(["zen_f64 a = zen_load_f64(memory + 20 + 2*invocation);"])!;
+    expect(promoted.load).toBe("zen_f64 zen_state0 = zen_load_f64(memory + 20 + 2*invocation);");
+    expect(promoted.store).toBe("");
+  });
+
+  it("leaves an f64 cell that overlaps a computed range", () => {
+    const [context, [buffer]] = buffers(4);
+    const promoted = promote(
+      [
+        `float a = memory[${buffer} + i];`,
+        `zen_store_f64(memory + ${buffer + 3}, a);`,
+        "memory[40] = a;",
+      ],
+      context,
+    )!;
+    expect(promoted.store).toBe("memory[40] = zen_state0;");
+    expect(lines(promoted.body)[1]).toBe(`zen_store_f64(memory + ${buffer + 3}, a);`);
+  });
+});
+
+describe("promoted kernels", () => {
+  it("leaves a loop that latch-calls a user function in memory", () => {
+    const h = history();
+    const grain = defun("grain", 2, mult(h(add(h(), argument(0, "x"))), 0.5));
+    const fired = latchcall(grain, 0, gt(phasor(2), 0.5), input(0));
+    const code = generateWASM(zenWithTarget(Target.C, output(add(fired, phasor(3)), 0), true));
+    expect(code).toContain(LATCH_CALL);
+    expect(code).not.toContain("zen_state");
+  });
+
+  it("keeps a history beside a peek in a local, and the peek in memory", () => {
+    const h = history();
+    const graph = zenWithTarget(
+      Target.C,
+      output(add(peek(data(8, 1), mult(phasor(1), 8), 0), h(add(h(), input(0)))), 0),
+      true,
+    );
+    const code = generateWASM(graph);
+    const cell = code.match(/float zen_state\d+ = memory\[(\d+)\];/g)!;
+    expect(cell.length).toBeGreaterThan(0);
+    expect(code).toMatch(/\*memory\[peekIdx_2\d*\]/);
+    for (const load of cell) {
+      const idx = parseInt(load.match(/memory\[(\d+)\]/)![1]);
+      const buffer = graph.context.memory.blocksInUse.find((b) => b.length === 8)!;
+      expect(idx < (buffer.idx as number) || idx >= (buffer.idx as number) + 8).toBe(true);
+    }
+  });
+});
@@ -0,0 +1,134 @@
+import { describe, expect, it } from "bun:test";
+import {
+  accum,
+  add,
+  history,
+  input,
+  latch,
+  output,
+  phasor,
+  zenWithTarget,
+} from "../src/lib/zen/index";
+import type { UGen, ZenGraph } from "../src/lib/zen/index";
+import { planStateMigration } from "../src/lib/zen/memory/migrate";
+import { attributeUGens } from "../src/lib/zen/memory/profile";
+import { peekUUID } from "../src/lib/zen/uuid";
+import { Target } from "../src/lib/zen/targets";
+
+// builds a UGen the way a patch node does, so the UGens it creates belong to node id
+const node = (id: string, build: () => UGen): UGen => {
+  const first = peekUUID();
+  const ugen = build();
+  attributeUGens(first, peekUUID(), id);
+  return ugen;
+};
+
+const nodes: Record<string, () => UGen> = {
+  osc: () => node("osc", () => phasor(220)),
+  env: () => node("env", () => accum(1, input(1), { min: 0, max: 1000 })),
+  hold: () => node("hold", () => latch(input(0), input(1))),
+  lfo: () => node("lfo", () => phasor(3)),
+};
+
+const patch = (...ids: string[]): ZenGraph =>
+  zenWithTarget(Target.C, output(ids.map((id) => nodes[id]()).reduce((a, b) => add(a, b)), 0));
+
+// every cell of the new kernel's state the migration fills, and where from
+const copies = (previous: ZenGraph, next: ZenGraph): Map<number, number> => {
+  const cells = new Map<number, number>();
+  for (const { from, to, size } of planStateMigration(previous.context, next.context)) {
+    for (let i = 0; i < size; i++) {
+      cells.set(to + i, from + i);
+    }
+  }
+  return cells;
+};
+
+// where an owner's blocks live
+const cellsOf = (graph: ZenGraph, owner: string): number[] =>
+  graph.context.memory.blocksInUse
+    .filter((block) => block.owner === owner)
+    .flatMap((block) =>
+      Array.from({ length: block.allocatedSize }, (_, i) => (block.idx as number) + i),
+    );
+
+const expectCarried = (previous: ZenGraph, next: ZenGraph, ids: string[]) => {
+  const expected = new Map<number, number>();
+  for (const id of ids) {
+    const from = cellsOf(previous, `node ${id}`);
+    const to = cellsOf(next, `node ${id}`);
+    expect(from.length).toBeGreaterThan(0);
+    expect(to.length).toBe(from.length);
+    to.forEach((cell, i) => expected.set(cell, from[i]));
+  }
+  expect(Array.from(copies(previous, next).entries()).sort((a, b) => a[0] - b[0])).toEqual(
+    Array.from(expected.entries()).sort((a, b) => a[0] - b[0]),
+  );
+};
+
+describe("planStateMigration", () => {
+  it("carries everything over when nothing changed", () => {
+    expectCarried(patch("osc", "env", "hold"), patch("osc", "env", "hold"), [
+      "osc",
+      "env",
+      "hold",
+    ]);
+  });
+
+  it("follows each node when one is inserted before them", () => {
+    const previous = patch("osc", "env", "hold");
+    const next = patch("lfo", "osc", "env", "hold");
+    expect(cellsOf(next, "node osc")).not.toEqual(cellsOf(previous, "node osc"));
+    expectCarried(previous, next, ["osc", "env", "hold"]);
+  });
+
+  it("drops only the state of a deleted node", () => {
+    expectCarried(patch("osc", "env", "hold"), patch("osc", "hold"), ["osc", "hold"]);
+  });
+
+  it("follows nodes that are reordered", () => {
+    const previous = patch("osc", "env", "hold");
+    const next = patch("hold", "env", "osc");
+    expect(cellsOf(next, "node osc")).not.toEqual(cellsOf(previous, "node osc"));
+    expectCarried(previous, next, ["osc", "env", "hold"]);
+  });
+
+  it("starts a node whose state changed shape from zero", () => {
+    const previous = patch("osc", "env");
+    const wide = zenWithTarget(
+      Target.C,
+      output(
+        add(
+          nodes.osc(),
+          node("env", () => accum(1, input(1), { min: 0, max: 1000, precision: "f64" })),
+        ),
+        0,
+      ),
+    );
+    expectCarried(previous, wide, ["osc"]);
+  });
+
+  it("matches histories outside a patch by their debug name", () => {
+    const feedback = (name: string) => {
+      const h = history(0, undefined, name);
+      return h(add(h(), input(0)));
+    };
+    const graph = (...names: string[]) =>
+      zenWithTarget(Target.C, output(names.map(feedback).reduce((a, b) => add(a, b)), 0));
+    const previous = graph("a", "b");
+    const next = graph("c", "b", "a");
+    const expected = new Map<number, number>();
+    for (const name of ["a", "b"]) {
+      const [from] = cellsOf(previous, `history ${name}`);
+      const [to] = cellsOf(next, `history ${name}`);
+      expected.set(to, from);
+    }
+    expect(copies(previous, next)).toEqual(expected);
+  });
+
+  it("doesn't guess for state nothing identifies", () => {
+    const graph = () =>
+      zenWithTarget(Target.C, output(add(phasor(220), accum(1, 0, { min: 0, max: 10 })), 0));
+    expect(planStateMigration(graph().context, graph().context)).toEqual([]);
+  });
+});
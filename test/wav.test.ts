@@ -0,0 +1,37 @@
+import { describe, expect, it } from "bun:test";
+import { maxWavFrames, WavWriter, wavHeader } from "../src/utils/wav";
+
+describe("wavHeader", () => {
+  it("writes the RIFF and data sizes of a float WAV", () => {
+    const header = new DataView(wavHeader(2, 48000, 1000));
+    expect(header.byteLength).toBe(44);
+    expect(header.getUint32(4, true)).toBe(36 + 8000);
+    expect(header.getUint32(40, true)).toBe(8000);
+    expect(header.getUint16(20, true)).toBe(3);
+  });
+
+  it("rejects a file whose sizes don't fit 32 bits", () => {
+    const frames = maxWavFrames(2);
+    expect(new DataView(wavHeader(2, 48000, frames)).getUint32(4, true)).toBe(36 + frames * 8);
+    expect(() => wavHeader(2, 48000, frames + 1)).toThrow();
+    expect(() => wavHeader(1, 48000, 2 ** 30)).toThrow();
+  });
+});
+
+describe("WavWriter", () => {
+  it("interleaves planar blocks across its parts", async () => {
+    const writer = new WavWriter(2, 48000, 3);
+    const planar = new Float32Array([1, 2, 3, 4, 5, 0, 0, 0, -1, -2, -3, -4, -5, 0, 0, 0]);
+    writer.write(planar, 5, 8);
+    const bytes = await writer.finish().arrayBuffer();
+    expect(bytes.byteLength).toBe(44 + 5 * 2 * 4);
+    expect(Array.from(new Float32Array(bytes, 44))).toEqual([1, -1, 2, -2, 3, -3, 4, -4, 5, -5]);
+  });
+
+  it("stops before the file grows past 4GB", () => {
+    const writer = new WavWriter(2, 48000, 1);
+    writer.frames = maxWavFrames(2) - 1;
+    writer.write(new Float32Array(2), 1);
+    expect(() => writer.write(new Float32Array(2), 1)).toThrow();
+  });
+});
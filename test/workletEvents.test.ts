@@ -0,0 +1,76 @@
+import { describe, expect, it } from "bun:test";
+import { input, output, param, mult, zenWithTarget } from "../src/lib/zen/index";
+import { createWorkletCode } from "../src/lib/zen/createWorkletCode";
+import { EVENT_RING_SIZE, EVENT_STRIDE } from "../src/lib/zen/memory/automation";
+import { Target } from "../src/lib/zen/targets";
+
+// the generated processor, with its kernel's event ring in a plain buffer
+const processor = () => {
+  const graph = zenWithTarget(Target.C, output(mult(input(0), param(0.5, "gain")), 0));
+  const { code } = createWorkletCode("Test", graph);
+  class AudioWorkletProcessor {
+    port = { postMessage: () => {} } as any;
+  }
+  let Processor: any;
+  new Function("AudioWorkletProcessor", "registerProcessor", "sampleRate", code)(
+    AudioWorkletProcessor,
+    (_: string, c: any) => (Processor = c),
+    44100,
+  );
+  const p = new Processor({});
+  const ring = new ArrayBuffer(8 + EVENT_RING_SIZE * EVENT_STRIDE * 4);
+  p.wasmModule = { exports: {} };
+  p.eventIndices = new Uint32Array(ring, 0, 2);
+  p.eventInts = new Int32Array(ring, 8);
+  p.eventFloats = new Float32Array(ring, 8);
+  const set = (idx: number, value: number) =>
+    p.port.onmessage({ data: { type: "memory-set", body: { idx, value } } });
+  // what the kernel would apply next, in order
+  const pending = () => {
+    const values: number[] = [];
+    for (let i = p.eventIndices[1]; i < p.eventIndices[0]; i++) {
+      values.push(p.eventFloats[(i % EVENT_RING_SIZE) * EVENT_STRIDE + 2]);
+    }
+    return values;
+  };
+  // process() empties the ring
+  const drain = () => {
+    p.eventIndices[1] = p.eventIndices[0];
+  };
+  return { p, set, pending, drain };
+};
+
+describe("memory-set", () => {
+  it("writes straight into the ring when there's room", () => {
+    const { set, pending } = processor();
+    set(5, 1);
+    set(5, 2);
+    expect(pending()).toEqual([1, 2]);
+  });
+
+  it("keeps the order of writes that find the ring full", () => {
+    const { p, set, pending, drain } = processor();
+    p.eventIndices[0] = EVENT_RING_SIZE;
+    set(5, 1);
+    set(5, 2);
+    drain();
+    // room again, but it has to wait behind the writes already queued
+    set(5, 3);
+    expect(pending()).toEqual([]);
+    p.scheduleEvents(128);
+    expect(pending()).toEqual([1, 2, 3]);
+    expect(p.events.length).toBe(0);
+  });
+
+  it("keeps writes queued while the ring stays full", () => {
+    const { p, set, pending, drain } = processor();
+    p.eventIndices[0] = EVENT_RING_SIZE;
+    set(5, 1);
+    p.scheduleEvents(128);
+    expect(p.events.length).toBe(1);
+    set(5, 2);
+    drain();
+    p.scheduleEvents(128);
+    expect(pending()).toEqual([1, 2]);
+  });
+});
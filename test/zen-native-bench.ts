@@ -0,0 +1,81 @@
+/**
+ * Offline benchmark for the generated DSP kernel, built natively instead of through
+ * emscripten so the hot loop can be profiled with perf and compiled with different flags.
+ *
+ *   bun run test/zen-native-bench.ts [patch] [seconds]
+ *
+ * CC and CFLAGS are read from the environment (default: cc -O3 -march=native).
+ * WIDTH=4|8|16 forces the SIMD width instead of taking the widest one -march allows.
+ * DISPATCH=1 builds the kernel once per x86 ISA level and lets the harness pick at runtime.
+ * OPENMP=1 builds with -fopenmp, so batches of independent function calls run on a thread pool.
+ * BLOCK=32|512|... (or a profile: low-latency, realtime, throughput, offline) sets the
+ * samples per process() call.
+ * Set KEEP=1 to keep the generated kernel.c/main.c around for inspection.
+ */
+import { execSync } from "node:child_process";
+import { mkdtempSync, rmSync, writeFileSync } from "node:fs";
+import { tmpdir } from "node:os";
+import { join } from "node:path";
+import { zenWithTarget } from "../src/lib/zen/index";
+import { BLOCK_PROFILES, DEFAULT_BLOCK_SIZE, type BlockProfile } from "../src/lib/zen/blockSize";
+import { generateNativeC } from "../src/lib/zen/wasm";
+import { parseMessages } from "../src/lib/zen/worklet";
+import { Target } from "../src/lib/zen/targets";
+import { printNativeHarness } from "../src/lib/zen/native/harness";
+import { patches } from "./zen-native-patches";
+
+const name = process.argv[2] || "additive";
+const seconds = process.argv[3] || "30";
+const patch = patches[name];
+if (!patch) {
+  console.log(`unknown patch "${name}", expected one of: ${Object.keys(patches).join(", ")}`);
+  process.exit(1);
+}
+
+const block = process.env.BLOCK;
+const blockSize =
+  BLOCK_PROFILES[block as BlockProfile] || (block ? parseInt(block) : DEFAULT_BLOCK_SIZE);
+const graph = zenWithTarget(Target.C, patch(), false, "precise", false, blockSize);
+const dir = mkdtempSync(join(tmpdir(), "zen-native-"));
+const kernel = parseMessages(Target.C, generateNativeC(graph), {
+  code: "",
+  messageConstants: [],
+  messageIdx: 1,
+  messageArray: "",
+});
+writeFileSync(join(dir, "kernel.c"), kernel.code);
+writeFileSync(join(dir, "main.c"), printNativeHarness(graph));
+
+const cc = process.env.CC || "cc";
+const width = process.env.WIDTH ? ` -DZEN_SIMD_WIDTH=${process.env.WIDTH}` : "";
+const openmp = process.env.OPENMP ? " -fopenmp" : "";
+if (process.env.DISPATCH) {
+  const cflags = (process.env.CFLAGS || "-O3") + openmp;
+  const levels: Record<string, string> = {
+    sse: "x86-64-v2",
+    avx2: "x86-64-v3",
+    avx512: "x86-64-v4",
+  };
+  for (const isa in levels) {
+    execSync(
+      `${cc} ${cflags} -march=${levels[isa]} -fPIC -shared -Wall -Wextra kernel.c -lm -o zen-kernel-${isa}.so`,
+      { cwd: dir, stdio: "inherit" },
+    );
+  }
+  execSync(`${cc} ${cflags} -DZEN_DISPATCH -Wall -Wextra main.c -lm -ldl -o zen-bench`, {
+    cwd: dir,
+    stdio: "inherit",
+  });
+  console.log(`${name}: ${cc} ${cflags} (runtime dispatch), ${blockSize} sample blocks`);
+} else {
+  const cflags = (process.env.CFLAGS || "-O3 -march=native") + width + openmp;
+  execSync(`${cc} ${cflags} -Wall -Wextra kernel.c main.c -lm -o zen-bench`, { cwd: dir, stdio: "inherit" });
+  console.log(`${name}: ${cc} ${cflags}, ${blockSize} sample blocks`);
+}
+execSync(`./zen-bench ${seconds}`, { cwd: dir, stdio: "inherit" });
+
+if (process.env.KEEP) {
+  console.log(`kept ${dir}`);
+} else {
+  rmSync(dir, { recursive: true, force: true });
+}
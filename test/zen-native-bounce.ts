@@ -0,0 +1,85 @@
+/**
+ * Bounces patches to float WAVs with the native harness, faster than realtime and one
+ * process per patch, as many at a time as there are cores: kernels keep their state in
+ * globals, so separate renders parallelize across processes rather than threads.
+ *
+ *   bun run test/zen-native-bounce.ts [seconds] [out-dir] [patch...]
+ *
+ * Every patch is bounced when none are named. CC and CFLAGS are read from the
+ * environment (default: cc -O3 -march=native). Kernels are compiled with 1024 sample
+ * blocks (the offline profile), or BLOCK=N.
+ */
+import { exec } from "node:child_process";
+import { mkdirSync, mkdtempSync, rmSync, writeFileSync } from "node:fs";
+import { cpus, tmpdir } from "node:os";
+import { join, resolve } from "node:path";
+import { zenWithTarget } from "../src/lib/zen/index";
+import { BLOCK_PROFILES } from "../src/lib/zen/blockSize";
+import { generateNativeC } from "../src/lib/zen/wasm";
+import { parseMessages } from "../src/lib/zen/worklet";
+import { Target } from "../src/lib/zen/targets";
+import { printNativeHarness } from "../src/lib/zen/native/harness";
+import { patches } from "./zen-native-patches";
+
+const seconds = process.argv[2] || "30";
+const out = resolve(process.argv[3] || "bounces");
+const names = process.argv.length > 4 ? process.argv.slice(4) : Object.keys(patches);
+for (const name of names) {
+  if (!patches[name]) {
+    console.log(`unknown patch "${name}", expected one of: ${Object.keys(patches).join(", ")}`);
+    process.exit(1);
+  }
+}
+mkdirSync(out, { recursive: true });
+
+const cc = process.env.CC || "cc";
+const cflags = process.env.CFLAGS || "-O3 -march=native";
+const blockSize = process.env.BLOCK ? parseInt(process.env.BLOCK) : BLOCK_PROFILES.offline;
+const dir = mkdtempSync(join(tmpdir(), "zen-bounce-"));
+
+// the graphs are built one after another (zen() isn't reentrant), the renders in parallel
+const builds = names.map((name) => {
+  const graph = zenWithTarget(Target.C, patches[name](), false, "precise", false, blockSize);
+  const kernel = parseMessages(Target.C, generateNativeC(graph), {
+    code: "",
+    messageConstants: [],
+    messageIdx: 1,
+    messageArray: "",
+  });
+  writeFileSync(join(dir, `${name}.c`), kernel.code);
+  writeFileSync(join(dir, `${name}-main.c`), printNativeHarness(graph));
+  return name;
+});
+
+const run = (command: string) =>
+  new Promise<string>((done, fail) =>
+    exec(command, { cwd: dir }, (error, stdout, stderr) => {
+      process.stderr.write(stderr); // compiler warnings
+      return error ? fail(error) : done(stdout);
+    }),
+  );
+
+const bounce = async (name: string) => {
+  await run(`${cc} ${cflags} -Wall -Wextra ${name}.c ${name}-main.c -lm -o ${name}`);
+  const report = await run(`./${name} ${seconds} ${join(out, `${name}.wav`)}`);
+  const speed = report.match(/\(([\d.]+x) realtime\)/);
+  console.log(`${name}.wav: ${speed ? speed[1] : "?"} realtime`);
+};
+
+const started = Date.now();
+const queue = [...builds];
+const workers = Array.from({ length: Math.min(cpus().length, queue.length) }, async () => {
+  for (let name = queue.shift(); name; name = queue.shift()) {
+    await bounce(name);
+  }
+});
+Promise.all(workers)
+  .then(() => {
+    const took = (Date.now() - started) / 1000;
+    console.log(`bounced ${builds.length} patches (${seconds}s each) in ${took}s to ${out}`);
+  })
+  .catch((e) => {
+    console.error(e.message);
+    process.exitCode = 1;
+  })
+  .finally(() => rmSync(dir, { recursive: true, force: true }));
@@ -0,0 +1,74 @@
+/**
+ * Shows what flushing denormals buys a patch going quiet: the same kernel is built three
+ * times and timed over a render that is almost all decaying tail.
+ *
+ *   bun run test/zen-native-denormals.ts [patch=quietTail] [seconds=30]
+ *
+ *   ftz        the default: FTZ/DAZ set for the length of process()
+ *   snap       -DZEN_NO_FTZ: feedback writes snapped to 0 instead, as on wasm
+ *   denormals  -DZEN_ALLOW_DENORMALS: neither, the tail runs on subnormals
+ *
+ * CC and CFLAGS are read from the environment (default: cc -O3 -march=native).
+ */
+import { execSync } from "node:child_process";
+import { mkdtempSync, rmSync, writeFileSync } from "node:fs";
+import { tmpdir } from "node:os";
+import { join } from "node:path";
+import { zen } from "../src/lib/zen/index";
+import { generateNativeC } from "../src/lib/zen/wasm";
+import { parseMessages } from "../src/lib/zen/worklet";
+import { Target } from "../src/lib/zen/targets";
+import { printNativeHarness } from "../src/lib/zen/native/harness";
+import { patches } from "./zen-native-patches";
+
+const name = process.argv[2] || "quietTail";
+const seconds = process.argv[3] || "30";
+const patch = patches[name];
+if (!patch) {
+  console.log(`unknown patch "${name}", expected one of: ${Object.keys(patches).join(", ")}`);
+  process.exit(1);
+}
+
+const graph = zen(patch());
+const dir = mkdtempSync(join(tmpdir(), "zen-denormals-"));
+const kernel = parseMessages(Target.C, generateNativeC(graph), {
+  code: "",
+  messageConstants: [],
+  messageIdx: 1,
+  messageArray: "",
+});
+writeFileSync(join(dir, "kernel.c"), kernel.code);
+writeFileSync(join(dir, "main.c"), printNativeHarness(graph));
+
+const cc = process.env.CC || "cc";
+const cflags = process.env.CFLAGS || "-O3 -march=native";
+const variants: Record<string, string> = {
+  ftz: "",
+  snap: "-DZEN_NO_FTZ",
+  denormals: "-DZEN_ALLOW_DENORMALS",
+};
+
+console.log(`${name}: ${cc} ${cflags}, ${seconds}s`);
+const averages: Record<string, number> = {};
+for (const variant in variants) {
+  execSync(`${cc} ${cflags} ${variants[variant]} -Wall -Wextra kernel.c main.c -lm -o zen-${variant}`, {
+    cwd: dir,
+    stdio: "inherit",
+  });
+  const report = execSync(`./zen-${variant} ${seconds}`, { cwd: dir }).toString();
+  const timing = report.match(/ns\/block: ([\d.]+) avg, ([\d.]+) worst/);
+  const checksum = report.match(/checksum: (\S+)/);
+  if (!timing) {
+    console.log(report);
+    process.exit(1);
+  }
+  averages[variant] = parseFloat(timing[1]);
+  console.log(
+    `${variant.padEnd(10)} ${timing[1].padStart(10)} ns/block avg ${timing[2].padStart(10)} worst   checksum ${checksum?.[1]}`,
+  );
+}
+console.log(
+  `running on subnormals: ${(averages.denormals / averages.ftz).toFixed(1)}x the time of ftz, ${(averages.denormals / averages.snap).toFixed(1)}x that of snap`,
+);
+
+rmSync(dir, { recursive: true, force: true });
@@ -0,0 +1,91 @@
+/**
+ * The patches rendered by the native bench and bounce scripts.
+ */
+import {
+  s,
+  output,
+  cycle,
+  phasor,
+  param,
+  mult,
+  add,
+  onepole,
+  biquad,
+  input,
+  defun,
+  call,
+  argument,
+  invocation,
+  nth,
+  history,
+  mix,
+  t60,
+  accum,
+  lt,
+  delay,
+  decayTrig,
+  biquadBank,
+  type UGen,
+} from "../src/lib/zen/index";
+
+export const patches: Record<string, () => UGen> = {
+  // additive bank: lots of SIMD-friendly arithmetic around scalar oscillators
+  additive: () => {
+    const gain = param(0.1, "gain");
+    let sum: UGen = cycle(110);
+    for (let i = 2; i <= 16; i++) {
+      sum = add(sum, mult(cycle(110 * i), 1 / i));
+    }
+    return s(output(mult(sum, gain), 0), output(mult(sum, gain), 1));
+  },
+  // feedback-heavy filter chain on the input
+  filters: () => {
+    const cutoff = param(1000, "cutoff");
+    let x: UGen = input(0);
+    for (let i = 0; i < 4; i++) {
+      x = biquad(x, cutoff, 0.7, 1, 0);
+    }
+    return s(output(onepole(x, 0.2), 0), output(x, 1));
+  },
+  // 8 invocations of one function: per-voice state, like a polyphonic/granular patch
+  voices: () => {
+    const decay = history();
+    const voice = defun(
+      "voice",
+      8,
+      mult(
+        cycle(mult(argument(0, "freq"), add(1, mult(invocation(), 0.01)))),
+        decay(mix(1, decay(), t60(44100))),
+      ),
+    );
+    let sum: UGen = nth(call(voice, 0, phasor(0.5)), 0);
+    for (let i = 1; i < 8; i++) {
+      sum = add(sum, nth(call(voice, i, add(220, mult(i, 55))), 0));
+    }
+    return s(output(mult(sum, 0.1), 0));
+  },
+  // 50ms of input into long feedback tails, then silence: every state decays towards the
+  // subnormals (see zen-native-denormals.ts)
+  quietTail: () => {
+    const burst = mult(input(0), lt(accum(1, 0, { min: 0, max: 1e9 }), 2205));
+    let x: UGen = burst;
+    for (let i = 0; i < 4; i++) {
+      x = biquad(x, 400 + i * 300, 4, 1, 0);
+    }
+    const echo = history();
+    const echoes = delay(add(burst, mult(echo(), 0.7)), 4410);
+    const bank = biquadBank(
+      Array.from({ length: 16 }, () => burst),
+      Array.from({ length: 16 }, (_, v) => 200 + v * 150),
+      8,
+      1,
+      0,
+    );
+    const tail = add(onepole(decayTrig(lt(burst, -0.99), 88200), 0.01), mult(echoes, 0.5));
+    return s(
+      echo(echoes),
+      output(add(x, tail), 0),
+      output(bank.reduce((a, b) => add(a, b)), 1),
+    );
+  },
+};